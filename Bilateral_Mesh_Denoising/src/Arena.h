@@ -0,0 +1,160 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <functional>
+#include <iostream>
+
+// Monotonic allocator for the temporaries of one operation: allocations are carved out of large
+// blocks and never freed one by one, the whole arena is rewound at once when the operation ends.
+// The blocks are kept, so an operation run again on a mesh of the same size does not call malloc.
+class Arena {
+public:
+  static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+  // Position to rewind to, see mark() and rewind()
+  struct Mark {
+    size_t block, used;
+  };
+
+  explicit Arena(size_t blockSize = DEFAULT_BLOCK_SIZE) : _blockSize(blockSize) {}
+  ~Arena()
+  {
+    for(Block &block : _blocks) free(block.data);
+  }
+  Arena(const Arena &) = delete;
+  Arena &operator = (const Arena &) = delete;
+
+  void *allocate(size_t size, size_t alignment)
+  {
+    ++_allocationCount;
+    for(;;) {
+      if(_current == _blocks.size()) {
+        // a new block, larger than the default one for large requests
+        Block block;
+        block.size = std::max(_blockSize, size + alignment);
+        block.data = static_cast<char*>(malloc(block.size));
+        if(!block.data) throw std::bad_alloc();
+        _reservedBytes += block.size;
+        _blocks.push_back(block);
+      }
+      Block &block = _blocks[_current];
+      const uintptr_t begin = reinterpret_cast<uintptr_t>(block.data) + _used;
+      const size_t padding = (alignment - begin%alignment)%alignment;
+      if(_used + padding + size <= block.size) {
+        _used += padding + size;
+        _bytesInUse += padding + size;
+        _peakBytes = std::max(_peakBytes, _bytesInUse);
+        return reinterpret_cast<void*>(begin + padding);
+      }
+      // the end of this block is left unused
+      _bytesInUse += block.size - _used;
+      ++_current;
+      _used = 0;
+    }
+  }
+
+  Mark mark() const
+  {
+    Mark m;
+    m.block = _current;
+    m.used = _used;
+    return m;
+  }
+  // Frees everything allocated since m was taken, the memory is reused by the next allocations
+  void rewind(const Mark &m)
+  {
+    _bytesInUse = 0;
+    for(size_t b = 0; b < m.block; ++b) _bytesInUse += _blocks[b].size;
+    _bytesInUse += m.used;
+    _current = m.block;
+    _used = m.used;
+  }
+  void reset() { rewind(Mark()); }
+
+  size_t allocationCount() const { return _allocationCount; }  // since the arena was created
+  size_t bytesInUse() const { return _bytesInUse; }
+  size_t peakBytes() const { return _peakBytes; }
+  // Restarts the peak measure from the current use, returns the previous peak
+  size_t resetPeak()
+  {
+    const size_t peak = _peakBytes;
+    _peakBytes = _bytesInUse;
+    return peak;
+  }
+  void restorePeak(size_t peak) { _peakBytes = std::max(_peakBytes, peak); }
+  size_t reservedBytes() const { return _reservedBytes; }     // malloc'ed blocks
+
+private:
+  struct Block {
+    char *data;
+    size_t size;
+  };
+
+  size_t _blockSize;
+  std::vector<Block> _blocks;
+  size_t _current = 0, _used = 0;  // block being filled and bytes used in it
+  size_t _allocationCount = 0, _bytesInUse = 0, _peakBytes = 0, _reservedBytes = 0;
+};
+
+// Standard allocator on an Arena, in the spirit of std::pmr::polymorphic_allocator: containers
+// using it allocate from the arena and deallocate nothing. Built implicitly from an Arena &.
+template<typename T>
+struct ArenaAllocator {
+  typedef T value_type;
+
+  ArenaAllocator(Arena &arena) : arena(&arena) {}
+  template<typename U> ArenaAllocator(const ArenaAllocator<U> &o) : arena(o.arena) {}
+
+  T *allocate(size_t n) { return static_cast<T*>(arena->allocate(n*sizeof(T), alignof(T))); }
+  void deallocate(T *, size_t) {}
+
+  Arena *arena;
+};
+
+template<typename T, typename U>
+bool operator == (const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena == b.arena; }
+template<typename T, typename U>
+bool operator != (const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena != b.arena; }
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+template<typename Key, typename Value, typename Less = std::less<Key>>
+using ArenaMap = std::map<Key, Value, Less, ArenaAllocator<std::pair<const Key, Value>>>;
+
+inline void printArenaUsage(const char *operation, size_t allocations, size_t bytes)
+{
+  std::cout << operation << ": " << allocations << " allocations, arena peak "
+            << (bytes + 1023)/1024 << " KB" << std::endl;
+}
+
+// Scope of one operation on an arena: prints the number of allocations and the peak arena size
+// of the operation when it ends, then frees what it allocated.
+class ArenaScope {
+public:
+  ArenaScope(Arena &arena, const char *operation) :
+    _arena(arena), _operation(operation), _mark(arena.mark()),
+    _allocationCount(arena.allocationCount()), _bytesInUse(arena.bytesInUse()), _outerPeak(arena.resetPeak()) {}
+  ~ArenaScope()
+  {
+    printArenaUsage(_operation, _arena.allocationCount() - _allocationCount, _arena.peakBytes() - _bytesInUse);
+    _arena.rewind(_mark);
+    _arena.restorePeak(_outerPeak);
+  }
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope &operator = (const ArenaScope &) = delete;
+
+private:
+  Arena &_arena;
+  const char *_operation;
+  Arena::Mark _mark;
+  size_t _allocationCount, _bytesInUse, _outerPeak;
+};
+
+#endif  // ARENA_H
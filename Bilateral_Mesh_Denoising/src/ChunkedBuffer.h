@@ -0,0 +1,89 @@
+#ifndef CHUNKED_BUFFER_H
+#define CHUNKED_BUFFER_H
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <type_traits>
+
+// Array of T split in chunks of CHUNK_SIZE elements held by reference counted pointers. Copying a
+// buffer only copies the pointers, a chunk is duplicated when it is written while shared (copy on
+// write), so versions of an array that differ in a few places share the rest of their memory.
+// A copy can be read from another thread while the original is written.
+template<typename T>
+class ChunkedBuffer {
+  static_assert(std::is_trivially_copyable<T>::value, "the chunks are compared and copied bytewise");
+
+public:
+  static const size_t CHUNK_BITS = 12;
+  static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+
+  ChunkedBuffer() {}
+  explicit ChunkedBuffer(const std::vector<T> &v) { assign(v, ChunkedBuffer()); }
+
+  // Contents of v, reusing the chunks of base that hold the same elements: only the chunks that
+  // differ from base are allocated.
+  void assign(const std::vector<T> &v, const ChunkedBuffer &base)
+  {
+    // base may be this buffer
+    std::vector<std::shared_ptr<Chunk>> chunks((v.size() + CHUNK_SIZE - 1) >> CHUNK_BITS);
+    for(size_t c = 0; c < chunks.size(); ++c) {
+      const size_t begin = c << CHUNK_BITS;
+      const size_t count = std::min(CHUNK_SIZE, v.size() - begin);
+      if(c < base._chunks.size() && base._chunks[c]->size() == count &&
+         std::memcmp(base._chunks[c]->data(), v.data() + begin, count*sizeof(T)) == 0)
+        chunks[c] = base._chunks[c];
+      else
+        chunks[c] = std::make_shared<Chunk>(v.begin() + begin, v.begin() + begin + count);
+    }
+    _chunks.swap(chunks);
+    _size = v.size();
+  }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  const T &operator [] (size_t i) const { return (*_chunks[i >> CHUNK_BITS])[i & (CHUNK_SIZE - 1)]; }
+
+  void set(size_t i, const T &value)
+  {
+    std::shared_ptr<Chunk> &chunk = _chunks[i >> CHUNK_BITS];
+    if(chunk.use_count() > 1) chunk = std::make_shared<Chunk>(*chunk);
+    (*chunk)[i & (CHUNK_SIZE - 1)] = value;
+  }
+
+  void copyTo(std::vector<T> &v) const { copyTo(v, ChunkedBuffer()); }
+  // Same, when v holds the contents of base: the chunks shared with base are not copied
+  void copyTo(std::vector<T> &v, const ChunkedBuffer &base) const
+  {
+    v.resize(_size);
+    for(size_t c = 0; c < _chunks.size(); ++c) {
+      if(c < base._chunks.size() && base._chunks[c] == _chunks[c]) continue;
+      std::copy(_chunks[c]->begin(), _chunks[c]->end(), v.begin() + (c << CHUNK_BITS));
+    }
+  }
+
+  size_t chunkCount() const { return _chunks.size(); }
+  // Chunks at the same place in both buffers that are the same memory
+  size_t sharedChunkCount(const ChunkedBuffer &o) const
+  {
+    size_t count = 0;
+    for(size_t c = 0; c < std::min(_chunks.size(), o._chunks.size()); ++c) count += _chunks[c] == o._chunks[c];
+    return count;
+  }
+  bool sameAs(const ChunkedBuffer &o) const
+  {
+    return _size == o._size && sharedChunkCount(o) == _chunks.size();
+  }
+
+private:
+  typedef std::vector<T> Chunk;
+  std::vector<std::shared_ptr<Chunk>> _chunks;
+  size_t _size = 0;
+};
+
+template<typename T> const size_t ChunkedBuffer<T>::CHUNK_BITS;
+template<typename T> const size_t ChunkedBuffer<T>::CHUNK_SIZE;
+
+#endif  // CHUNKED_BUFFER_H
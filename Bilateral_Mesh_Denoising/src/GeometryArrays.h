@@ -0,0 +1,109 @@
+#ifndef GEOMETRY_ARRAYS_H
+#define GEOMETRY_ARRAYS_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Allocator of Alignment aligned blocks, for the arrays loaded into SIMD registers
+template<typename T, size_t Alignment>
+struct AlignedAllocator {
+  typedef T value_type;
+  template<typename U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+  AlignedAllocator() {}
+  template<typename U> AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+  T *allocate(size_t n)
+  {
+    void *p = nullptr;
+#ifdef _WIN32
+    p = _aligned_malloc(n*sizeof(T), Alignment);
+#else
+    if(posix_memalign(&p, Alignment, n*sizeof(T)) != 0) p = nullptr;
+#endif
+    if(!p) throw std::bad_alloc();
+    return static_cast<T*>(p);
+  }
+  void deallocate(T *p, size_t)
+  {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+  }
+};
+
+template<typename T, typename U, size_t A>
+bool operator == (const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> &) { return true; }
+template<typename T, typename U, size_t A>
+bool operator != (const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> &) { return false; }
+
+// 3D vectors stored as three arrays of x, y and z (structure of arrays), aligned on 32 bytes and
+// padded with zeros to a multiple of LANES elements, so that the SIMD kernels of GeometryKernels.h
+// load 8 consecutive vectors per register without a remainder loop.
+class Vec3Arrays {
+public:
+  static const size_t LANES = 8;
+
+  Vec3Arrays() {}
+  explicit Vec3Arrays(const std::vector<glm::vec3> &v) { assign(v); }
+
+  size_t size() const { return _size; }
+  size_t paddedSize() const { return _x.size(); }
+
+  void resize(size_t n)
+  {
+    _size = n;
+    const size_t padded = (n + LANES - 1)/LANES*LANES;
+    _x.assign(padded, 0.f);
+    _y.assign(padded, 0.f);
+    _z.assign(padded, 0.f);
+  }
+
+  // Conversions from and to the interleaved layout used by the rest of the mesh code and by GL
+  void assign(const std::vector<glm::vec3> &v)
+  {
+    resize(v.size());
+    for(size_t i = 0; i < v.size(); ++i) {
+      _x[i] = v[i].x;
+      _y[i] = v[i].y;
+      _z[i] = v[i].z;
+    }
+  }
+  void toInterleaved(std::vector<glm::vec3> &v) const
+  {
+    v.resize(_size);
+    for(size_t i = 0; i < _size; ++i) v[i] = glm::vec3(_x[i], _y[i], _z[i]);
+  }
+
+  glm::vec3 operator [] (size_t i) const { return glm::vec3(_x[i], _y[i], _z[i]); }
+  void set(size_t i, const glm::vec3 &v)
+  {
+    _x[i] = v.x;
+    _y[i] = v.y;
+    _z[i] = v.z;
+  }
+
+  const float *x() const { return _x.data(); }
+  const float *y() const { return _y.data(); }
+  const float *z() const { return _z.data(); }
+  float *x() { return _x.data(); }
+  float *y() { return _y.data(); }
+  float *z() { return _z.data(); }
+
+private:
+  typedef std::vector<float, AlignedAllocator<float, 32>> FloatArray;
+  size_t _size = 0;
+  FloatArray _x, _y, _z;
+};
+
+#endif  // GEOMETRY_ARRAYS_H
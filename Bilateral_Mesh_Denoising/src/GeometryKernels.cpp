@@ -0,0 +1,431 @@
+#include "GeometryKernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// GEOMETRY_KERNELS_NO_SIMD builds the scalar kernels, to compare them with the SIMD ones
+#if defined(GEOMETRY_KERNELS_NO_SIMD)
+#elif defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))  // /arch:AVX2 implies FMA
+#include <immintrin.h>
+#define GEOMETRY_KERNELS_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GEOMETRY_KERNELS_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GEOMETRY_KERNELS_NEON
+#endif
+
+namespace {
+
+// Thin layer over the registers of the instruction set: Floats holds WIDTH floats, Mask the
+// result of a comparison of two Floats
+#if defined(GEOMETRY_KERNELS_AVX2)
+
+typedef __m256 Floats;
+typedef __m256 Mask;
+const unsigned int WIDTH = 8;
+const char INSTRUCTION_SET[] = "AVX2";
+
+inline Floats load(const float *p) { return _mm256_load_ps(p); }
+inline Floats loadUnaligned(const float *p) { return _mm256_loadu_ps(p); }
+inline void store(float *p, Floats v) { _mm256_store_ps(p, v); }
+inline void storeUnaligned(float *p, Floats v) { _mm256_storeu_ps(p, v); }
+inline Floats broadcast(float x) { return _mm256_set1_ps(x); }
+inline Floats add(Floats a, Floats b) { return _mm256_add_ps(a, b); }
+inline Floats sub(Floats a, Floats b) { return _mm256_sub_ps(a, b); }
+inline Floats mul(Floats a, Floats b) { return _mm256_mul_ps(a, b); }
+inline Floats div(Floats a, Floats b) { return _mm256_div_ps(a, b); }
+inline Floats madd(Floats a, Floats b, Floats c) { return _mm256_fmadd_ps(a, b, c); }
+inline Floats min(Floats a, Floats b) { return _mm256_min_ps(a, b); }
+inline Floats max(Floats a, Floats b) { return _mm256_max_ps(a, b); }
+inline Floats sqrt(Floats a) { return _mm256_sqrt_ps(a); }
+inline Floats absolute(Floats a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+// the lanes are loaded one by one, _mm256_i32gather_ps is microcoded and slower on Zen
+inline Floats gather(const float *base, const unsigned int *i)
+{
+  return _mm256_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]], base[i[4]], base[i[5]], base[i[6]], base[i[7]]);
+}
+inline Mask lessEqual(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline unsigned int bits(Mask m) { return static_cast<unsigned int>(_mm256_movemask_ps(m)); }
+inline Floats select(Mask m, Floats v) { return _mm256_and_ps(m, v); }
+inline Floats choose(Mask m, Floats a, Floats b) { return _mm256_blendv_ps(b, a, m); }
+inline Floats roundToNearest(Floats a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline Floats pow2(Floats n)  // n integer valued, in the exponent range
+{
+  const __m256i exponent = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+  return _mm256_castsi256_ps(_mm256_slli_epi32(exponent, 23));
+}
+inline float sum(Floats v)
+{
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+inline float largest(Floats v)
+{
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+#elif defined(GEOMETRY_KERNELS_SSE2)
+
+typedef __m128 Floats;
+typedef __m128 Mask;
+const unsigned int WIDTH = 4;
+const char INSTRUCTION_SET[] = "SSE2";
+
+inline Floats load(const float *p) { return _mm_load_ps(p); }
+inline Floats loadUnaligned(const float *p) { return _mm_loadu_ps(p); }
+inline void store(float *p, Floats v) { _mm_store_ps(p, v); }
+inline void storeUnaligned(float *p, Floats v) { _mm_storeu_ps(p, v); }
+inline Floats broadcast(float x) { return _mm_set1_ps(x); }
+inline Floats add(Floats a, Floats b) { return _mm_add_ps(a, b); }
+inline Floats sub(Floats a, Floats b) { return _mm_sub_ps(a, b); }
+inline Floats mul(Floats a, Floats b) { return _mm_mul_ps(a, b); }
+inline Floats div(Floats a, Floats b) { return _mm_div_ps(a, b); }
+inline Floats madd(Floats a, Floats b, Floats c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline Floats min(Floats a, Floats b) { return _mm_min_ps(a, b); }
+inline Floats max(Floats a, Floats b) { return _mm_max_ps(a, b); }
+inline Floats sqrt(Floats a) { return _mm_sqrt_ps(a); }
+inline Floats absolute(Floats a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+inline Floats gather(const float *base, const unsigned int *indices)
+{
+  return _mm_set_ps(base[indices[3]], base[indices[2]], base[indices[1]], base[indices[0]]);
+}
+inline Mask lessEqual(Floats a, Floats b) { return _mm_cmple_ps(a, b); }
+inline unsigned int bits(Mask m) { return static_cast<unsigned int>(_mm_movemask_ps(m)); }
+inline Floats select(Mask m, Floats v) { return _mm_and_ps(m, v); }
+inline Floats choose(Mask m, Floats a, Floats b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+inline Floats roundToNearest(Floats a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+inline Floats pow2(Floats n)
+{
+  const __m128i exponent = _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127));
+  return _mm_castsi128_ps(_mm_slli_epi32(exponent, 23));
+}
+inline float sum(Floats v)
+{
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+  return _mm_cvtss_f32(v);
+}
+inline float largest(Floats v)
+{
+  v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+  return _mm_cvtss_f32(v);
+}
+
+#elif defined(GEOMETRY_KERNELS_NEON)
+
+typedef float32x4_t Floats;
+typedef uint32x4_t Mask;
+const unsigned int WIDTH = 4;
+const char INSTRUCTION_SET[] = "NEON";
+
+inline Floats load(const float *p) { return vld1q_f32(p); }
+inline Floats loadUnaligned(const float *p) { return vld1q_f32(p); }
+inline void store(float *p, Floats v) { vst1q_f32(p, v); }
+inline void storeUnaligned(float *p, Floats v) { vst1q_f32(p, v); }
+inline Floats broadcast(float x) { return vdupq_n_f32(x); }
+inline Floats add(Floats a, Floats b) { return vaddq_f32(a, b); }
+inline Floats sub(Floats a, Floats b) { return vsubq_f32(a, b); }
+inline Floats mul(Floats a, Floats b) { return vmulq_f32(a, b); }
+inline Floats div(Floats a, Floats b) { return vdivq_f32(a, b); }
+inline Floats madd(Floats a, Floats b, Floats c) { return vfmaq_f32(c, a, b); }
+inline Floats min(Floats a, Floats b) { return vminq_f32(a, b); }
+inline Floats max(Floats a, Floats b) { return vmaxq_f32(a, b); }
+inline Floats sqrt(Floats a) { return vsqrtq_f32(a); }
+inline Floats absolute(Floats a) { return vabsq_f32(a); }
+inline Floats gather(const float *base, const unsigned int *indices)
+{
+  const float values[4] = { base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]] };
+  return vld1q_f32(values);
+}
+inline Mask lessEqual(Floats a, Floats b) { return vcleq_f32(a, b); }
+inline unsigned int bits(Mask m)
+{
+  static const uint32_t lanes[4] = { 1, 2, 4, 8 };
+  return vaddvq_u32(vandq_u32(m, vld1q_u32(lanes)));
+}
+inline Floats select(Mask m, Floats v) { return vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(v))); }
+inline Floats choose(Mask m, Floats a, Floats b) { return vbslq_f32(m, a, b); }
+inline Floats roundToNearest(Floats a) { return vrndnq_f32(a); }
+inline Floats pow2(Floats n)
+{
+  const int32x4_t exponent = vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127));
+  return vreinterpretq_f32_s32(vshlq_n_s32(exponent, 23));
+}
+inline float sum(Floats v) { return vaddvq_f32(v); }
+inline float largest(Floats v) { return vmaxvq_f32(v); }
+
+#endif
+
+#if defined(GEOMETRY_KERNELS_AVX2) || defined(GEOMETRY_KERNELS_SSE2) || defined(GEOMETRY_KERNELS_NEON)
+#define GEOMETRY_KERNELS_SIMD
+
+// Corner c of WIDTH consecutive triangles, copied out of the interleaved indices
+struct CornerIndices {
+  unsigned int values[WIDTH];
+
+  CornerIndices(const glm::uvec3 *triangles, unsigned int c)
+  {
+    for(unsigned int k = 0; k < WIDTH; ++k) values[k] = triangles[k][c];
+  }
+};
+
+// exp(x) with the polynomial of Cephes expf, relative error below 2e-7; x is clamped to the range
+// of normal results
+inline Floats exponential(Floats x)
+{
+  x = min(max(x, broadcast(-87.3f)), broadcast(88.3f));
+  const Floats n = roundToNearest(mul(x, broadcast(1.44269504088896341f)));
+  Floats r = sub(x, mul(n, broadcast(0.693359375f)));
+  r = add(r, mul(n, broadcast(2.12194440e-4f)));
+  Floats y = broadcast(1.9875691500e-4f);
+  y = madd(y, r, broadcast(1.3981999507e-3f));
+  y = madd(y, r, broadcast(8.3334519073e-3f));
+  y = madd(y, r, broadcast(4.1665795894e-2f));
+  y = madd(y, r, broadcast(1.6666665459e-1f));
+  y = madd(y, r, broadcast(5.0000001201e-1f));
+  y = add(madd(y, mul(r, r), r), broadcast(1.f));
+  return mul(y, pow2(n));
+}
+
+// acos(x) with the polynomial 4.4.46 of Abramowitz and Stegun, absolute error below 2e-8; x is
+// clamped to [-1, 1]
+inline Floats arcCosine(Floats x)
+{
+  x = min(max(x, broadcast(-1.f)), broadcast(1.f));
+  const Floats a = absolute(x);
+  Floats p = broadcast(-0.0012624911f);
+  p = madd(p, a, broadcast(0.0066700901f));
+  p = madd(p, a, broadcast(-0.0170881256f));
+  p = madd(p, a, broadcast(0.0308918810f));
+  p = madd(p, a, broadcast(-0.0501743046f));
+  p = madd(p, a, broadcast(0.0889789874f));
+  p = madd(p, a, broadcast(-0.2145988016f));
+  p = madd(p, a, broadcast(1.5707963050f));
+  const Floats r = mul(sqrt(sub(broadcast(1.f), a)), p);
+  return choose(lessEqual(broadcast(0.f), x), r, sub(broadcast(3.14159265358979f), r));
+}
+#else
+const unsigned int WIDTH = 1;
+const char INSTRUCTION_SET[] = "scalar";
+#endif
+
+inline unsigned int lowestBit(unsigned int bits)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, bits);
+  return index;
+#else
+  return __builtin_ctz(bits);
+#endif
+}
+
+} // namespace
+
+const char *geometryKernelsInstructionSet()
+{
+  return INSTRUCTION_SET;
+}
+
+void boundingSphere(const Vec3Arrays &positions, glm::vec3 &center, float &radius)
+{
+  const size_t n = positions.size();
+  center = glm::vec3(0.f);
+  radius = 0.f;
+  if(n == 0) return;
+  const float *x = positions.x(), *y = positions.y(), *z = positions.z();
+  size_t i = 0;
+#ifdef GEOMETRY_KERNELS_SIMD
+  // the padding is zero, whole registers can be summed
+  Floats sx = broadcast(0.f), sy = broadcast(0.f), sz = broadcast(0.f);
+  for(; i < positions.paddedSize(); i += WIDTH) {
+    sx = add(sx, load(x + i));
+    sy = add(sy, load(y + i));
+    sz = add(sz, load(z + i));
+  }
+  center = glm::vec3(sum(sx), sum(sy), sum(sz));
+#else
+  for(; i < n; ++i) center += glm::vec3(x[i], y[i], z[i]);
+#endif
+  center /= static_cast<float>(n);
+
+  float largestSquared = 0.f;
+  i = 0;
+#ifdef GEOMETRY_KERNELS_SIMD
+  const Floats cx = broadcast(center.x), cy = broadcast(center.y), cz = broadcast(center.z);
+  Floats best = broadcast(0.f);
+  for(; i + WIDTH <= n; i += WIDTH) {
+    const Floats dx = sub(load(x + i), cx), dy = sub(load(y + i), cy), dz = sub(load(z + i), cz);
+    best = max(best, madd(dx, dx, madd(dy, dy, mul(dz, dz))));
+  }
+  largestSquared = largest(best);
+#endif
+  for(; i < n; ++i) {
+    const glm::vec3 d = glm::vec3(x[i], y[i], z[i]) - center;
+    largestSquared = std::max(largestSquared, glm::dot(d, d));
+  }
+  radius = std::sqrt(largestSquared);
+}
+
+void triangleNormalsAndAreas(const Vec3Arrays &positions, const std::vector<glm::uvec3> &triangles,
+                             Vec3Arrays &normals, std::vector<float> &areas)
+{
+  const size_t T = triangles.size();
+  normals.resize(T);
+  areas.resize(T);
+  size_t f = 0;
+#ifdef GEOMETRY_KERNELS_SIMD
+  const float *x = positions.x(), *y = positions.y(), *z = positions.z();
+  for(; f + WIDTH <= T; f += WIDTH) {
+    const CornerIndices a(&triangles[f], 0), b(&triangles[f], 1), c(&triangles[f], 2);
+    const Floats ax = gather(x, a.values), ay = gather(y, a.values), az = gather(z, a.values);
+    const Floats e1x = sub(gather(x, b.values), ax), e1y = sub(gather(y, b.values), ay), e1z = sub(gather(z, b.values), az);
+    const Floats e2x = sub(gather(x, c.values), ax), e2y = sub(gather(y, c.values), ay), e2z = sub(gather(z, c.values), az);
+    const Floats nx = sub(mul(e1y, e2z), mul(e1z, e2y));
+    const Floats ny = sub(mul(e1z, e2x), mul(e1x, e2z));
+    const Floats nz = sub(mul(e1x, e2y), mul(e1y, e2x));
+    const Floats length = sqrt(madd(nx, nx, madd(ny, ny, mul(nz, nz))));
+    const Floats inverse = div(broadcast(1.f), length);
+    store(normals.x() + f, mul(nx, inverse));
+    store(normals.y() + f, mul(ny, inverse));
+    store(normals.z() + f, mul(nz, inverse));
+    storeUnaligned(areas.data() + f, mul(length, broadcast(0.5f)));
+  }
+#endif
+  for(; f < T; ++f) {
+    const glm::vec3 a = positions[triangles[f][0]];
+    const glm::vec3 normal = glm::cross(positions[triangles[f][1]] - a, positions[triangles[f][2]] - a);
+    const float length = glm::length(normal);
+    normals.set(f, normal/length);
+    areas[f] = length/2.f;
+  }
+}
+
+void triangleAngles(const Vec3Arrays &positions, const std::vector<glm::uvec3> &triangles, Vec3Arrays &angles)
+{
+  const size_t T = triangles.size();
+  angles.resize(T);
+  size_t f = 0;
+#ifdef GEOMETRY_KERNELS_SIMD
+  const float *x = positions.x(), *y = positions.y(), *z = positions.z();
+  for(; f + WIDTH <= T; f += WIDTH) {
+    const CornerIndices a(&triangles[f], 0), b(&triangles[f], 1), c(&triangles[f], 2);
+    const Floats ax = gather(x, a.values), ay = gather(y, a.values), az = gather(z, a.values);
+    const Floats bx = gather(x, b.values), by = gather(y, b.values), bz = gather(z, b.values);
+    const Floats cx = gather(x, c.values), cy = gather(y, c.values), cz = gather(z, c.values);
+    const Floats abx = sub(bx, ax), aby = sub(by, ay), abz = sub(bz, az);
+    const Floats acx = sub(cx, ax), acy = sub(cy, ay), acz = sub(cz, az);
+    const Floats bcx = sub(cx, bx), bcy = sub(cy, by), bcz = sub(cz, bz);
+    const Floats ab2 = madd(abx, abx, madd(aby, aby, mul(abz, abz)));
+    const Floats ac2 = madd(acx, acx, madd(acy, acy, mul(acz, acz)));
+    const Floats bc2 = madd(bcx, bcx, madd(bcy, bcy, mul(bcz, bcz)));
+    const Floats dotA = madd(abx, acx, madd(aby, acy, mul(abz, acz)));
+    const Floats dotB = sub(broadcast(0.f), madd(abx, bcx, madd(aby, bcy, mul(abz, bcz))));
+    const Floats angleA = arcCosine(div(dotA, sqrt(mul(ab2, ac2))));
+    const Floats angleB = arcCosine(div(dotB, sqrt(mul(ab2, bc2))));
+    store(angles.x() + f, angleA);
+    store(angles.y() + f, angleB);
+    store(angles.z() + f, sub(sub(broadcast(3.14159265358979f), angleA), angleB));
+  }
+#endif
+  for(; f < T; ++f) {
+    const glm::vec3 a = positions[triangles[f][0]], b = positions[triangles[f][1]], c = positions[triangles[f][2]];
+    const glm::vec3 ab = b - a, ac = c - a, bc = c - b;
+    const float angleA = std::acos(glm::clamp(glm::dot(ab, ac)/std::sqrt(glm::dot(ab, ab)*glm::dot(ac, ac)), -1.f, 1.f));
+    const float angleB = std::acos(glm::clamp(-glm::dot(ab, bc)/std::sqrt(glm::dot(ab, ab)*glm::dot(bc, bc)), -1.f, 1.f));
+    angles.set(f, glm::vec3(angleA, angleB, 3.14159265358979f - angleA - angleB));
+  }
+}
+
+void radiusNeighbors(const Vec3Arrays &positions, unsigned int i, float radius, std::vector<unsigned int> &neighbors)
+{
+  const size_t n = positions.size();
+  const float *x = positions.x(), *y = positions.y(), *z = positions.z();
+  const glm::vec3 p = positions[i];
+  const float radiusSquared = radius*radius;
+  size_t j = 0;
+#ifdef GEOMETRY_KERNELS_SIMD
+  const Floats px = broadcast(p.x), py = broadcast(p.y), pz = broadcast(p.z), limit = broadcast(radiusSquared);
+  for(; j + WIDTH <= n; j += WIDTH) {
+    const Floats dx = sub(load(x + j), px), dy = sub(load(y + j), py), dz = sub(load(z + j), pz);
+    for(unsigned int inside = bits(lessEqual(madd(dx, dx, madd(dy, dy, mul(dz, dz))), limit)); inside; inside &= inside - 1) {
+      const unsigned int k = static_cast<unsigned int>(j) + lowestBit(inside);
+      if(k != i) neighbors.push_back(k);
+    }
+  }
+#endif
+  for(; j < n; ++j) {
+    const glm::vec3 d = glm::vec3(x[j], y[j], z[j]) - p;
+    if(j != i && glm::dot(d, d) <= radiusSquared) neighbors.push_back(static_cast<unsigned int>(j));
+  }
+}
+
+bool bilateralOffset(const Vec3Arrays &positions, const glm::vec3 &point, const glm::vec3 &normal,
+                     const unsigned int *Q, unsigned int count, float sigma_c, float sigma_s, float maxDistance,
+                     float &offset)
+{
+  // w_c*w_s = exp(e) with e = -t^2/(2 sigma_c^2) - h^2/(2 sigma_s^2). The weights are computed as
+  // exp(e - max e), which leaves the ratio unchanged but keeps the far neighbors out of the float
+  // underflow; as in Mesh::bilateralOffset, whose sums are floats, the offset is NaN when every
+  // weight rounds to zero in single precision.
+  const float a = -1.f/(2.f*sigma_c*sigma_c), b = -1.f/(2.f*sigma_s*sigma_s);
+  const float maxDistanceSquared = maxDistance*maxDistance;
+  const float FLOAT_UNDERFLOW = -103.97f;  // log of half the smallest denormal
+  auto exponent = [&](unsigned int q, float &h) {
+    const glm::vec3 d = positions[q] - point;
+    h = glm::dot(d, normal);
+    const float t2 = glm::dot(d, d);
+    return t2 > maxDistanceSquared ? -INFINITY : t2*a + h*h*b;
+  };
+
+  float largestExponent = -INFINITY, h;
+  unsigned int k = 0;
+#ifdef GEOMETRY_KERNELS_SIMD
+  const float *x = positions.x(), *y = positions.y(), *z = positions.z();
+  const Floats px = broadcast(point.x), py = broadcast(point.y), pz = broadcast(point.z);
+  const Floats nx = broadcast(normal.x), ny = broadcast(normal.y), nz = broadcast(normal.z);
+  const Floats va = broadcast(a), vb = broadcast(b), limit = broadcast(maxDistanceSquared), outside = broadcast(-INFINITY);
+  auto exponents = [&](unsigned int k, Floats &h) {
+    const Floats dx = sub(gather(x, Q + k), px), dy = sub(gather(y, Q + k), py), dz = sub(gather(z, Q + k), pz);
+    h = madd(dx, nx, madd(dy, ny, mul(dz, nz)));
+    const Floats t2 = madd(dx, dx, madd(dy, dy, mul(dz, dz)));
+    return choose(lessEqual(t2, limit), madd(t2, va, mul(mul(h, h), vb)), outside);
+  };
+  Floats hs, best = outside;
+  for(; k + WIDTH <= count; k += WIDTH) best = max(best, exponents(k, hs));
+  largestExponent = largest(best);
+#endif
+  for(; k < count; ++k) largestExponent = std::max(largestExponent, exponent(Q[k], h));
+  if(largestExponent == -INFINITY) return false;  // no neighbor within maxDistance
+
+  float weightedSum = 0.f, normalizer = 0.f;
+  k = 0;
+#ifdef GEOMETRY_KERNELS_SIMD
+  const Floats shift = broadcast(largestExponent), lowest = broadcast(-FLT_MAX);
+  Floats sums = broadcast(0.f), weights = broadcast(0.f);
+  for(; k + WIDTH <= count; k += WIDTH) {
+    const Floats e = exponents(k, hs);
+    const Floats w = select(lessEqual(lowest, e), exponential(sub(e, shift)));
+    sums = madd(w, hs, sums);
+    weights = add(weights, w);
+  }
+  weightedSum = sum(sums);
+  normalizer = sum(weights);
+#endif
+  for(; k < count; ++k) {
+    const float w = std::exp(exponent(Q[k], h) - largestExponent);
+    weightedSum += w*h;
+    normalizer += w;
+  }
+  offset = largestExponent < FLOAT_UNDERFLOW ? NAN : weightedSum/normalizer;
+  return true;
+}
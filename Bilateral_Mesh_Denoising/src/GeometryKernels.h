@@ -0,0 +1,41 @@
+#ifndef GEOMETRY_KERNELS_H
+#define GEOMETRY_KERNELS_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "GeometryArrays.h"
+
+// Geometry kernels on structure of arrays positions, processing 8 vertices or triangles per step
+// with AVX2 and FMA (CMake option GEOMETRY_KERNELS_AVX2), 4 with SSE2 or NEON, and one at a time
+// otherwise or with GEOMETRY_KERNELS_NO_SIMD. The triangle corners are gathered from the
+// positions, there is no per-triangle copy. Mesh refreshes its structure of arrays copy of the
+// positions before the kernels when they changed; the copy costs about as much as one
+// boundingSphere pass, little next to the neighbor searches and the filtering.
+
+// Name of the instruction set the kernels were built for
+const char *geometryKernelsInstructionSet();
+
+// Centroid of the positions and largest distance from it
+void boundingSphere(const Vec3Arrays &positions, glm::vec3 &center, float &radius);
+
+// Unit normal and area of every triangle, as Mesh::calculateTrianglesAreas (degenerate triangles
+// get a NaN normal)
+void triangleNormalsAndAreas(const Vec3Arrays &positions, const std::vector<glm::uvec3> &triangles,
+                             Vec3Arrays &normals, std::vector<float> &areas);
+
+// Interior angles of every triangle, at its corners 0, 1 and 2 in x, y and z (NaN for degenerate
+// triangles)
+void triangleAngles(const Vec3Arrays &positions, const std::vector<glm::uvec3> &triangles, Vec3Arrays &angles);
+
+// Appends to neighbors the vertices j != i with |p_j - p_i| <= radius, in increasing order
+void radiusNeighbors(const Vec3Arrays &positions, unsigned int i, float radius, std::vector<unsigned int> &neighbors);
+
+// Mesh::bilateralOffset on structure of arrays positions, in single precision with the weights
+// scaled by the largest one
+bool bilateralOffset(const Vec3Arrays &positions, const glm::vec3 &point, const glm::vec3 &normal,
+                     const unsigned int *Q, unsigned int count, float sigma_c, float sigma_s, float maxDistance,
+                     float &offset);
+
+#endif  // GEOMETRY_KERNELS_H
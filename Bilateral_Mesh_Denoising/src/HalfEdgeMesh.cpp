@@ -0,0 +1,207 @@
+#include "HalfEdgeMesh.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Half-edge sorted on the unordered pair of its vertices
+struct EdgeKey {
+  uint64_t edge;
+  unsigned int halfEdge;
+
+  bool operator < (const EdgeKey &o) const { return edge < o.edge || (edge == o.edge && halfEdge < o.halfEdge); }
+};
+
+} // namespace
+
+const unsigned int HalfEdgeMesh::INVALID;
+
+HalfEdgeMesh::HalfEdgeMesh(const std::vector<glm::uvec3> &triangles, unsigned int vertexCount) :
+  _vertex(3*triangles.size()), _twin(3*triangles.size(), INVALID), _outgoing(vertexCount, INVALID)
+{
+  const unsigned int H = halfEdgeCount();
+  std::vector<EdgeKey> keys(H);
+  parallelFor(0, faceCount(), [&](unsigned int f) {
+    for(unsigned int c = 0; c < 3; ++c) {
+      const unsigned int a = triangles[f][c], b = triangles[f][(c + 1)%3];
+      _vertex[3*f + c] = b;
+      keys[3*f + c].edge = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+      keys[3*f + c].halfEdge = 3*f + c;
+    }
+  });
+  parallelSort(keys.begin(), keys.end(), [](const EdgeKey &x, const EdgeKey &y) { return x < y; });
+
+  // the half-edges of an edge are now consecutive, only pairs of opposite ones are twins
+  parallelFor(0, H, [&](unsigned int i) {
+    if(i > 0 && keys[i - 1].edge == keys[i].edge) return;  // not the first of its edge
+    if(i + 1 >= H || keys[i + 1].edge != keys[i].edge || (i + 2 < H && keys[i + 2].edge == keys[i].edge)) return;
+    const unsigned int h = keys[i].halfEdge, t = keys[i + 1].halfEdge;
+    if(from(h) == to(t) && to(h) == from(t) && from(h) != to(h)) link(h, t);
+  });
+
+  for(unsigned int h = 0; h < H; ++h) {
+    const unsigned int v = from(h);
+    if(_outgoing[v] == INVALID || isBoundary(h)) _outgoing[v] = h;
+  }
+}
+
+unsigned int HalfEdgeMesh::valence(unsigned int v) const
+{
+  unsigned int count = 0;
+  forEachNeighbor(v, [&](unsigned int) { ++count; });
+  return count;
+}
+
+unsigned int HalfEdgeMesh::findHalfEdge(unsigned int a, unsigned int b) const
+{
+  unsigned int found = INVALID;
+  forEachOutgoing(a, [&](unsigned int h) { if(to(h) == b) found = h; });
+  return found;
+}
+
+void HalfEdgeMesh::link(unsigned int h, unsigned int t)
+{
+  if(h != INVALID) _twin[h] = t;
+  if(t != INVALID) _twin[t] = h;
+}
+
+// Rewrites the corners of the face of the half-edge first so that it runs from a to b
+void HalfEdgeMesh::setFace(unsigned int first, unsigned int a, unsigned int b, unsigned int c)
+{
+  _vertex[first] = b;
+  _vertex[next(first)] = c;
+  _vertex[prev(first)] = a;
+}
+
+// Appends the face (a, b, c) with unpaired half-edges, returns its first half-edge (from a to b)
+unsigned int HalfEdgeMesh::addFace(unsigned int a, unsigned int b, unsigned int c)
+{
+  const unsigned int first = halfEdgeCount();
+  _vertex.resize(first + 3);
+  _twin.resize(first + 3, INVALID);
+  setFace(first, a, b, c);
+  return first;
+}
+
+// Makes the outgoing half-edge of v the boundary one reached clockwise from h, or h itself
+// when v is inside the mesh
+void HalfEdgeMesh::resetOutgoing(unsigned int v, unsigned int h)
+{
+  if(h != INVALID)
+    for(unsigned int start = h, previous; (previous = rotateCW(h)) != INVALID && previous != start; )
+      h = previous;
+  _outgoing[v] = h;
+}
+
+bool HalfEdgeMesh::flipEdge(unsigned int h)
+{
+  const unsigned int t = _twin[h];
+  if(t == INVALID) return false;
+  const unsigned int a = from(h), b = to(h), c = to(next(h)), d = to(next(t));
+  if(c == d || findHalfEdge(c, d) != INVALID || findHalfEdge(d, c) != INVALID) return false;
+
+  const unsigned int eBC = _twin[next(h)], eCA = _twin[prev(h)], eAD = _twin[next(t)], eDB = _twin[prev(t)];
+  setFace(h, c, d, b);
+  setFace(t, d, c, a);
+  link(h, t);
+  link(next(h), eDB);
+  link(prev(h), eBC);
+  link(next(t), eCA);
+  link(prev(t), eAD);
+  resetOutgoing(a, prev(t));
+  resetOutgoing(b, prev(h));
+  resetOutgoing(c, h);
+  resetOutgoing(d, t);
+  return true;
+}
+
+unsigned int HalfEdgeMesh::splitEdge(unsigned int h)
+{
+  const unsigned int t = _twin[h];
+  const unsigned int a = from(h), b = to(h), c = to(next(h));
+  const unsigned int m = vertexCount();
+  _outgoing.push_back(INVALID);
+
+  // (a, b, c) becomes (a, m, c) and (m, b, c)
+  const unsigned int eBC = _twin[next(h)];
+  setFace(h, a, m, c);
+  const unsigned int g = addFace(m, b, c);
+  link(next(g), eBC);
+  link(prev(g), next(h));
+
+  // (b, a, d) becomes (b, m, d) and (m, a, d)
+  if(t != INVALID) {
+    const unsigned int d = to(next(t));
+    const unsigned int eAD = _twin[next(t)];
+    setFace(t, b, m, d);
+    const unsigned int k = addFace(m, a, d);
+    link(next(k), eAD);
+    link(prev(k), next(t));
+    link(h, k);
+    link(t, g);
+    resetOutgoing(d, prev(t));
+  } else {
+    link(h, INVALID);
+    link(g, INVALID);
+  }
+  resetOutgoing(m, g);
+  resetOutgoing(a, h);
+  resetOutgoing(b, next(g));
+  resetOutgoing(c, prev(h));
+  return m;
+}
+
+bool HalfEdgeMesh::collapseEdge(unsigned int h)
+{
+  const unsigned int t = _twin[h];
+  const unsigned int a = from(h), b = to(h), c = to(next(h));
+  const unsigned int d = t != INVALID ? to(next(t)) : INVALID;
+
+  // link condition: a and b share no neighbor but the opposite vertices of the edge
+  std::vector<unsigned int> ringA, ringB, common, merged;
+  forEachNeighbor(a, [&](unsigned int u) { ringA.push_back(u); });
+  forEachNeighbor(b, [&](unsigned int u) { ringB.push_back(u); });
+  std::sort(ringA.begin(), ringA.end());
+  std::sort(ringB.begin(), ringB.end());
+  std::set_intersection(ringA.begin(), ringA.end(), ringB.begin(), ringB.end(), std::back_inserter(common));
+  std::set_union(ringA.begin(), ringA.end(), ringB.begin(), ringB.end(), std::back_inserter(merged));
+  std::vector<unsigned int> opposite(1, c);
+  if(d != INVALID) opposite.push_back(d);
+  std::sort(opposite.begin(), opposite.end());
+  if(common != opposite) return false;
+  if(t != INVALID && isBoundaryVertex(a) && isBoundaryVertex(b)) return false;  // would pinch the boundary
+  const bool boundaryResult = isBoundaryVertex(a) || isBoundaryVertex(b);
+  if(merged.size() - 2 < (boundaryResult ? 2u : 3u)) return false;
+  for(unsigned int v : opposite)
+    if(valence(v) <= (isBoundaryVertex(v) ? 2u : 3u)) return false;
+
+  // the twins around the removed faces are paired across them
+  const unsigned int eBC = _twin[next(h)], eCA = _twin[prev(h)];
+  const unsigned int eAD = t != INVALID ? _twin[next(t)] : INVALID, eDB = t != INVALID ? _twin[prev(t)] : INVALID;
+  forEachOutgoing(a, [&](unsigned int g) { _vertex[prev(g)] = b; });
+  link(eBC, eCA);
+  link(eAD, eDB);
+  for(unsigned int f : {face(h), t != INVALID ? face(t) : INVALID}) {
+    if(f == INVALID) continue;
+    for(unsigned int k = 3*f; k < 3*f + 3; ++k) {
+      _vertex[k] = INVALID;
+      _twin[k] = INVALID;
+    }
+  }
+
+  auto firstValid = [](unsigned int x, unsigned int y) { return x != INVALID ? x : y; };
+  _outgoing[a] = INVALID;
+  resetOutgoing(b, firstValid(eCA, firstValid(eDB, eBC != INVALID ? next(eBC) : INVALID)));
+  resetOutgoing(c, firstValid(eBC, eCA != INVALID ? next(eCA) : INVALID));
+  if(d != INVALID) resetOutgoing(d, firstValid(eAD, eDB != INVALID ? next(eDB) : INVALID));
+  return true;
+}
+
+void HalfEdgeMesh::exportTriangles(std::vector<glm::uvec3> &triangles) const
+{
+  triangles.clear();
+  for(unsigned int f = 0; f < faceCount(); ++f)
+    if(!isDeletedFace(f)) triangles.push_back(glm::uvec3(from(3*f), to(3*f), to(3*f + 1)));
+}
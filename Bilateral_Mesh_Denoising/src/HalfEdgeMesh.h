@@ -0,0 +1,109 @@
+#ifndef HALF_EDGE_MESH_H
+#define HALF_EDGE_MESH_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// Index based half-edge connectivity of a triangle mesh. The three half-edges of face f are
+// 3f, 3f+1 and 3f+2, so next, prev and face are computed rather than stored; half-edge h runs
+// from corner h%3 to corner (h+1)%3 of its face. Only the vertex a half-edge points to, its twin
+// and one outgoing half-edge per vertex are stored (INVALID twin on the boundary), and the
+// outgoing half-edge of a boundary vertex is its boundary one, so that a counterclockwise walk
+// from it meets all the faces around the vertex.
+// Edges shared by more than two faces, or by two faces of opposite orientation, are left
+// unpaired and handled as boundaries; around a non-manifold vertex only one fan is walked.
+// Faces and vertices removed by collapseEdge are marked deleted and keep their index.
+class HalfEdgeMesh {
+public:
+  static const unsigned int INVALID = UINT32_MAX;
+
+  HalfEdgeMesh() {}
+  // Pairs the half-edges by sorting them on their (smaller, larger) vertex key in parallel
+  HalfEdgeMesh(const std::vector<glm::uvec3> &triangles, unsigned int vertexCount);
+
+  unsigned int halfEdgeCount() const { return static_cast<unsigned int>(_vertex.size()); }
+  unsigned int faceCount() const { return halfEdgeCount()/3; }
+  unsigned int vertexCount() const { return static_cast<unsigned int>(_outgoing.size()); }
+
+  static unsigned int face(unsigned int h) { return h/3; }
+  static unsigned int next(unsigned int h) { return h%3 == 2 ? h - 2 : h + 1; }
+  static unsigned int prev(unsigned int h) { return h%3 == 0 ? h + 2 : h - 1; }
+  unsigned int twin(unsigned int h) const { return _twin[h]; }
+  unsigned int to(unsigned int h) const { return _vertex[h]; }
+  unsigned int from(unsigned int h) const { return _vertex[prev(h)]; }
+  unsigned int outgoing(unsigned int v) const { return _outgoing[v]; }
+
+  bool isBoundary(unsigned int h) const { return _twin[h] == INVALID; }
+  bool isBoundaryVertex(unsigned int v) const { return _outgoing[v] != INVALID && isBoundary(_outgoing[v]); }
+  bool isDeletedFace(unsigned int f) const { return _vertex[3*f] == INVALID; }
+  bool isDeletedVertex(unsigned int v) const { return _outgoing[v] == INVALID; }
+
+  // Next outgoing half-edge around from(h), counterclockwise; INVALID past the boundary
+  unsigned int rotateCCW(unsigned int h) const { return _twin[prev(h)]; }
+  // Previous outgoing half-edge around from(h), clockwise; INVALID past the boundary
+  unsigned int rotateCW(unsigned int h) const { return _twin[h] == INVALID ? INVALID : next(_twin[h]); }
+
+  // Calls f(h) for the outgoing half-edges of v, counterclockwise, one step per half-edge
+  template<typename Function>
+  void forEachOutgoing(unsigned int v, Function f) const
+  {
+    const unsigned int start = _outgoing[v];
+    if(start == INVALID) return;
+    unsigned int h = start;
+    do {
+      f(h);
+      h = rotateCCW(h);
+    } while(h != INVALID && h != start);
+  }
+
+  // Calls f(u) for the one-ring neighbors u of v, the last one of a boundary vertex included
+  template<typename Function>
+  void forEachNeighbor(unsigned int v, Function f) const
+  {
+    unsigned int last = INVALID;
+    forEachOutgoing(v, [&](unsigned int h) {
+      f(to(h));
+      last = h;
+    });
+    if(last != INVALID && isBoundary(prev(last))) f(from(prev(last)));
+  }
+
+  // Calls f(face) for the faces around v
+  template<typename Function>
+  void forEachFace(unsigned int v, Function f) const
+  {
+    forEachOutgoing(v, [&](unsigned int h) { f(face(h)); });
+  }
+
+  unsigned int valence(unsigned int v) const;
+  // Half-edge from a to b, INVALID when there is none
+  unsigned int findHalfEdge(unsigned int a, unsigned int b) const;
+
+  // Replaces the edge of h, shared by the triangles (a, b, c) and (b, a, d), by the edge (c, d).
+  // Returns false, and changes nothing, on a boundary edge or when c and d are already linked.
+  bool flipEdge(unsigned int h);
+  // Inserts a new vertex, whose index is returned, on the edge of h and splits the one or two
+  // faces of the edge in two. The positions are left to the caller.
+  unsigned int splitEdge(unsigned int h);
+  // Merges from(h) into to(h) and removes the one or two faces of the edge. Returns false, and
+  // changes nothing, when the collapse would make the mesh non-manifold (link condition) or
+  // leave a vertex of valence below 3.
+  bool collapseEdge(unsigned int h);
+
+  // Triangles of the faces that are not deleted, in face order
+  void exportTriangles(std::vector<glm::uvec3> &triangles) const;
+
+private:
+  void link(unsigned int h, unsigned int t);
+  void setFace(unsigned int first, unsigned int a, unsigned int b, unsigned int c);
+  unsigned int addFace(unsigned int a, unsigned int b, unsigned int c);
+  void resetOutgoing(unsigned int v, unsigned int h);
+
+  std::vector<unsigned int> _vertex;    // per half-edge, the vertex it points to
+  std::vector<unsigned int> _twin;      // per half-edge
+  std::vector<unsigned int> _outgoing;  // per vertex
+};
+
+#endif  // HALF_EDGE_MESH_H
@@ -0,0 +1,123 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Minimal codec for the LZ4 block format (no frame, no checksum): a greedy single hash
+// compressor and a bounds checked decompressor. Blocks it writes can be read by the reference
+// LZ4_decompress_safe() and the other way around.
+namespace lz4 {
+
+const unsigned int MIN_MATCH = 4;
+const unsigned int LAST_LITERALS = 5;      // the last bytes of a block are always literals
+const unsigned int MATCH_LIMIT = 12;       // no match may start in the last 12 bytes
+const unsigned int MAX_OFFSET = 65535;
+const unsigned int HASH_BITS = 16;
+
+inline size_t compressBound(size_t size) { return size + size/255 + 16; }
+
+inline uint32_t read32(const uint8_t *p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+inline uint32_t hash(uint32_t sequence) { return (sequence*2654435761u) >> (32 - HASH_BITS); }
+
+inline void writeLength(std::vector<uint8_t> &out, size_t length)
+{
+  for(; length >= 255; length -= 255) out.push_back(255);
+  out.push_back(static_cast<uint8_t>(length));
+}
+
+inline void writeSequence(std::vector<uint8_t> &out, const uint8_t *literals, size_t literalCount,
+                          size_t offset, size_t matchLength)
+{
+  const size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+  out.push_back(static_cast<uint8_t>(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+  if(literalCount >= 15) writeLength(out, literalCount - 15);
+  out.insert(out.end(), literals, literals + literalCount);
+  if(!matchLength) return;
+  out.push_back(static_cast<uint8_t>(offset & 0xff));
+  out.push_back(static_cast<uint8_t>(offset >> 8));
+  if(matchCode >= 15) writeLength(out, matchCode - 15);
+}
+
+// Appends the compressed form of [src, src+size) to out
+inline void compress(const uint8_t *src, size_t size, std::vector<uint8_t> &out)
+{
+  out.reserve(out.size() + compressBound(size));
+  const uint8_t *anchor = src;
+  const uint8_t *end = src + size;
+  if(size > MATCH_LIMIT) {
+    std::vector<uint32_t> table(1u << HASH_BITS, 0);
+    const uint8_t *matchLimit = end - MATCH_LIMIT;
+    const uint8_t *ip = src + 1;
+    while(ip < matchLimit) {
+      const uint32_t sequence = read32(ip);
+      const uint32_t h = hash(sequence);
+      const uint8_t *ref = src + table[h];
+      table[h] = static_cast<uint32_t>(ip - src);
+      if(ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != sequence) {
+        ++ip;
+        continue;
+      }
+      while(ip > anchor && ref > src && ip[-1] == ref[-1]) { --ip; --ref; }
+      const uint8_t *matchEnd = ip + MIN_MATCH;
+      const uint8_t *ref2 = ref + MIN_MATCH;
+      while(matchEnd < end - LAST_LITERALS && *matchEnd == *ref2) { ++matchEnd; ++ref2; }
+      writeSequence(out, anchor, ip - anchor, ip - ref, matchEnd - ip);
+      // index the positions inside the match sparsely, it is enough for repetitive data
+      for(const uint8_t *p = ip + 1; p + 4 <= matchEnd && p < matchLimit; p += 2)
+        table[hash(read32(p))] = static_cast<uint32_t>(p - src);
+      ip = anchor = matchEnd;
+    }
+  }
+  writeSequence(out, anchor, end - anchor, 0, 0);
+}
+
+// Decompresses a block into exactly size bytes, returns false on corrupted input
+inline bool decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t size)
+{
+  const uint8_t *ip = src, *ipEnd = src + srcSize;
+  uint8_t *op = dst, *opEnd = dst + size;
+  while(ip < ipEnd) {
+    const unsigned int token = *ip++;
+    size_t literalCount = token >> 4;
+    if(literalCount == 15) {
+      uint8_t b;
+      do {
+        if(ip >= ipEnd) return false;
+        b = *ip++;
+        literalCount += b;
+      } while(b == 255);
+    }
+    if(literalCount > static_cast<size_t>(ipEnd - ip) || literalCount > static_cast<size_t>(opEnd - op)) return false;
+    std::memcpy(op, ip, literalCount);
+    op += literalCount;
+    ip += literalCount;
+    if(ip == ipEnd) break;  // the last sequence has no match
+
+    if(ipEnd - ip < 2) return false;
+    const size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    size_t matchLength = (token & 15);
+    if(matchLength == 15) {
+      uint8_t b;
+      do {
+        if(ip >= ipEnd) return false;
+        b = *ip++;
+        matchLength += b;
+      } while(b == 255);
+    }
+    matchLength += MIN_MATCH;
+    if(offset == 0 || offset > static_cast<size_t>(op - dst) || matchLength > static_cast<size_t>(opEnd - op)) return false;
+    // byte by byte copy, the match may overlap the bytes being written
+    const uint8_t *ref = op - offset;
+    for(size_t i = 0; i < matchLength; ++i) op[i] = ref[i];
+    op += matchLength;
+  }
+  return op == opEnd;
+}
+
+} // namespace lz4
+
+#endif  // LZ4_H
@@ -0,0 +1,177 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <ios>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view on the whole content of a file, memory mapped when the platform allows it
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &filename)
+  {
+#ifdef _WIN32
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if(!in)
+      throw std::ios_base::failure("[Mesh Loader] Cannot open " + filename);
+    _buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    _data = _buffer.data();
+    _size = _buffer.size();
+#else
+    _fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if(_fd < 0 || fstat(_fd, &st) != 0) {
+      if(_fd >= 0) close(_fd);
+      throw std::ios_base::failure("[Mesh Loader] Cannot open " + filename);
+    }
+    _size = st.st_size;
+    if(_size > 0) {
+      void *p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+      if(p == MAP_FAILED) {
+        close(_fd);
+        throw std::ios_base::failure("[Mesh Loader] Cannot map " + filename);
+      }
+      madvise(p, _size, MADV_SEQUENTIAL);
+      _data = static_cast<const char*>(p);
+    }
+#endif
+  }
+
+  ~MappedFile()
+  {
+#ifndef _WIN32
+    if(_data) munmap(const_cast<char*>(_data), _size);
+    if(_fd >= 0) close(_fd);
+#endif
+  }
+
+  const char *begin() const { return _data; }
+  const char *end() const { return _data + _size; }
+  size_t size() const { return _size; }
+
+  // Drops the pages read so far from the resident set, the next accesses read them again from the
+  // page cache or the file. Safe while other threads read the mapping.
+  void evict() const
+  {
+#ifndef _WIN32
+    if(_data) madvise(const_cast<char*>(_data), _size, MADV_DONTNEED);
+#endif
+  }
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  const char *_data = nullptr;
+  size_t _size = 0;
+#ifdef _WIN32
+  std::vector<char> _buffer;
+#else
+  int _fd = -1;
+#endif
+};
+
+// Read-write view on the whole content of an existing file, whose size does not change. The file
+// is mapped shared, so the writes reach it without copies; without mmap it is read in a buffer
+// and written back on destruction.
+class WritableMappedFile {
+public:
+  explicit WritableMappedFile(const std::string &filename) : _filename(filename)
+  {
+#ifdef _WIN32
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if(!in)
+      throw std::ios_base::failure("[Mapped File] Cannot open " + filename);
+    _buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    _data = _buffer.data();
+    _size = _buffer.size();
+#else
+    _fd = open(filename.c_str(), O_RDWR);
+    struct stat st;
+    if(_fd < 0 || fstat(_fd, &st) != 0) {
+      if(_fd >= 0) close(_fd);
+      throw std::ios_base::failure("[Mapped File] Cannot open " + filename);
+    }
+    _size = st.st_size;
+    if(_size > 0) {
+      void *p = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+      if(p == MAP_FAILED) {
+        close(_fd);
+        throw std::ios_base::failure("[Mapped File] Cannot map " + filename);
+      }
+      _data = static_cast<char*>(p);
+    }
+#endif
+  }
+
+  ~WritableMappedFile()
+  {
+#ifdef _WIN32
+    std::ofstream out(_filename.c_str(), std::ios::binary);
+    out.write(_buffer.data(), _buffer.size());
+#else
+    if(_data) munmap(_data, _size);
+    if(_fd >= 0) close(_fd);
+#endif
+  }
+
+  // Creates filename, or empties it, then extends it to size zero bytes without writing them
+  static void createFile(const std::string &filename, uint64_t size)
+  {
+#ifdef _WIN32
+    std::FILE *f = std::fopen(filename.c_str(), "wb");
+    bool ok = f && _chsize_s(_fileno(f), static_cast<__int64>(size)) == 0;
+    if(f) ok = std::fclose(f) == 0 && ok;
+#else
+    const int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) == 0;
+    if(fd >= 0) ok = close(fd) == 0 && ok;
+#endif
+    if(!ok)
+      throw std::ios_base::failure("[Mapped File][createFile] Cannot write " + filename);
+  }
+
+  char *begin() { return _data; }
+  char *end() { return _data + _size; }
+  size_t size() const { return _size; }
+
+  // Starts writing the modified pages back and drops every page from the resident set; the
+  // content is kept by the page cache. Safe while other threads access the mapping.
+  void evict()
+  {
+#ifndef _WIN32
+    if(_data) {
+      msync(_data, _size, MS_ASYNC);
+      madvise(_data, _size, MADV_DONTNEED);
+    }
+#endif
+  }
+
+private:
+  WritableMappedFile(const WritableMappedFile &);
+  WritableMappedFile &operator=(const WritableMappedFile &);
+
+  std::string _filename;
+  char *_data = nullptr;
+  size_t _size = 0;
+#ifdef _WIN32
+  std::vector<char> _buffer;
+#else
+  int _fd = -1;
+#endif
+};
+
+#endif  // MAPPED_FILE_H
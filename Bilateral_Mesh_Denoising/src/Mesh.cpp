@@ -1,6 +1,10 @@
 #define _USE_MATH_DEFINES
 
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "MeshIO.h"
+#include "TextTokenizer.h"
+#include "NumberFormat.h"
 
 #include <cmath>
 #include <algorithm>
@@ -10,6 +14,16 @@
 #include <ios>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <functional>
+
 
 Mesh::~Mesh()
 {
@@ -18,37 +32,185 @@ Mesh::~Mesh()
 
 void Mesh::computeBoundingSphere(glm::vec3 &center, float &radius) const
 {
-  center = glm::vec3(0.0);
-  radius = 0.f;
-  for(const auto &p : _vertexPositions)
-    center += p;
-  center /= _vertexPositions.size();
-  for(const auto &p : _vertexPositions)
-    radius = std::max(radius, distance(center, p));
+  if(_boundsGeneration != _positionsGeneration) {
+    syncPositionArrays();
+    boundingSphere(_positionArrays, _boundsCenter, _boundsRadius);
+    _boundsGeneration = _positionsGeneration;
+  }
+  center = _boundsCenter;
+  radius = _boundsRadius;
+}
+
+void Mesh::syncPositionArrays() const
+{
+  if(_positionArraysGeneration == _positionsGeneration && _positionArrays.size() == _vertexPositions.size()) return;
+  _positionArrays.assign(_vertexPositions);
+  _positionArraysGeneration = _positionsGeneration;
+}
+
+Mesh::Snapshot Mesh::snapshot() const
+{
+  std::lock_guard<std::mutex> lock(_snapshotMutex);
+  if(_snapshotPositions != _positionsGeneration) {
+    _snapshot.positions.assign(_vertexPositions, _snapshot.positions);
+    _snapshotPositions = _positionsGeneration;
+  }
+  if(_snapshotTopology != _topologyGeneration) {
+    _snapshot.triangles.assign(_triangleIndices, _snapshot.triangles);
+    _snapshotTopology = _topologyGeneration;
+  }
+  // the colors have no generation, the unchanged chunks are found by comparison
+  _snapshot.colors.assign(_vertexColors, _snapshot.colors);
+  _snapshot.noNoisePositions = _noNoiseVertexPositions;
+  _snapshot.noisyPositions = _noisyVertexPositions;
+  return _snapshot;
+}
+
+void Mesh::restore(const Snapshot &s)
+{
+  // the chunks shared with the snapshot of the current mesh are already in place
+  const Snapshot current = snapshot();
+  s.positions.copyTo(_vertexPositions, current.positions);
+  if(s.triangles.sameAs(current.triangles)) {
+    positionsChanged();
+  } else {
+    s.triangles.copyTo(_triangleIndices, current.triangles);
+    topologyChanged();
+  }
+  s.colors.copyTo(_vertexColors, current.colors);
+  _noNoiseVertexPositions = s.noNoisePositions;
+  _noisyVertexPositions = s.noisyPositions;
+  {
+    std::lock_guard<std::mutex> lock(_snapshotMutex);
+    _snapshot = s;
+    _snapshotPositions = _positionsGeneration;
+    _snapshotTopology = _topologyGeneration;
+  }
+  recomputePerVertexNormals();
+  recomputePerVertexTextureCoordinates();
+}
+
+const size_t Mesh::UNDO_LEVELS;
+
+void Mesh::pushUndo()
+{
+  pushUndoSnapshot();
+  _redoSnapshots.clear();
+}
+
+void Mesh::pushUndoSnapshot()
+{
+  _undoSnapshots.push_back(snapshot());
+  if(_undoSnapshots.size() > UNDO_LEVELS) _undoSnapshots.erase(_undoSnapshots.begin());
+}
+
+bool Mesh::undo()
+{
+  if(_undoSnapshots.empty()) return false;
+  _redoSnapshots.push_back(snapshot());
+  restore(_undoSnapshots.back());
+  _undoSnapshots.pop_back();
+  return true;
+}
+
+bool Mesh::redo()
+{
+  if(_redoSnapshots.empty()) return false;
+  pushUndoSnapshot();
+  restore(_redoSnapshots.back());
+  _redoSnapshots.pop_back();
+  return true;
 }
 
 void Mesh::recomputePerVertexNormals(bool angleBased)
 {
-  _vertexNormals.clear();
-  // Change the following code to compute a proper per-vertex normal
-  _vertexNormals.resize(_vertexPositions.size(), glm::vec3(0.0, 0.0, 0.0));
+  if(_vertexNormalsStamp == currentStamp() && _vertexNormalsAngleBased == angleBased
+     && _vertexNormals.size() == _vertexPositions.size())
+    return;
+  calculateVertexFaceAdjacency();
+  calculateTrianglesAreas();
+  if(angleBased && !(_triangleAnglesStamp == currentStamp())) {
+    Vec3Arrays angles;
+    triangleAngles(_positionArrays, _triangleIndices, angles);
+    angles.toInterleaved(_triangleAngles);
+    _triangleAnglesStamp = currentStamp();
+  }
+  _vertexNormals.resize(_vertexPositions.size());
+  parallelFor(0, _vertexPositions.size(), [&](unsigned int v) {
+    _vertexNormals[v] = gatherVertexNormal(v, angleBased);
+  });
+  ++_normalsGeneration;
+  _vertexNormalsStamp = currentStamp();
+  _vertexNormalsAngleBased = angleBased;
+}
 
-  for(unsigned int tIt=0 ; tIt < _triangleIndices.size() ; ++tIt) {
-    glm::uvec3 t = _triangleIndices[tIt];
-    glm::vec3 n_t = glm::cross(
-      _vertexPositions[t[1]] - _vertexPositions[t[0]],
-      _vertexPositions[t[2]] - _vertexPositions[t[0]]);
-    _vertexNormals[t[0]] += n_t;
-    _vertexNormals[t[1]] += n_t;
-    _vertexNormals[t[2]] += n_t;
+void Mesh::recomputePerVertexNormals(const std::vector<unsigned int> &movedVertices, bool angleBased)
+{
+  // the face data must match the positions the normals were computed from
+  const Stamp previous = _vertexNormalsStamp;
+  if(previous.topology != _topologyGeneration || _vertexNormalsAngleBased != angleBased
+     || _vertexFaceTopology != _topologyGeneration || !(_faceGeometryStamp == previous)
+     || (angleBased && !(_triangleAnglesStamp == previous)) || _positionArraysGeneration != previous.positions) {
+    recomputePerVertexNormals(angleBased);
+    return;
+  }
+
+  std::vector<unsigned int> faces, vertices;
+  for(unsigned int v : movedVertices)
+    faces.insert(faces.end(), _vertexFaces.begin() + _vertexFaceOffsets[v], _vertexFaces.begin() + _vertexFaceOffsets[v + 1]);
+  std::sort(faces.begin(), faces.end());
+  faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+  for(unsigned int f : faces)
+    for(unsigned int c = 0; c < 3; ++c) vertices.push_back(_triangleIndices[f][c]);
+  std::sort(vertices.begin(), vertices.end());
+  vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+  // the faces are recomputed by the kernels of the full update, for the same rounding
+  for(unsigned int v : movedVertices) _positionArrays.set(v, _vertexPositions[v]);
+  std::vector<glm::uvec3> triangles(faces.size());
+  for(unsigned int i = 0; i < faces.size(); ++i) triangles[i] = _triangleIndices[faces[i]];
+  Vec3Arrays normals, angles;
+  std::vector<float> areas;
+  triangleNormalsAndAreas(_positionArrays, triangles, normals, areas);
+  if(angleBased) triangleAngles(_positionArrays, triangles, angles);
+  for(unsigned int i = 0; i < faces.size(); ++i) {
+    _triangleNormals[faces[i]] = normals[i];
+    _triangleArea[faces[i]] = areas[i];
+    if(angleBased) _triangleAngles[faces[i]] = angles[i];
   }
-  for(unsigned int nIt = 0 ; nIt < _vertexNormals.size() ; ++nIt) {
-    glm::normalize(_vertexNormals[nIt]);
+  parallelFor(0, vertices.size(), [&](unsigned int i) {
+    _vertexNormals[vertices[i]] = gatherVertexNormal(vertices[i], angleBased);
+  }, 256);
+  ++_normalsGeneration;
+  _vertexNormalsStamp = _faceGeometryStamp = currentStamp();
+  if(angleBased) _triangleAnglesStamp = currentStamp();
+  _positionArraysGeneration = _positionsGeneration;
+}
+
+// Sum of the unit normals of the faces around v, weighted by their area or by the angle of their
+// corner at v, normalized; zero for a vertex without faces. Degenerate faces are skipped.
+glm::vec3 Mesh::gatherVertexNormal(unsigned int v, bool angleBased) const
+{
+  glm::vec3 normal(0.f);
+  for(unsigned int k = _vertexFaceOffsets[v]; k < _vertexFaceOffsets[v + 1]; ++k) {
+    const unsigned int f = _vertexFaces[k];
+    if(!(_triangleArea[f] > 0.f)) continue;
+    float weight = _triangleArea[f];
+    if(angleBased) {
+      const glm::uvec3 &t = _triangleIndices[f];
+      weight = _triangleAngles[f][t[0] == v ? 0 : (t[1] == v ? 1 : 2)];
+    }
+    normal += weight*_triangleNormals[f];
   }
+  const float length = glm::length(normal);
+  return length > 0.f ? normal/length : normal;
 }
 
 void Mesh::recomputePerVertexTextureCoordinates()
 {
+  if(_texCoordsStamp == _positionsGeneration && _vertexTexCoords.size() == _vertexPositions.size()) return;
+  ++_texCoordsGeneration;
+  _texCoordsStamp = _positionsGeneration;
   _vertexTexCoords.clear();
   // Change the following code to compute a proper per-vertex texture coordinates
   _vertexTexCoords.resize(_vertexPositions.size(), glm::vec2(0.0, 0.0));
@@ -89,10 +251,421 @@ void Mesh::addPlan(float square_half_side)
     glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
   _triangleIndices.push_back(
     glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
+  topologyChanged();
+  normalsChanged();
+  texCoordsChanged();
+}
+
+void Mesh::prepareHeatGeodesics(float timeFactor)
+{
+  const unsigned int n = _vertexPositions.size();
+  std::vector<Triplet> laplacianTriplets, massTriplets;
+  laplacianTriplets.reserve(12*_triangleIndices.size());
+  massTriplets.reserve(n);
+  std::vector<double> mass(n, 0.0);
+  _triangleCotangents.resize(_triangleIndices.size());
+
+  double meanEdgeLength = 0.0;
+  for(unsigned int tIt = 0; tIt < _triangleIndices.size(); ++tIt) {
+    const glm::uvec3 &t = _triangleIndices[tIt];
+    for(unsigned int c = 0; c < 3; ++c) {
+      // cotangent of the angle at corner c, which is opposite to the edge (c+1, c+2)
+      const glm::vec3 u = _vertexPositions[t[(c+1)%3]] - _vertexPositions[t[c]];
+      const glm::vec3 v = _vertexPositions[t[(c+2)%3]] - _vertexPositions[t[c]];
+      const float crossNorm = glm::length(glm::cross(u, v));
+      _triangleCotangents[tIt][c] = crossNorm > 0.f ? glm::dot(u, v)/crossNorm : 0.f;
+      meanEdgeLength += glm::length(u);
+    }
+    const double area = 0.5*glm::length(glm::cross(
+      _vertexPositions[t[1]] - _vertexPositions[t[0]],
+      _vertexPositions[t[2]] - _vertexPositions[t[0]]));
+    for(unsigned int c = 0; c < 3; ++c) {
+      const unsigned int i = t[(c+1)%3], j = t[(c+2)%3];
+      const double w = 0.5*_triangleCotangents[tIt][c];
+      laplacianTriplets.push_back(Triplet(i, j, -w));
+      laplacianTriplets.push_back(Triplet(j, i, -w));
+      laplacianTriplets.push_back(Triplet(i, i, w));
+      laplacianTriplets.push_back(Triplet(j, j, w));
+      mass[t[c]] += area/3.0;
+    }
+  }
+  meanEdgeLength /= std::max<size_t>(1, 3*_triangleIndices.size());
+  for(unsigned int i = 0; i < n; ++i)
+    massTriplets.push_back(Triplet(i, i, mass[i]));
+
+  SparseMatrix laplacian, massMatrix;
+  laplacian.setFromTriplets(n, laplacianTriplets);
+  massMatrix.setFromTriplets(n, massTriplets);
+
+  const double t = timeFactor*meanEdgeLength*meanEdgeLength;
+  SparseMatrix heatOperator, poissonOperator;
+  heatOperator.setLinearCombination(1.0, massMatrix, t, laplacian);
+  // L is only semi-definite: a tiny mass term makes the Poisson problem definite
+  poissonOperator.setLinearCombination(1.0, laplacian, 1e-8/t, massMatrix);
+  if(!_heatSolver.factorize(heatOperator) || !_poissonSolver.factorize(poissonOperator))
+    std::cout << "[Mesh][prepareHeatGeodesics] Factorization failed, degenerated mesh?" << std::endl;
+}
+
+void Mesh::computeGeodesicDistances(const std::vector<unsigned int> &sources, std::vector<float> &distances)
+{
+  const unsigned int n = _vertexPositions.size();
+  if(_heatSolver.empty())
+    prepareHeatGeodesics();
+
+  // 1. diffuse heat from the sources
+  std::vector<double> delta(n, 0.0);
+  for(unsigned int s : sources)
+    delta[s] = 1.0;
+  std::vector<double> heat;
+  _heatSolver.solve(delta, heat);
+
+  // 2. normalized gradient field, and its integrated divergence on the vertices
+  std::vector<double> divergence(n, 0.0);
+  for(unsigned int tIt = 0; tIt < _triangleIndices.size(); ++tIt) {
+    const glm::uvec3 &t = _triangleIndices[tIt];
+    // the heat decays exponentially, double precision keeps the far field direction meaningful
+    const glm::dvec3 p[3] = { _vertexPositions[t[0]], _vertexPositions[t[1]], _vertexPositions[t[2]] };
+    const glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+    glm::dvec3 gradient(0.0);
+    for(unsigned int c = 0; c < 3; ++c)
+      gradient += heat[t[c]]*glm::cross(normal, p[(c+2)%3] - p[(c+1)%3]);
+    const double gradientNorm = glm::length(gradient);
+    if(gradientNorm == 0.0) continue;
+    const glm::dvec3 X = -gradient/gradientNorm;
+    for(unsigned int c = 0; c < 3; ++c) {
+      const glm::dvec3 e1 = p[(c+1)%3] - p[c];
+      const glm::dvec3 e2 = p[(c+2)%3] - p[c];
+      divergence[t[c]] += 0.5*(_triangleCotangents[tIt][(c+2)%3]*glm::dot(e1, X) +
+                               _triangleCotangents[tIt][(c+1)%3]*glm::dot(e2, X));
+    }
+  }
+
+  // 3. recover the distance whose gradient best matches the field (L is positive, hence the sign)
+  for(unsigned int i = 0; i < n; ++i)
+    divergence[i] = -divergence[i];
+  std::vector<double> phi;
+  _poissonSolver.solve(divergence, phi);
+
+  double shift = phi[sources.empty() ? 0 : sources[0]];
+  for(unsigned int s : sources)
+    shift = std::min(shift, phi[s]);
+  distances.resize(n);
+  for(unsigned int i = 0; i < n; ++i)
+    distances[i] = (float)(phi[i] - shift);
+}
+
+void Mesh::calculateVertexFaceAdjacency()
+{
+  if(_vertexFaceTopology == _topologyGeneration && _vertexFaceOffsets.size() == _vertexPositions.size() + 1) return;
+  _vertexFaceTopology = _topologyGeneration;
+  _vertexFaceOffsets.assign(_vertexPositions.size() + 1, 0);
+  for(const glm::uvec3 &t : _triangleIndices)
+    for(unsigned int c = 0; c < 3; ++c)
+      _vertexFaceOffsets[t[c] + 1]++;
+  for(unsigned int i = 0; i < _vertexPositions.size(); ++i)
+    _vertexFaceOffsets[i + 1] += _vertexFaceOffsets[i];
+
+  std::vector<unsigned int> cursor(_vertexFaceOffsets.begin(), _vertexFaceOffsets.end() - 1);
+  _vertexFaces.resize(_vertexFaceOffsets.back());
+  for(unsigned int tIt = 0; tIt < _triangleIndices.size(); ++tIt)
+    for(unsigned int c = 0; c < 3; ++c)
+      _vertexFaces[cursor[_triangleIndices[tIt][c]]++] = tIt;
+}
+
+void Mesh::calculateFaceAdjacency()
+{
+  if(_faceFaceTopology == _topologyGeneration) return;
+  _faceFaceTopology = _topologyGeneration;
+  calculateVertexFaceAdjacency();
+  const unsigned int faceCount = _triangleIndices.size();
+
+  // faces sharing at least one vertex with the face f, f excluded
+  auto gatherNeighbors = [&](unsigned int f, std::vector<unsigned int> &neighbors) {
+    neighbors.clear();
+    for(unsigned int c = 0; c < 3; ++c) {
+      const unsigned int v = _triangleIndices[f][c];
+      for(unsigned int k = _vertexFaceOffsets[v]; k < _vertexFaceOffsets[v + 1]; ++k)
+        if(_vertexFaces[k] != f) neighbors.push_back(_vertexFaces[k]);
+    }
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+  };
+
+  // two passes: count, prefix sum, then fill at the final offsets
+  _faceFaceOffsets.assign(faceCount + 1, 0);
+  parallelFor(0, faceCount, [&](unsigned int f) {
+    std::vector<unsigned int> neighbors;
+    gatherNeighbors(f, neighbors);
+    _faceFaceOffsets[f + 1] = neighbors.size();
+  });
+  for(unsigned int f = 0; f < faceCount; ++f)
+    _faceFaceOffsets[f + 1] += _faceFaceOffsets[f];
+  _faceFaces.resize(_faceFaceOffsets.back());
+  parallelFor(0, faceCount, [&](unsigned int f) {
+    std::vector<unsigned int> neighbors;
+    gatherNeighbors(f, neighbors);
+    std::copy(neighbors.begin(), neighbors.end(), _faceFaces.begin() + _faceFaceOffsets[f]);
+  });
+}
+
+void Mesh::bilateralNormalFiltering()
+{
+  std::cout << "Value of sigma_n: " << sigma_n << std::endl;
+  if (_noisyVertexPositions.empty())
+    _noisyVertexPositions = snapshot().positions;
+  calculateFaceAdjacency();
+  const unsigned int faceCount = _triangleIndices.size();
+  const unsigned int vertexCount = _vertexPositions.size();
+
+  calculateTrianglesAreas();
+  std::vector<glm::vec3> centroids(faceCount);
+  parallelFor(0, faceCount, [&](unsigned int f) {
+    const glm::uvec3 &t = _triangleIndices[f];
+    centroids[f] = (_vertexPositions[t[0]] + _vertexPositions[t[1]] + _vertexPositions[t[2]])/3.f;
+  });
+
+  // the spatial parameter is the mean distance between adjacent face centroids
+  double meanDistance = 0.0;
+  for(unsigned int f = 0; f < faceCount; ++f)
+    for(unsigned int k = _faceFaceOffsets[f]; k < _faceFaceOffsets[f + 1]; ++k)
+      meanDistance += glm::length(centroids[f] - centroids[_faceFaces[k]]);
+  const float sigmaCenter = (float)(meanDistance/std::max<size_t>(1, _faceFaces.size()));
+  std::cout << "Value of sigma_c (face centroids): " << sigmaCenter << std::endl;
+
+  // Stage 1: bilateral filtering of the face normals
+  std::vector<glm::vec3> filteredNormals(faceCount);
+  for (int it = 0; it < normalIterations; ++it){
+    parallelFor(0, faceCount, [&](unsigned int f) {
+      glm::vec3 sum = _triangleArea[f]*_triangleNormals[f];
+      for(unsigned int k = _faceFaceOffsets[f]; k < _faceFaceOffsets[f + 1]; ++k) {
+        const unsigned int g = _faceFaces[k];
+        const float dc = glm::length(centroids[f] - centroids[g]);
+        const float ds = glm::length(_triangleNormals[f] - _triangleNormals[g]);
+        const float w = _triangleArea[g]*
+          std::exp(-dc*dc/(2.f*sigmaCenter*sigmaCenter))*std::exp(-ds*ds/(2.f*sigma_n*sigma_n));
+        sum += w*_triangleNormals[g];
+      }
+      const float norm = glm::length(sum);
+      filteredNormals[f] = norm > 0.f ? sum/norm : _triangleNormals[f];
+    });
+    _triangleNormals.swap(filteredNormals);
+  }
+  _faceGeometryStamp = Stamp(); // the face normals are no longer those of the positions
+
+  // Stage 2: move every vertex towards the planes defined by its faces and their filtered normals
+  std::vector<glm::vec3> newPositions(vertexCount);
+  for (int it = 0; it < vertexIterations; ++it){
+    parallelFor(0, faceCount, [&](unsigned int f) {
+      const glm::uvec3 &t = _triangleIndices[f];
+      centroids[f] = (_vertexPositions[t[0]] + _vertexPositions[t[1]] + _vertexPositions[t[2]])/3.f;
+    });
+    parallelFor(0, vertexCount, [&](unsigned int v) {
+      const unsigned int begin = _vertexFaceOffsets[v], end = _vertexFaceOffsets[v + 1];
+      glm::vec3 displacement(0.f);
+      for(unsigned int k = begin; k < end; ++k) {
+        const unsigned int f = _vertexFaces[k];
+        displacement += _triangleNormals[f]*glm::dot(_triangleNormals[f], centroids[f] - _vertexPositions[v]);
+      }
+      newPositions[v] = end > begin ? _vertexPositions[v] + displacement/(float)(end - begin) : _vertexPositions[v];
+    });
+    _vertexPositions.swap(newPositions);
+  }
+  positionsChanged();
+
+  recomputePerVertexNormals();
+  std::cout << "Two-stage Bilateral Normal Filtering Applied" << std::endl;
+  computeError();
+}
+
+std::shared_ptr<Mesh> Mesh::simplify(float cellSize, std::vector<unsigned int> &correspondence) const
+{
+  auto coarse = std::make_shared<Mesh>();
+  auto &P = coarse->vertexPositions();
+  auto &T = coarse->triangleIndices();
+  glm::vec3 minCorner(INFINITY);
+  for (const glm::vec3 &p : _vertexPositions)
+    minCorner = glm::min(minCorner, p);
+
+  // one coarse vertex per occupied grid cell
+  std::unordered_map<uint64_t, unsigned int> cells;
+  std::vector<unsigned int> counts;
+  correspondence.resize(_vertexPositions.size());
+  // a cell size that is not positive keeps every vertex in its own cell
+  const bool vertexCells = !(cellSize > 0.f);
+  for (unsigned int v = 0; v < _vertexPositions.size(); ++v){
+    const glm::uvec3 cell = vertexCells ? glm::uvec3(0) : glm::uvec3((_vertexPositions[v] - minCorner)/cellSize);
+    const uint64_t key = vertexCells ? v : ((uint64_t)cell.x << 42) | ((uint64_t)cell.y << 21) | (uint64_t)cell.z;
+    auto it = cells.find(key);
+    if (it == cells.end()){
+      it = cells.insert(std::make_pair(key, (unsigned int)P.size())).first;
+      P.push_back(glm::vec3(0.f));
+      counts.push_back(0);
+    }
+    correspondence[v] = it->second;
+    P[it->second] += _vertexPositions[v];
+    counts[it->second]++;
+  }
+  for (unsigned int c = 0; c < P.size(); ++c)
+    P[c] /= (float)counts[c];
+
+  // keep the triangles whose corners fell in three different cells
+  std::set<std::vector<unsigned int>> seen;
+  for (const glm::uvec3 &t : _triangleIndices){
+    const glm::uvec3 ct(correspondence[t[0]], correspondence[t[1]], correspondence[t[2]]);
+    if (ct[0] == ct[1] || ct[1] == ct[2] || ct[2] == ct[0]) continue;
+    std::vector<unsigned int> sorted = { ct[0], ct[1], ct[2] };
+    std::sort(sorted.begin(), sorted.end());
+    if (seen.insert(sorted).second) T.push_back(ct);
+  }
+  coarse->topologyChanged();
+  coarse->normalsChanged();
+  coarse->texCoordsChanged();
+  coarse->vertexNormals().resize(P.size(), glm::vec3(0.f, 0.f, 1.f));
+  coarse->vertexTexCoords().resize(P.size(), glm::vec2(0.f, 0.f));
+  coarse->setSigma_s(sigma_s);
+  coarse->setRingSize(ringSize);
+  return coarse;
+}
+
+void Mesh::multigridBilateralFiltering()
+{
+  if (_noisyVertexPositions.empty())
+    _noisyVertexPositions = snapshot().positions;
+
+  double meanEdgeLength = 0.0;
+  for (const glm::uvec3 &t : _triangleIndices)
+    for (unsigned int c = 0; c < 3; ++c)
+      meanEdgeLength += glm::length(_vertexPositions[t[c]] - _vertexPositions[t[(c+1)%3]]);
+  meanEdgeLength /= std::max<size_t>(1, 3*_triangleIndices.size());
+
+  // without a positive cell size (edges of zero length) there is no coarser level
+  const float cellSize = coarseningFactor*(float)meanEdgeLength;
+  if (!(cellSize > 0.f)){
+    std::cout << "No coarse level for a cell size of " << cellSize << ", filtering the fine mesh only" << std::endl;
+    bilateralFiltering();
+    return;
+  }
+
+  // 1. filter the simplified mesh
+  std::vector<unsigned int> correspondence;
+  std::shared_ptr<Mesh> coarse = simplify(cellSize, correspondence);
+  const Mesh &coarseMesh = *coarse;  // read only, a write would have to report the change
+  const std::vector<glm::vec3> &coarsePositions = coarseMesh.vertexPositions();
+  std::cout << "Coarse level: " << coarsePositions.size() << " vertices, "
+            << coarseMesh.triangleIndices().size() << " triangles" << std::endl;
+  const std::vector<glm::vec3> coarseBefore = coarsePositions;
+  coarse->bilateralFiltering();
+
+  // 2. prolongation: every fine vertex receives the displacement of its coarse vertex, averaged
+  // over its one-ring to soften the seams between clusters
+  std::vector<glm::vec3> displacement(_vertexPositions.size());
+  for (unsigned int v = 0; v < _vertexPositions.size(); ++v)
+    displacement[v] = coarsePositions[correspondence[v]] - coarseBefore[correspondence[v]];
+  calculateVertexFaceAdjacency();
+  std::vector<glm::vec3> smoothed(_vertexPositions.size());
+  parallelFor(0, _vertexPositions.size(), [&](unsigned int v) {
+    glm::vec3 sum(0.f);
+    unsigned int count = 0;
+    for (unsigned int k = _vertexFaceOffsets[v]; k < _vertexFaceOffsets[v + 1]; ++k)
+      for (unsigned int c = 0; c < 3; ++c){
+        sum += displacement[_triangleIndices[_vertexFaces[k]][c]];
+        ++count;
+      }
+    smoothed[v] = count > 0 ? sum/(float)count : displacement[v];
+  });
+  for (unsigned int v = 0; v < _vertexPositions.size(); ++v)
+    if (!std::isnan(smoothed[v].x)) _vertexPositions[v] += smoothed[v];
+  positionsChanged();
+
+  // 3. only the high frequencies are left for the fine level
+  bilateralFiltering(fineIterations);
+  recomputePerVertexNormals();
+}
+
+std::vector<Mesh::SweepResult> Mesh::sweepParameters(const std::vector<float> &sigma_s_values,
+                                                     const std::vector<float> &sigma_c_values,
+                                                     const std::vector<int> &iteration_values)
+{
+  std::vector<SweepResult> results;
+  if (_noNoiseVertexPositions.empty() || sigma_s_values.empty() || sigma_c_values.empty() || iteration_values.empty()){
+    std::cout << "[Mesh][sweepParameters] Add noise first and give at least one value per parameter" << std::endl;
+    return results;
+  }
+
+  // shared structures, built once for the largest support
+  const float maxSigma_c = *std::max_element(sigma_c_values.begin(), sigma_c_values.end());
+  const int maxIterations = *std::max_element(iteration_values.begin(), iteration_values.end());
+  if (ringSize > 0) calculateRingNeighborhood(ringSize);
+  else calculateDistanceNeighborhood(2.0f * maxSigma_c);
+  calculateVertexFaceAdjacency();
+
+  const unsigned int pairCount = sigma_s_values.size()*sigma_c_values.size();
+  results.resize(pairCount*iteration_values.size());
+  const Vec3Arrays noisyPositions(_vertexPositions);
+
+  // one task per (sigma_s, sigma_c) pair, the iteration counts are read along the way
+  parallelFor(0, pairCount, [&](unsigned int pair) {
+    const float s = sigma_s_values[pair / sigma_c_values.size()];
+    const float c = sigma_c_values[pair % sigma_c_values.size()];
+    const float maxDistance = ringSize > 0 ? INFINITY : 2.0f * c;
+    for (unsigned int k = 0; k < iteration_values.size(); ++k){
+      SweepResult &r = results[pair*iteration_values.size() + k];
+      r.sigma_s = s;
+      r.sigma_c = c;
+      r.iterations = iteration_values[k];
+      r.error = INFINITY;
+    }
+    Vec3Arrays positions = noisyPositions;
+    std::vector<glm::vec3> normals(positions.size());
+    for (int it = 1; it <= maxIterations; ++it){
+      // area weighted normals, as in calculateVertexWeightedNormals
+      for (unsigned int v = 0; v < positions.size(); ++v){
+        glm::vec3 weightedNormal(0.f);
+        float totalArea = 0.f;
+        for (unsigned int k = _vertexFaceOffsets[v]; k < _vertexFaceOffsets[v + 1]; ++k){
+          const glm::uvec3 &t = _triangleIndices[_vertexFaces[k]];
+          const glm::vec3 a = positions[t[0]];
+          const glm::vec3 n = glm::cross(positions[t[1]] - a, positions[t[2]] - a);
+          totalArea += glm::length(n)/2.0f;
+          weightedNormal += n/2.0f;
+        }
+        normals[v] = weightedNormal/totalArea;
+      }
+      for (unsigned int v = 0; v < positions.size(); ++v){
+        const ArenaVector<unsigned int> &Q = _distanceNeighborhood[v];
+        float offset = 0;
+        if (::bilateralOffset(positions, positions[v], normals[v], Q.data(), Q.size(), c, s, maxDistance, offset)
+            && !std::isnan(offset))
+          positions.set(v, positions[v] + normals[v]*offset);
+      }
+      for (unsigned int k = 0; k < iteration_values.size(); ++k){
+        if (iteration_values[k] != it) continue;
+        double error = 0;
+        for (unsigned int v = 0; v < positions.size(); ++v)
+          error += glm::length(positions[v] - _noNoiseVertexPositions[v]);
+        results[pair*iteration_values.size() + k].error = error;
+      }
+    }
+  }, 1);
+
+  std::cout << "sigma_s\tsigma_c\titerations\terror" << std::endl;
+  const SweepResult *best = &results[0];
+  for (const SweepResult &r : results){
+    std::cout << r.sigma_s << "\t" << r.sigma_c << "\t" << r.iterations << "\t" << r.error << std::endl;
+    if (r.error < best->error) best = &r;
+  }
+  std::cout << "Best setting: sigma_s = " << best->sigma_s << ", sigma_c = " << best->sigma_c
+            << ", " << best->iterations << " iterations (error " << best->error << ")" << std::endl;
+  return results;
 }
 
 #ifdef SUPPORT_OPENGL_45
-void Mesh::init()
+void Mesh::updateBuffer(GLuint buffer, GLenum, size_t size, const void *data)
+{
+  glNamedBufferSubData(buffer, 0, size, data);
+}
+
+void Mesh::createBuffers()
 {
   glCreateBuffers(1, &_posVbo); // Generate a GPU buffer to store the positions of the vertices
   size_t vertexBufferSize = sizeof(glm::vec3)*_vertexPositions.size(); // Gather the size of the buffer from the CPU-side vector
@@ -128,7 +701,13 @@ void Mesh::init()
   glBindVertexArray(0); // Desactive the VAO just created. Will be activated at rendering time.
 }
 #else
-void Mesh::init()
+void Mesh::updateBuffer(GLuint buffer, GLenum target, size_t size, const void *data)
+{
+  glBindBuffer(target, buffer);
+  glBufferSubData(target, 0, size, data);
+}
+
+void Mesh::createBuffers()
 {
   // Generate a GPU buffer to store the positions of the vertices
   size_t vertexBufferSize = sizeof(glm::vec3)*_vertexPositions.size();
@@ -175,6 +754,33 @@ void Mesh::init()
 }
 #endif
 
+// Only the buffers whose data changed since the last call are uploaded again; they are all
+// recreated when a size changed
+void Mesh::init()
+{
+  if(!_vao || _uploadedVertexCount != _vertexPositions.size() || _uploadedTexCoordCount != _vertexTexCoords.size()
+     || _uploadedTriangleCount != _triangleIndices.size()) {
+    releaseBuffers();
+    createBuffers();
+  } else {
+    if(_uploadedPositions != _positionsGeneration)
+      updateBuffer(_posVbo, GL_ARRAY_BUFFER, sizeof(glm::vec3)*_vertexPositions.size(), _vertexPositions.data());
+    if(_uploadedNormals != _normalsGeneration)
+      updateBuffer(_normalVbo, GL_ARRAY_BUFFER, sizeof(glm::vec3)*_vertexNormals.size(), _vertexNormals.data());
+    if(_uploadedTexCoords != _texCoordsGeneration)
+      updateBuffer(_texCoordVbo, GL_ARRAY_BUFFER, sizeof(glm::vec2)*_vertexTexCoords.size(), _vertexTexCoords.data());
+    if(_uploadedTopology != _topologyGeneration)
+      updateBuffer(_ibo, GL_ELEMENT_ARRAY_BUFFER, sizeof(glm::uvec3)*_triangleIndices.size(), _triangleIndices.data());
+  }
+  _uploadedPositions = _positionsGeneration;
+  _uploadedNormals = _normalsGeneration;
+  _uploadedTexCoords = _texCoordsGeneration;
+  _uploadedTopology = _topologyGeneration;
+  _uploadedVertexCount = _vertexPositions.size();
+  _uploadedTexCoordCount = _vertexTexCoords.size();
+  _uploadedTriangleCount = _triangleIndices.size();
+}
+
 void Mesh::render()
 {
   glBindVertexArray(_vao);      // Activate the VAO storing geometry data
@@ -188,6 +794,17 @@ void Mesh::clear()
   _vertexNormals.clear();
   _vertexTexCoords.clear();
   _triangleIndices.clear();
+  _vertexColors.clear();
+  _vertexFaceOffsets.clear();
+  _vertexFaces.clear();
+  topologyChanged();
+  normalsChanged();
+  texCoordsChanged();
+  releaseBuffers();
+}
+
+void Mesh::releaseBuffers()
+{
   if(_vao) {
     glDeleteVertexArrays(1, &_vao);
     _vao = 0;
@@ -210,42 +827,264 @@ void Mesh::clear()
   }
 }
 
+namespace {
+
+// Parses the vertices and faces of an OFF body with several threads. The buffer is cut in chunks
+// at line boundaries, the records (non empty, non comment lines) of every chunk are counted, and
+// a prefix sum gives the first record and line of each chunk, so that all the chunks are parsed
+// concurrently into the preallocated arrays. Returns false when the body does not hold exactly
+// one vertex or one face per line, or on any parsing error: the caller then runs the sequential
+// parser, which reports the error.
+bool parseOffBodyInParallel(const char *begin, const char *end, unsigned int firstLine,
+                            const std::string &filename, unsigned int threadCount,
+                            std::vector<glm::vec3> &P, std::vector<glm::uvec3> &T)
+{
+  const unsigned int chunkCount = 4*threadCount;
+  std::vector<const char*> bounds(chunkCount + 1, end);
+  bounds[0] = begin;
+  for(unsigned int c = 1; c < chunkCount; ++c) {
+    const char *p = std::max(bounds[c - 1], begin + (end - begin)*c/chunkCount);
+    while(p < end && p[-1] != '\n') ++p;
+    bounds[c] = p;
+  }
+
+  auto runChunks = [&](std::function<void(unsigned int)> job) {
+    std::vector<std::thread> threads;
+    for(unsigned int t = 0; t < threadCount; ++t)
+      threads.push_back(std::thread([&, t]() {
+        for(unsigned int c = t; c < chunkCount; c += threadCount) job(c);
+      }));
+    for(auto &thread : threads) thread.join();
+  };
+  // first non blank character of the line starting at p, which is a record unless it is a comment
+  auto isRecord = [](const char *p, const char *lineEnd) {
+    while(p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p < lineEnd && *p != '#';
+  };
+
+  // 1. count the records and the lines of every chunk
+  std::vector<size_t> records(chunkCount + 1, 0), lines(chunkCount + 1, 0);
+  runChunks([&](unsigned int c) {
+    for(const char *p = bounds[c]; p < bounds[c + 1];) {
+      const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', bounds[c + 1] - p));
+      if(!lineEnd) lineEnd = bounds[c + 1];
+      if(isRecord(p, lineEnd)) records[c + 1]++;
+      if(lineEnd < bounds[c + 1]) lines[c + 1]++;
+      p = lineEnd + 1;
+    }
+  });
+  for(unsigned int c = 0; c < chunkCount; ++c) {
+    records[c + 1] += records[c];
+    lines[c + 1] += lines[c];
+  }
+  const size_t sizeV = P.size(), sizeT = T.size();
+  if(records[chunkCount] != sizeV + sizeT)
+    return false;
+
+  // 2. parse every chunk at its own offset
+  std::atomic<bool> failed(false);
+  runChunks([&](unsigned int c) {
+    size_t record = records[c];
+    unsigned int line = firstLine + lines[c];
+    try {
+      for(const char *p = bounds[c]; p < bounds[c + 1] && !failed; ++line) {
+        const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', bounds[c + 1] - p));
+        if(!lineEnd) lineEnd = bounds[c + 1];
+        if(isRecord(p, lineEnd)) {
+          TextTokenizer in(p, lineEnd, "loadOFF", filename, line);
+          if(record < sizeV) {
+            glm::vec3 &v = P[record];
+            v[0] = in.readFloat("a vertex coordinate");
+            v[1] = in.readFloat("a vertex coordinate");
+            v[2] = in.readFloat("a vertex coordinate");
+          } else {
+            glm::uvec3 &t = T[record - sizeV];
+            if(in.readUnsigned("a face size") != 3)
+              in.fail("a triangle (face size 3)");
+            for(unsigned int j=0; j<3; ++j) {
+              t[j] = in.readUnsigned("a vertex index");
+              if(t[j] >= sizeV)
+                in.fail("a vertex index lower than " + std::to_string(sizeV));
+            }
+          }
+          in.skipSpaces();
+          if(in.position() != lineEnd)
+            in.fail("the end of the line");
+          ++record;
+        }
+        p = lineEnd + 1;
+      }
+    } catch(std::exception &) {
+      failed = true;
+    }
+  });
+  return !failed;
+}
+
+} // namespace
+
 // Loads an OFF mesh file. See https://en.wikipedia.org/wiki/OFF_(file_format)
-void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr)
+// The file is memory mapped and parsed in place, straight into the mesh arrays. Large files are
+// parsed by threadCount threads (0: one per hardware thread, 1: sequential) with the same result.
+void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr, unsigned int threadCount, bool useCache)
 {
   std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
   meshPtr->clear();
-  std::ifstream in(filename.c_str());
-  if(!in)
-    throw std::ios_base::failure("[Mesh Loader][loadOFF] Cannot open " + filename);
-  std::string offString;
-  unsigned int sizeV, sizeT, tmp;
-  in >> offString >> sizeV >> sizeT >> tmp;
+  const std::string cacheFilename = filename + ".mbin";
+  FileStamp stamp;
+  if(useCache) {
+    stamp = computeFileStamp(filename);
+    if(loadMeshBinary(cacheFilename, *meshPtr, &stamp)) {
+      std::cout << " > Mesh <" << filename << "> loaded from <" << cacheFilename << ">" << std::endl;
+      return;
+    }
+    meshPtr->clear();
+  }
+  MappedFile file(filename);
+  TextTokenizer in(file.begin(), file.end(), "loadOFF", filename);
+  if(!in.readKeyword("OFF"))
+    in.fail("the OFF header");
+  const unsigned int sizeV = in.readUnsigned("the number of vertices");
+  const unsigned int sizeT = in.readUnsigned("the number of faces");
+  in.readUnsigned("the number of edges");
   auto &P = meshPtr->vertexPositions();
   auto &T = meshPtr->triangleIndices();
   P.resize(sizeV);
   T.resize(sizeT);
-  size_t tracker = (sizeV + sizeT)/20;
-  std::cout << " > [" << std::flush;
-  for(unsigned int i=0; i<sizeV; ++i) {
-    if(i % tracker == 0)
-      std::cout << "-" << std::flush;
-    in >> P[i][0] >> P[i][1] >> P[i][2];
+
+  if(threadCount == 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  const size_t minimumChunkSize = 1 << 20;
+  threadCount = std::min<size_t>(threadCount, std::max<size_t>(1, (file.end() - in.position())/minimumChunkSize));
+  const bool parsedInParallel = threadCount > 1 &&
+    parseOffBodyInParallel(in.position(), file.end(), in.line(), filename, threadCount, P, T);
+
+  for(unsigned int i=0; !parsedInParallel && i<sizeV; ++i) {
+    P[i][0] = in.readFloat("a vertex coordinate");
+    P[i][1] = in.readFloat("a vertex coordinate");
+    P[i][2] = in.readFloat("a vertex coordinate");
   }
-  int s;
-  for(unsigned int i=0; i<sizeT; ++i) {
-    if((sizeV + i) % tracker == 0)
-      std::cout << "-" << std::flush;
-    in >> s;
-    for(unsigned int j=0; j<3; ++j)
-      in >> T[i][j];
-  }
-  std::cout << "]" << std::endl;
-  in.close();
+  for(unsigned int i=0; !parsedInParallel && i<sizeT; ++i) {
+    if(in.readUnsigned("a face size") != 3)
+      in.fail("a triangle (face size 3)");
+    for(unsigned int j=0; j<3; ++j) {
+      T[i][j] = in.readUnsigned("a vertex index");
+      if(T[i][j] >= sizeV)
+        in.fail("a vertex index lower than " + std::to_string(sizeV));
+    }
+  }
+  meshPtr->topologyChanged();
+  meshPtr->normalsChanged();
+  meshPtr->texCoordsChanged();
   meshPtr->vertexNormals().resize(P.size(), glm::vec3(0.f, 0.f, 1.f));
   meshPtr->vertexTexCoords().resize(P.size(), glm::vec2(0.f, 0.f));
   meshPtr->recomputePerVertexNormals();
   meshPtr->recomputePerVertexTextureCoordinates();
+  if(useCache) {
+    meshPtr->calculateVertexFaceAdjacency();
+    if(!saveMeshBinary(cacheFilename, *meshPtr, stamp))
+      std::cout << " > Could not write the mesh cache <" << cacheFilename << ">" << std::endl;
+  }
   std::cout << " > Mesh <" << filename << "> loaded" <<  std::endl;
 }
 
+// Writes the mesh as an OFF file. Records are formatted by chunks of 64k into separate buffers,
+// threadCount chunks at a time (0: one per hardware thread), and the buffers are written in order.
+void saveOFF(const std::string &filename, const Mesh &mesh, unsigned int threadCount)
+{
+  const auto &P = mesh.vertexPositions();
+  const auto &T = mesh.triangleIndices();
+  std::FILE *f = std::fopen(filename.c_str(), "wb");
+  if(!f)
+    throw std::ios_base::failure("[Mesh Saver][saveOFF] Cannot open " + filename);
+  std::string header = "OFF\n" + std::to_string(P.size()) + " " + std::to_string(T.size()) + " 0\n";
+  bool ok = std::fwrite(header.data(), 1, header.size(), f) == header.size();
+
+  if(threadCount == 0) threadCount = parallelThreadCount();
+  const size_t CHUNK = 1 << 16;
+  const size_t vertexChunks = (P.size() + CHUNK - 1)/CHUNK;
+  const size_t chunkCount = vertexChunks + (T.size() + CHUNK - 1)/CHUNK;
+  std::vector<std::vector<char>> buffers(threadCount);
+  for(size_t batch = 0; ok && batch < chunkCount; batch += threadCount) {
+    const unsigned int batchSize = std::min<size_t>(threadCount, chunkCount - batch);
+    parallelFor(0, batchSize, [&](unsigned int b) {
+      const size_t c = batch + b;
+      std::vector<char> &buffer = buffers[b];
+      if(c < vertexChunks) {
+        const size_t first = c*CHUNK, last = std::min(P.size(), first + CHUNK);
+        buffer.resize((last - first)*(3*MAX_FORMATTED_FLOAT + 3));
+        char *out = buffer.data();
+        for(size_t v = first; v < last; ++v) {
+          out = formatFloat(out, P[v].x);
+          *out++ = ' ';
+          out = formatFloat(out, P[v].y);
+          *out++ = ' ';
+          out = formatFloat(out, P[v].z);
+          *out++ = '\n';
+        }
+        buffer.resize(out - buffer.data());
+      } else {
+        const size_t first = (c - vertexChunks)*CHUNK, last = std::min(T.size(), first + CHUNK);
+        buffer.resize((last - first)*(3*MAX_FORMATTED_UNSIGNED + 5));
+        char *out = buffer.data();
+        for(size_t t = first; t < last; ++t) {
+          *out++ = '3';
+          for(int k = 0; k < 3; ++k) {
+            *out++ = ' ';
+            out = formatUnsigned(out, T[t][k]);
+          }
+          *out++ = '\n';
+        }
+        buffer.resize(out - buffer.data());
+      }
+    }, 1);
+    for(unsigned int b = 0; ok && b < batchSize; ++b)
+      ok = std::fwrite(buffers[b].data(), 1, buffers[b].size(), f) == buffers[b].size();
+  }
+  if(std::fclose(f) != 0 || !ok)
+    throw std::ios_base::failure("[Mesh Saver][saveOFF] Cannot write " + filename);
+  std::cout << " > Mesh saved to <" << filename << ">" << std::endl;
+}
+
+// OFF to binary mesh, see convertToMeshBinary. Parses the body as loadOFF does sequentially.
+void convertOFFToMeshBinary(const std::string &input, const std::string &output)
+{
+  std::cout << " > Start converting mesh <" << input << ">" << std::endl;
+  const MappedFile file(input);
+  TextTokenizer in(file.begin(), file.end(), "convertOFFToMeshBinary", input);
+  if(!in.readKeyword("OFF"))
+    in.fail("the OFF header");
+  const unsigned int sizeV = in.readUnsigned("the number of vertices");
+  const unsigned int sizeT = in.readUnsigned("the number of faces");
+  in.readUnsigned("the number of edges");
+
+  const MeshBinaryLayout layout = createMeshBinary(output, sizeV, sizeT);
+  WritableMappedFile out(output);
+  glm::vec3 *P = reinterpret_cast<glm::vec3*>(out.begin() + layout.positionsOffset);
+  glm::uvec3 *T = reinterpret_cast<glm::uvec3*>(out.begin() + layout.indicesOffset);
+  const unsigned int BLOCK = 1u << 20;  // records between evictions of the mapped pages
+  for(unsigned int i=0; i<sizeV; ++i) {
+    P[i][0] = in.readFloat("a vertex coordinate");
+    P[i][1] = in.readFloat("a vertex coordinate");
+    P[i][2] = in.readFloat("a vertex coordinate");
+    if((i + 1) % BLOCK == 0) {
+      file.evict();
+      out.evict();
+    }
+  }
+  for(unsigned int i=0; i<sizeT; ++i) {
+    if(in.readUnsigned("a face size") != 3)
+      in.fail("a triangle (face size 3)");
+    for(unsigned int j=0; j<3; ++j) {
+      T[i][j] = in.readUnsigned("a vertex index");
+      if(T[i][j] >= sizeV)
+        in.fail("a vertex index lower than " + std::to_string(sizeV));
+    }
+    if((i + 1) % BLOCK == 0) {
+      file.evict();
+      out.evict();
+    }
+  }
+  file.evict();
+  finishMeshBinary(out, layout, true, true);
+}
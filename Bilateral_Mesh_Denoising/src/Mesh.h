@@ -4,6 +4,7 @@
 #include <glad/glad.h>
 #include <vector>
 #include <memory>
+#include <mutex>
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -12,9 +13,17 @@
 #include <map>
 #include <set>
 #include <cmath>
+#include <algorithm>
 
 #include <iostream>
 
+#include "SparseMatrix.h"
+#include "HalfEdgeMesh.h"
+#include "GeometryKernels.h"
+#include "Parallel.h"
+#include "Arena.h"
+#include "ChunkedBuffer.h"
+
 class Mesh {
 public:
   virtual ~Mesh();
@@ -22,6 +31,14 @@ public:
   const int N = 5; // Number of iterations
   float sigma_s = 0.001f; 
   float sigma_c; 
+  unsigned int ringSize = 0; // 0: neighbors within 2*sigma_c, k > 0: topological k-ring neighbors
+  float sigma_n = 0.35f; // Normal difference parameter of the two-stage filter
+  int normalIterations = 5; // Face normal filtering passes of the two-stage filter
+  int vertexIterations = 10; // Vertex update passes of the two-stage filter
+  float coarseningFactor = 2.0f; // Coarse grid cell size of the multigrid filter, in mean edge lengths
+  int fineIterations = 2; // Finishing passes of the multigrid filter on the fine mesh
+  // Code writing through the non-const accessors reports it with positionsChanged() and the others
+  // below, a read through them does not invalidate the derived data
   const std::vector<glm::vec3> &vertexPositions() const { return _vertexPositions; }
   std::vector<glm::vec3> &vertexPositions() { return _vertexPositions; }
 
@@ -34,10 +51,58 @@ public:
   const std::vector<glm::uvec3> &triangleIndices() const { return _triangleIndices; }
   std::vector<glm::uvec3> &triangleIndices() { return _triangleIndices; }
 
+  // optional per-vertex colors in [0,1] (empty unless the file provides them), not rendered
+  const std::vector<glm::vec3> &vertexColors() const { return _vertexColors; }
+  std::vector<glm::vec3> &vertexColors() { return _vertexColors; }
+
+  // vertex -> incident faces adjacency (CSR), filled by calculateVertexFaceAdjacency(); writing it
+  // through the non-const accessors makes it the adjacency of the current connectivity
+  const std::vector<unsigned int> &vertexFaceOffsets() const { return _vertexFaceOffsets; }
+  std::vector<unsigned int> &vertexFaceOffsets() { _vertexFaceTopology = _topologyGeneration; return _vertexFaceOffsets; }
+  const std::vector<unsigned int> &vertexFaces() const { return _vertexFaces; }
+  std::vector<unsigned int> &vertexFaces() { _vertexFaceTopology = _topologyGeneration; return _vertexFaces; }
+
+  // Dirty tracking of the derived data. The positions, normals, texture coordinates and the
+  // connectivity have generation counters, bumped by every change. The adjacencies, face normals
+  // and areas, vertex normals, neighborhoods, bounds and GPU buffers remember the generations they
+  // were computed from, and the functions that compute them return at once while these match.
+  // Code writing the arrays through the non-const accessors must report it.
+  void positionsChanged() { ++_positionsGeneration; }
+  void normalsChanged() { ++_normalsGeneration; _vertexNormalsStamp = Stamp(); }
+  void texCoordsChanged() { ++_texCoordsGeneration; _texCoordsStamp = 0; }
+  void topologyChanged() { ++_topologyGeneration; ++_positionsGeneration; }
+  unsigned long positionsGeneration() const { return _positionsGeneration; }
+  unsigned long topologyGeneration() const { return _topologyGeneration; }
+
+  // Positions, triangles, colors and error references of the mesh at some point. The chunks that
+  // did not change since the previous snapshot are shared with it. snapshot() reads the mesh
+  // without synchronization: call it from the thread that edits the mesh. The snapshot it returns
+  // can then be kept and read by another thread while the mesh changes.
+  struct Snapshot {
+    ChunkedBuffer<glm::vec3> positions;
+    ChunkedBuffer<glm::uvec3> triangles;
+    ChunkedBuffer<glm::vec3> colors;
+    ChunkedBuffer<glm::vec3> noNoisePositions, noisyPositions;
+  };
+  Snapshot snapshot() const;
+  void restore(const Snapshot &snapshot);
+
+  // Undo history of at most UNDO_LEVELS edits: pushUndo() records the mesh before an edit, undo()
+  // and redo() return false when there is nothing to undo or redo
+  static const size_t UNDO_LEVELS = 32;
+  void pushUndo();
+  bool undo();
+  bool redo();
+
   /// Compute the parameters of a sphere which bounds the mesh
   void computeBoundingSphere(glm::vec3 &center, float &radius) const;
 
+  // Normalized sum of the normals of the faces around each vertex, weighted by the face areas or
+  // by the corner angles, gathered in parallel over the vertex -> faces adjacency. The second
+  // version only updates the faces around movedVertices and their vertices, for a connectivity
+  // unchanged since the last call.
   void recomputePerVertexNormals(bool angleBased = false);
+  void recomputePerVertexNormals(const std::vector<unsigned int> &movedVertices, bool angleBased = false);
   void recomputePerVertexTextureCoordinates( );
 
   void init();
@@ -47,50 +112,56 @@ public:
 
   void addPlan(float square_half_side = 1.0f);
 
+  // Heat method geodesic distances (Crane et al. 2013). The cotan Laplacian and the lumped mass
+  // matrix are assembled and factored once by prepareHeatGeodesics(), each query then costs two
+  // sparse solves with the stored factors and one divergence pass.
+  // prepareHeatGeodesics() must be called again after the positions or the connectivity changed.
+  void prepareHeatGeodesics(float timeFactor = 1.0f);
+  void computeGeodesicDistances(const std::vector<unsigned int> &sources, std::vector<float> &distances);
+
+  // The new vertices are appended to the positions, the existing ones do not move
   void subdivideLinear() {
-    std::vector<glm::vec3> newVertices = _vertexPositions;
     std::vector<glm::uvec3> newTriangles;
-
-    struct Edge {
-      unsigned int a , b;
-      Edge( unsigned int c , unsigned int d ) : a( std::min<unsigned int>(c,d) ) , b( std::max<unsigned int>(c,d) ) {}
-      bool operator < ( Edge const & o ) const {   return a < o.a  ||  (a == o.a && b < o.b);  }
-      bool operator == ( Edge const & o ) const {   return a == o.a  &&  b == o.b;  }
+    newTriangles.reserve(4*_triangleIndices.size());
+
+    // one new vertex per edge, shared by the two half-edges of the edge. The edges with a half-edge
+    // without twin (boundary, non-manifold or inconsistently oriented edges) share theirs through
+    // their two vertices, so that every face along such an edge gets the same new vertex.
+    const HalfEdgeMesh halfEdges(_triangleIndices, _vertexPositions.size());
+    auto edgeKey = [&](unsigned int h) {
+      return std::make_pair(std::min(halfEdges.from(h), halfEdges.to(h)), std::max(halfEdges.from(h), halfEdges.to(h)));
     };
-    std::map<Edge , unsigned int> newVertexOnEdge;
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> unpairedEdges;
+    for(unsigned int h = 0; h < halfEdges.halfEdgeCount(); ++h)
+      if(halfEdges.isBoundary(h)) unpairedEdges.emplace(edgeKey(h), HalfEdgeMesh::INVALID);
+    std::vector<unsigned int> newVertexOnEdge(halfEdges.halfEdgeCount());
+    for(unsigned int h = 0; h < halfEdges.halfEdgeCount(); ++h) {
+      const unsigned int t = halfEdges.twin(h);
+      if(t != HalfEdgeMesh::INVALID && t < h) {
+        newVertexOnEdge[h] = newVertexOnEdge[t];
+        continue;
+      }
+      if(!unpairedEdges.empty()) {
+        const auto found = unpairedEdges.find(edgeKey(h));
+        if(found != unpairedEdges.end()) {
+          if(found->second != HalfEdgeMesh::INVALID) {
+            newVertexOnEdge[h] = found->second;
+            continue;
+          }
+          found->second = _vertexPositions.size();
+        }
+      }
+      const glm::vec3 middle = (_vertexPositions[ halfEdges.from(h) ] + _vertexPositions[ halfEdges.to(h) ]) / 2.f;
+      _vertexPositions.push_back( middle );
+      newVertexOnEdge[h] = _vertexPositions.size() - 1;
+    }
     for(unsigned int tIt = 0 ; tIt < _triangleIndices.size() ; ++tIt) {
       unsigned int a = _triangleIndices[tIt][0];
       unsigned int b = _triangleIndices[tIt][1];
       unsigned int c = _triangleIndices[tIt][2];
-
-
-      Edge Eab(a,b);
-      unsigned int oddVertexOnEdgeEab = 0;
-      if( newVertexOnEdge.find( Eab ) == newVertexOnEdge.end() ) {
-        newVertices.push_back( (_vertexPositions[ a ] + _vertexPositions[ b ]) / 2.f );
-        oddVertexOnEdgeEab = newVertices.size() - 1;
-        newVertexOnEdge[Eab] = oddVertexOnEdgeEab;
-      }
-      else { oddVertexOnEdgeEab = newVertexOnEdge[Eab]; }
-
-
-      Edge Ebc(b,c);
-      unsigned int oddVertexOnEdgeEbc = 0;
-      if( newVertexOnEdge.find( Ebc ) == newVertexOnEdge.end() ) {
-        newVertices.push_back( (_vertexPositions[ b ] + _vertexPositions[ c ]) / 2.f );
-        oddVertexOnEdgeEbc = newVertices.size() - 1;
-        newVertexOnEdge[Ebc] = oddVertexOnEdgeEbc;
-      }
-      else { oddVertexOnEdgeEbc = newVertexOnEdge[Ebc]; }
-
-      Edge Eca(c,a);
-      unsigned int oddVertexOnEdgeEca = 0;
-      if( newVertexOnEdge.find( Eca ) == newVertexOnEdge.end() ) {
-        newVertices.push_back( (_vertexPositions[ c ] + _vertexPositions[ a ]) / 2.f );
-        oddVertexOnEdgeEca = newVertices.size() - 1;
-        newVertexOnEdge[Eca] = oddVertexOnEdgeEca;
-      }
-      else { oddVertexOnEdgeEca = newVertexOnEdge[Eca]; }
+      unsigned int oddVertexOnEdgeEab = newVertexOnEdge[3*tIt];
+      unsigned int oddVertexOnEdgeEbc = newVertexOnEdge[3*tIt + 1];
+      unsigned int oddVertexOnEdgeEca = newVertexOnEdge[3*tIt + 2];
 
       // set new triangles :
       newTriangles.push_back( glm::uvec3( a , oddVertexOnEdgeEab , oddVertexOnEdgeEca ) );
@@ -100,13 +171,19 @@ public:
     }
 
     // after that:
-    _triangleIndices = newTriangles;
-    _vertexPositions = newVertices;
+    _triangleIndices.swap(newTriangles);
+    topologyChanged();
     recomputePerVertexNormals( );
     recomputePerVertexTextureCoordinates( );
   }
 
   void subdivideLoop() {
+    subdivideLoop(_scratch);
+  }
+
+  // The edge maps are allocated in scratch and released when the subdivision ends
+  void subdivideLoop(Arena &scratch) {
+    ArenaScope scope(scratch, "Loop subdivision");
     std::vector<glm::vec3> newVertices = _vertexPositions;
     std::vector<glm::uvec3> newTriangles;
 
@@ -118,7 +195,7 @@ public:
       bool operator == ( Edge const & o ) const {   return a == o.a  &&  b == o.b;  }
     };
 
-    std::vector<std::map<Edge, unsigned int>> edgesNeighbors(_vertexPositions.size());
+    std::vector<ArenaMap<Edge, unsigned int>> edgesNeighbors(_vertexPositions.size(), ArenaMap<Edge, unsigned int>(scratch));
     for(unsigned int tIt = 0 ; tIt < _triangleIndices.size() ; ++tIt) {
       unsigned int a = _triangleIndices[tIt][0];
       unsigned int b = _triangleIndices[tIt][1];
@@ -193,8 +270,8 @@ public:
       }
     }
 
-    std::map< Edge , unsigned int > newVertexOnEdge;
-    std::map<unsigned int, unsigned int> oddValence;
+    ArenaMap< Edge , unsigned int > newVertexOnEdge(scratch);
+    ArenaMap<unsigned int, unsigned int> oddValence(scratch);
     for(unsigned int tIt = 0 ; tIt < _triangleIndices.size() ; ++tIt) {
       unsigned int a = _triangleIndices[tIt][0];
       unsigned int b = _triangleIndices[tIt][1];
@@ -251,33 +328,76 @@ public:
 
     _triangleIndices = newTriangles;
     _vertexPositions = newVertices;
+    topologyChanged();
     recomputePerVertexNormals( );
     recomputePerVertexTextureCoordinates( );
     std::cout << "Number of points: " << _vertexPositions.size() << std::endl;
   }
 
   void bilateralFiltering(){
+    bilateralFiltering(N);
+  }
+
+  void bilateralFiltering(int iterations){
+    bilateralFiltering(iterations, _scratch);
+  }
+
+  // The temporaries of the neighborhood searches are allocated in scratch
+  void bilateralFiltering(int iterations, Arena &scratch){
+    ArenaScope scope(scratch, "Bilateral filtering");
     std::cout << "Value of sigma_s: " << sigma_s << std::endl;
+    std::cout << "Geometry kernels: " << geometryKernelsInstructionSet() << std::endl;
     if (_noisyVertexPositions.empty()){
-      for(unsigned int i = 0 ; i < _vertexPositions.size() ; ++i) {
-        _noisyVertexPositions.push_back(_vertexPositions[i]);
-      }
+      _noisyVertexPositions = snapshot().positions;
     }
     calculateTriangleNeighboord();
     calculateSigmac();
-    for (unsigned int j = 0; j < N; ++j){
-      calculateDistanceNeighborhood(2.0f * sigma_c);
+    // The connectivity does not change while filtering, so the k-ring is computed only once
+    if (ringSize > 0){
+      std::cout << "Using the " << ringSize << "-ring neighborhood" << std::endl;
+      calculateRingNeighborhood(ringSize, scratch);
+    }
+    for (int j = 0; j < iterations; ++j){
+      if (ringSize == 0) calculateDistanceNeighborhood(2.0f * sigma_c);
       calculateTriangleNeighboord();
       calculateTrianglesAreas();
       calculateVertexWeightedNormals();
       for (unsigned int i = 0; i < _vertexPositions.size(); ++i){
         denoisePoint(i);
       }
+      positionsChanged();
+      _positionArraysGeneration = _positionsGeneration; // denoisePoint kept it up to date
     }
     std::cout << "Bilateral Filtering Applied" << std::endl;
     computeError();
   }
 
+  // Two-stage filter: the face normals are first filtered with a bilateral kernel over the face
+  // adjacency, then the vertices are moved so that the faces match the filtered normals.
+  void bilateralNormalFiltering();
+
+  // Vertex clustering on a grid of the given cell size. correspondence[v] is the coarse vertex
+  // the fine vertex v was merged into, the coarse vertex is the mean of its fine vertices. A cell
+  // size that is not positive merges nothing.
+  std::shared_ptr<Mesh> simplify(float cellSize, std::vector<unsigned int> &correspondence) const;
+
+  // Coarse-to-fine filter: the mid frequencies are removed by filtering a simplified mesh, whose
+  // displacements are prolonged to the fine vertices, then a few fine passes remove the rest.
+  void multigridBilateralFiltering();
+
+  struct SweepResult {
+    float sigma_s, sigma_c;
+    int iterations;
+    double error;
+  };
+
+  // Evaluates every (sigma_s, sigma_c, iterations) combination against the noise free positions.
+  // The neighborhoods (at the largest sigma_c) and the adjacency are built once and shared, the
+  // combinations run in parallel on their own copy of the positions.
+  std::vector<SweepResult> sweepParameters(const std::vector<float> &sigma_s_values,
+                                           const std::vector<float> &sigma_c_values,
+                                           const std::vector<int> &iteration_values);
+
   void computeError(){
     if (_noNoiseVertexPositions.empty() + _noisyVertexPositions.empty() == 0){
       double sum_noisy = 0;
@@ -300,19 +420,31 @@ public:
     sigma_s = userSigma_s;
   }
 
+  void setRingSize(unsigned int k){
+    ringSize = k;
+  }
+
   // The variance was really close to 0, so I could only see zeros. If I increase the noise in such a way that it becomes too big I can see some variance
   void calculateVariance(){
-    oneRingNeighboorhood.clear();
+    calculateVariance(_scratch);
+  }
+
+  // The one-rings and their means are allocated in scratch and released at the end
+  void calculateVariance(Arena &scratch){
+    ArenaScope scope(scratch, "Variance");
+    ArenaVector<ArenaVector<unsigned int>> oneRingNeighboorhood(scratch);
+    oneRingNeighboorhood.reserve(_triangleNeighborhood.size());
     for (unsigned int pointIndex = 0; pointIndex < _triangleNeighborhood.size(); ++pointIndex){
-      std::vector<unsigned int> points;
+      // a vertex with f faces has at most 2f + 1 one-ring vertices, itself included
+      oneRingNeighboorhood.push_back(ArenaVector<unsigned int>(scratch));
+      ArenaVector<unsigned int> &points = oneRingNeighboorhood.back();
+      points.reserve(2*_triangleNeighborhood[pointIndex].size() + 1);
       int a = _triangleIndices[_triangleNeighborhood[pointIndex][0]][0];
       int b = _triangleIndices[_triangleNeighborhood[pointIndex][0]][1];
       int c = _triangleIndices[_triangleNeighborhood[pointIndex][0]][2];
       points.push_back(a);
       points.push_back(b);
       points.push_back(c);
-      oneRingNeighboorhood.push_back(points);  
-      points.clear();
 
       for(unsigned int triangle = 1; triangle < _triangleNeighborhood[pointIndex].size(); ++triangle){
         int a = _triangleIndices[_triangleNeighborhood[pointIndex][triangle]][0];
@@ -321,25 +453,27 @@ public:
         int flag_a = 0;
         int flag_b = 0;
         int flag_c = 0;
-        for (unsigned int i = 0; i <= oneRingNeighboorhood[pointIndex].size(); i++){
-          if (a == oneRingNeighboorhood[pointIndex][i]) flag_a++;
-          if (b == oneRingNeighboorhood[pointIndex][i]) flag_b++;
-          if (c == oneRingNeighboorhood[pointIndex][i]) flag_c++;
+        for (unsigned int i = 0; i < points.size(); i++){
+          if (a == (int)points[i]) flag_a++;
+          if (b == (int)points[i]) flag_b++;
+          if (c == (int)points[i]) flag_c++;
         }
-        if (flag_a == 0) oneRingNeighboorhood[pointIndex].push_back(a);
-        if (flag_b == 0) oneRingNeighboorhood[pointIndex].push_back(b);
-        if (flag_c == 0) oneRingNeighboorhood[pointIndex].push_back(c);
+        if (flag_a == 0) points.push_back(a);
+        if (flag_b == 0) points.push_back(b);
+        if (flag_c == 0) points.push_back(c);
       }
       }
-      std::vector<glm::vec3> meanNeighborhoodVertices;
+      ArenaVector<glm::vec3> meanNeighborhoodVertices(scratch);
+      meanNeighborhoodVertices.reserve(oneRingNeighboorhood.size());
       for (const auto &vec : oneRingNeighboorhood) {
-        glm::vec3 mean;
+        glm::vec3 mean(0.0f);
         for (int i : vec) {
             mean += _vertexPositions[i];
         }
         mean = mean/(float)vec.size();
         meanNeighborhoodVertices.push_back(mean);
       }
+      _variance.clear();
       for (const auto &vec : oneRingNeighboorhood) {
         float squaredDistancesSum = 0.0f;
         for (int i: vec) {
@@ -349,10 +483,6 @@ public:
         float variance = squaredDistancesSum / (float)vec.size();
         _variance.push_back(variance);
       }
-
-      for (int var : _variance) {
-        //std::cout << var << std::endl;
-      }
   }
 
   void addNormalNoise(){
@@ -363,6 +493,7 @@ public:
       glm::vec3 normal = _vertexWeightedNormals[i];
       _vertexPositions[i] = _vertexPositions[i] + (normal * (float)(((rand() % 100) - 50) * 0.0001));
     }
+    positionsChanged();
     recomputePerVertexNormals( );
     recomputePerVertexTextureCoordinates( );
     calculateTriangleNeighboord();
@@ -391,15 +522,14 @@ public:
 
   void addNoise(){
     if (_noNoiseVertexPositions.empty()){
-      for(unsigned int i = 0 ; i < _vertexPositions.size() ; ++i) {
-        _noNoiseVertexPositions.push_back(_vertexPositions[i]);
-      }
+      _noNoiseVertexPositions = snapshot().positions;
     }
     for(unsigned int i = 0 ; i < _vertexPositions.size() ; ++i) {
       _vertexPositions[i].x += ((rand() % 100) - 50) * 0.0001;
       _vertexPositions[i].y += ((rand() % 100) - 50) * 0.0001;
       _vertexPositions[i].z += ((rand() % 100) - 50) * 0.0001;
     }
+    positionsChanged();
     recomputePerVertexNormals( );
     recomputePerVertexTextureCoordinates( );
     calculateTriangleNeighboord();
@@ -407,59 +537,109 @@ public:
     
   }
 
+  // The neighborhoods are stored in _neighborhoodArena, which is rewound when they are rebuilt:
+  // each one is found in a single reused buffer then copied with its exact size.
   void calculateDistanceNeighborhood(float d){
-    _distanceNeighborhood.clear();
+    if (_neighborhoodRing == 0 && _neighborhoodRadius == d && _neighborhoodStamp == currentStamp()) return;
+    _neighborhoodRing = 0;
+    _neighborhoodRadius = d;
+    _neighborhoodStamp = currentStamp();
+    syncPositionArrays();
+    const size_t allocations = clearNeighborhoods();
+    std::vector<unsigned int> found;
+    for(unsigned int i = 0 ; i < _vertexPositions.size() ; ++i) {
+      found.clear();
+      radiusNeighbors(_positionArrays, i, d, found);
+      _distanceNeighborhood.push_back(ArenaVector<unsigned int>(found.begin(), found.end(), _neighborhoodArena));
+    }
+    printArenaUsage("Distance neighborhoods", _neighborhoodArena.allocationCount() - allocations,
+                    _neighborhoodArena.bytesInUse());
+  }
+
+  // Vertices reachable in at most k edges, found by a breadth-first search on the one-ring
+  // adjacency. The cost per vertex is bounded by valence^k and no spatial search is needed.
+  void calculateRingNeighborhood(unsigned int k){
+    calculateRingNeighborhood(k, _scratch);
+  }
+
+  // The one-rings are allocated in scratch, the neighborhoods in _neighborhoodArena
+  void calculateRingNeighborhood(unsigned int k, Arena &scratch){
+    if (_neighborhoodRing == k && _neighborhoodStamp.topology == _topologyGeneration) return;
+    _neighborhoodRing = k;
+    _neighborhoodStamp = currentStamp();
+    ArenaScope scope(scratch, "One-rings");
+    calculateVertexFaceAdjacency();
+    std::vector<ArenaVector<unsigned int>> oneRing(_vertexPositions.size(), ArenaVector<unsigned int>(scratch));
+    for(unsigned int i = 0 ; i < _vertexPositions.size() ; ++i) {
+      ArenaVector<unsigned int> &ring = oneRing[i];
+      ring.reserve(2*(_vertexFaceOffsets[i + 1] - _vertexFaceOffsets[i]));
+      for(unsigned int f = _vertexFaceOffsets[i]; f < _vertexFaceOffsets[i + 1]; ++f){
+        const glm::uvec3 &t = _triangleIndices[_vertexFaces[f]];
+        const unsigned int c = t[0] == i ? 0 : (t[1] == i ? 1 : 2);
+        ring.push_back(t[(c+1)%3]);
+        ring.push_back(t[(c+2)%3]);
+      }
+      std::sort(ring.begin(), ring.end());
+      ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    }
+
+    const size_t allocations = clearNeighborhoods();
+    std::vector<unsigned int> neighboors;
+    std::vector<unsigned int> visited(_vertexPositions.size(), (unsigned int)-1);
     for(unsigned int i = 0 ; i < _vertexPositions.size() ; ++i) {
-      std::vector<unsigned int> neighboors;
-      for(unsigned int j = 0 ; j < _vertexPositions.size() ; ++j) {
-        if (i==j) continue;
-        float dist = sqrt((_vertexPositions[i].x - _vertexPositions[j].x) * (_vertexPositions[i].x - _vertexPositions[j].x) +
-                          (_vertexPositions[i].y - _vertexPositions[j].y) * (_vertexPositions[i].y - _vertexPositions[j].y) +
-                          (_vertexPositions[i].z - _vertexPositions[j].z) * (_vertexPositions[i].z - _vertexPositions[j].z));
-        if (dist <= d){
-          neighboors.push_back(j);
+      neighboors.clear();
+      visited[i] = i;
+      unsigned int levelStart = 0;
+      neighboors.push_back(i);
+      for (unsigned int level = 0; level < k; ++level){
+        const unsigned int levelEnd = neighboors.size();
+        for (unsigned int n = levelStart; n < levelEnd; ++n){
+          for (unsigned int j : oneRing[neighboors[n]]){
+            if (visited[j] != i){
+              visited[j] = i;
+              neighboors.push_back(j);
+            }
+          }
         }
+        levelStart = levelEnd;
       }
-      _distanceNeighborhood.push_back(neighboors);
+      // the vertex itself is not its own neighbor
+      _distanceNeighborhood.push_back(ArenaVector<unsigned int>(neighboors.begin() + 1, neighboors.end(), _neighborhoodArena));
     }
+    printArenaUsage("Ring neighborhoods", _neighborhoodArena.allocationCount() - allocations,
+                    _neighborhoodArena.bytesInUse());
   }
 
+  // Compressed (CSR) vertex -> incident faces and face -> faces sharing a vertex adjacencies
+  void calculateVertexFaceAdjacency();
+  void calculateFaceAdjacency();
+  glm::vec3 gatherVertexNormal(unsigned int v, bool angleBased) const;
+
+  // Faces around each vertex, in increasing order, copied from the CSR adjacency
   void calculateTriangleNeighboord(){
-    _triangleNeighborhood.clear();
+    if (_triangleNeighborhoodTopology == _topologyGeneration) return;
+    calculateVertexFaceAdjacency();
+    _triangleNeighborhood.resize(_vertexPositions.size());
     for(unsigned int i = 0 ; i < _vertexPositions.size() ; ++i) {
-      std::vector<unsigned int> neighboors;
-      for(unsigned int tIt = 0 ; tIt < _triangleIndices.size() ; ++tIt) {
-        unsigned int a = _triangleIndices[tIt][0];
-        unsigned int b = _triangleIndices[tIt][1];
-        unsigned int c = _triangleIndices[tIt][2];
-        if (a == i || b == i || c == i){
-          neighboors.push_back(tIt);
-        }
-      }
-      _triangleNeighborhood.push_back(neighboors);
+      _triangleNeighborhood[i].assign(_vertexFaces.begin() + _vertexFaceOffsets[i], _vertexFaces.begin() + _vertexFaceOffsets[i + 1]);
     }
-  
+    _triangleNeighborhoodTopology = _topologyGeneration;
   }
 
   void calculateTrianglesAreas(){
-    _triangleNormals.clear();
-    _triangleArea.clear();
-    for(unsigned int tIt = 0 ; tIt < _triangleIndices.size() ; ++tIt) {
-      glm::vec3 a = _vertexPositions[_triangleIndices[tIt][0]];
-      glm::vec3 b = _vertexPositions[_triangleIndices[tIt][1]];
-      glm::vec3 c = _vertexPositions[_triangleIndices[tIt][2]];
-      glm::vec3 ab = b - a;
-      glm::vec3 ac = c - a;
-
-      glm::vec3 normal = glm::cross(ab, ac);
-      float area = glm::length(normal) / 2.0f;
-      normal = normal/glm::length(normal); // Normalizing the normals
-      _triangleNormals.push_back(normal);
-      _triangleArea.push_back(area);
-    }
+    if (_faceGeometryStamp == currentStamp()) return;
+    _faceGeometryStamp = currentStamp();
+    syncPositionArrays();
+    Vec3Arrays normals;
+    triangleNormalsAndAreas(_positionArrays, _triangleIndices, normals, _triangleArea);
+    normals.toInterleaved(_triangleNormals);
   }
 
   void calculateVertexWeightedNormals(){
+    if (_vertexWeightedNormalsStamp == currentStamp()) return;
+    calculateTriangleNeighboord();
+    calculateTrianglesAreas();
+    _vertexWeightedNormalsStamp = currentStamp();
     _vertexWeightedNormals.clear();
     for(unsigned int i = 0; i < _triangleNeighborhood.size(); ++i){
            
@@ -471,62 +651,141 @@ public:
         weightedNormal += _triangleNormals[_triangleNeighborhood[i][triangle]]*_triangleArea[_triangleNeighborhood[i][triangle]];
       }
 
-      
+      // a vertex without faces (left over by simplify) keeps a zero normal and does not move
+      if (totalArea > 0)
         weightedNormal = weightedNormal/totalArea;
       _vertexWeightedNormals.push_back(weightedNormal);      
     }
   }
 
-  void denoisePoint(int vertexIndex){
-    glm::vec3 point = _vertexPositions[vertexIndex];
-    
-    std::vector<unsigned int> Q = _distanceNeighborhood[vertexIndex];
+  // Bilateral kernel of denoisePoint: offset of point along normal from the neighbors Q.
+  // Neighbors farther than maxDistance are ignored. Returns false when no neighbor is used.
+  // Reference version of the SIMD ::bilateralOffset of GeometryKernels.h, used out of core.
+  static bool bilateralOffset(const glm::vec3 &point, const glm::vec3 &normal,
+                              const std::vector<glm::vec3> &positions,
+                              const unsigned int *Q, unsigned int count,
+                              float sigma_c, float sigma_s, float maxDistance, float &offset){
     float weighted_sum = 0;
     float normalizer = 0;
-    glm::vec3 normal = _vertexWeightedNormals[vertexIndex];
-    double t = 0, h = 0, w_c = 0, w_s = 0, h_sum = 0;
-    for (unsigned int i = 0; i < Q.size(); ++i){
-      glm::vec3 neighboor = _vertexPositions[Q[i]];
+    double t = 0, h = 0, w_c = 0, w_s = 0;
+    bool used = false;
+    for (unsigned int i = 0; i < count; ++i){
+      glm::vec3 neighboor = positions[Q[i]];
       t = glm::length(point - neighboor);
+      if (t > maxDistance) continue;
       h = glm::dot(neighboor - point, normal);
-      h_sum += h;     
       w_c = exp(-t*t/(2.0f*sigma_c*sigma_c));
       w_s = exp(-h*h/(2.0f*sigma_s*sigma_s)); 
       weighted_sum += (w_c*w_s)*h;
       normalizer += w_c*w_s;
+      used = true;
     }
-    if (!Q.empty()){
-      _vertexPositions[vertexIndex] = point + (normal * (weighted_sum/normalizer));
+    offset = weighted_sum/normalizer;
+    return used;
+  }
+
+  // Reads the neighbors from _positionArrays, which calculateTrianglesAreas brought up to date;
+  // the moved vertex is written to both layouts so that the next vertices see it.
+  void denoisePoint(int vertexIndex){
+    glm::vec3 point = _vertexPositions[vertexIndex];
+    
+    const ArenaVector<unsigned int> &Q = _distanceNeighborhood[vertexIndex];
+    glm::vec3 normal = _vertexWeightedNormals[vertexIndex];
+    float offset = 0;
+    if (::bilateralOffset(_positionArrays, point, normal, Q.data(), Q.size(), sigma_c, sigma_s, INFINITY, offset)){
+      _vertexPositions[vertexIndex] = point + (normal * offset);
       if(std::isnan(_vertexPositions[vertexIndex].x)){
         std::cout << "NaN problem!!" << std::endl;
-        //_vertexPositions[vertexIndex] = point + (normal * (float)h_sum/(float)Q.size());
         _vertexPositions[vertexIndex] = point;
       }
+      _positionArrays.set(vertexIndex, _vertexPositions[vertexIndex]);
     }
     
   }
 
 private:
+  // Generations of the positions and of the connectivity some derived data was computed from
+  struct Stamp {
+    unsigned long positions = 0, topology = 0;
+    bool operator == (const Stamp &o) const { return positions == o.positions && topology == o.topology; }
+  };
+  Stamp currentStamp() const
+  {
+    Stamp stamp;
+    stamp.positions = _positionsGeneration;
+    stamp.topology = _topologyGeneration;
+    return stamp;
+  }
+  void syncPositionArrays() const;
+  void createBuffers();
+  void updateBuffer(GLuint buffer, GLenum target, size_t size, const void *data);
+  void releaseBuffers();
+  // Empties _distanceNeighborhood and rewinds its arena, returns the arena allocation count
+  size_t clearNeighborhoods()
+  {
+    _distanceNeighborhood.clear();
+    _distanceNeighborhood.reserve(_vertexPositions.size());
+    _neighborhoodArena.reset();
+    return _neighborhoodArena.allocationCount();
+  }
+
+  unsigned long _positionsGeneration = 1, _normalsGeneration = 1, _texCoordsGeneration = 1, _topologyGeneration = 1;
   std::vector<glm::vec3> _vertexPositions;
-  std::vector<glm::vec3> _noNoiseVertexPositions;
-  std::vector<glm::vec3> _noisyVertexPositions;
+  mutable Vec3Arrays _positionArrays;  // structure of arrays copy of _vertexPositions for the SIMD kernels
+  mutable unsigned long _positionArraysGeneration = 0;
+  ChunkedBuffer<glm::vec3> _noNoiseVertexPositions;
+  ChunkedBuffer<glm::vec3> _noisyVertexPositions;
   std::vector<glm::vec3> _vertexNormals;
   std::vector<glm::vec2> _vertexTexCoords;
   std::vector<glm::uvec3> _triangleIndices;
-  std::vector<std::vector<unsigned int>> _distanceNeighborhood;
+  std::vector<glm::vec3> _vertexColors;
+  std::vector<ArenaVector<unsigned int>> _distanceNeighborhood;  // in _neighborhoodArena
   std::vector<std::vector<unsigned int>> _triangleNeighborhood;
   std::vector<float> _triangleArea;
   std::vector<glm::vec3> _triangleNormals;
-  std::vector<std::vector<unsigned int>> oneRingNeighboorhood;
+  std::vector<glm::vec3> _triangleAngles; // interior angle at each corner
   std::vector<unsigned int> _variance;
+  std::vector<unsigned int> _vertexFaceOffsets, _vertexFaces;
+  std::vector<unsigned int> _faceFaceOffsets, _faceFaces;
+
+  // what the derived data above was computed from
+  unsigned long _vertexFaceTopology = 0, _faceFaceTopology = 0, _triangleNeighborhoodTopology = 0;
+  Stamp _faceGeometryStamp, _triangleAnglesStamp;   // _triangleNormals and _triangleArea, _triangleAngles
+  Stamp _vertexNormalsStamp;                        // invalid when the normals were set from outside
+  bool _vertexNormalsAngleBased = false;
+  Stamp _vertexWeightedNormalsStamp;
+  unsigned long _texCoordsStamp = 0;                // positions generation
+  Stamp _neighborhoodStamp;                         // _distanceNeighborhood, for a radius or a ring
+  float _neighborhoodRadius = 0.f;
+  unsigned int _neighborhoodRing = 0;
+  mutable unsigned long _boundsGeneration = 0;      // positions generation
+  mutable glm::vec3 _boundsCenter;
+  mutable float _boundsRadius = 0.f;
+  Arena _scratch;            // temporaries of the operations called without an arena
+  Arena _neighborhoodArena;  // per-vertex lists of _distanceNeighborhood
+  mutable Snapshot _snapshot;  // last snapshot taken, the next one shares its unchanged chunks
+  mutable unsigned long _snapshotPositions = 0, _snapshotTopology = 0;  // generations
+  mutable std::mutex _snapshotMutex;  // guards the three above
+  std::vector<Snapshot> _undoSnapshots, _redoSnapshots;
+  void pushUndoSnapshot();  // drops the oldest one beyond UNDO_LEVELS
+
+  // heat method operators
+  SparseCholesky _heatSolver;    // M + t*L
+  SparseCholesky _poissonSolver; // L (slightly regularized)
+  std::vector<glm::vec3> _triangleCotangents; // cotangent of the angle at each corner
 
   GLuint _vao = 0;
   GLuint _posVbo = 0;
   GLuint _normalVbo = 0;
   GLuint _texCoordVbo = 0;
   GLuint _ibo = 0;
+  // generations and sizes of the data in the GPU buffers
+  unsigned long _uploadedPositions = 0, _uploadedNormals = 0, _uploadedTexCoords = 0, _uploadedTopology = 0;
+  size_t _uploadedVertexCount = 0, _uploadedTexCoordCount = 0, _uploadedTriangleCount = 0;
 };
 
 // utility: loader
-void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr);
+// The parsed mesh is cached in <filename>.mbin, which is loaded instead while the OFF file is unchanged
+void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr, unsigned int threadCount = 0, bool useCache = true);
+void saveOFF(const std::string &filename, const Mesh &mesh, unsigned int threadCount = 0);
 #endif  // MESH_H
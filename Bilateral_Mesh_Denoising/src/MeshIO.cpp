@@ -0,0 +1,742 @@
+#include "MeshIO.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "Lz4.h"
+#include "Parallel.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <sys/stat.h>
+
+namespace {
+
+const char MESH_BINARY_MAGIC[8] = { 'M', 'E', 'S', 'H', 'B', 'I', 'N', '\0' };
+const uint32_t MESH_BINARY_VERSION = 2;  // 2: the normals are normalized
+const uint32_t MESH_BINARY_HAS_ADJACENCY = 1;
+const uint64_t MESH_BINARY_ALIGNMENT = 64;
+const uint32_t CONVERSION_BLOCK = 1u << 20;  // elements between evictions of the mapped pages
+
+struct MeshBinaryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+  uint64_t sourceHash;
+  uint32_t vertexCount;
+  uint32_t triangleCount;
+  uint64_t positionsOffset;
+  uint64_t normalsOffset;
+  uint64_t texCoordsOffset;
+  uint64_t indicesOffset;
+  uint64_t adjacencyOffset;  // vertexCount+1 offsets, then adjacencySize face indices
+  uint64_t adjacencySize;
+};
+
+uint64_t alignOffset(uint64_t offset)
+{
+  return (offset + MESH_BINARY_ALIGNMENT - 1)/MESH_BINARY_ALIGNMENT*MESH_BINARY_ALIGNMENT;
+}
+
+// Writes size bytes at offset, padding the file with zeros up to offset
+bool writeAt(std::FILE *f, uint64_t &cursor, uint64_t offset, const void *data, size_t size)
+{
+  static const char zeros[MESH_BINARY_ALIGNMENT] = {};
+  if(offset < cursor || std::fwrite(zeros, 1, offset - cursor, f) != offset - cursor) return false;
+  cursor = offset + size;
+  return size == 0 || std::fwrite(data, 1, size, f) == size;
+}
+
+std::string lowerCaseExtension(const std::string &filename)
+{
+  const size_t dot = filename.find_last_of('.');
+  std::string extension = dot == std::string::npos ? std::string() : filename.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extension;
+}
+
+// Header of a binary mesh of V vertices and T triangles, without adjacency
+MeshBinaryHeader binaryHeader(uint64_t V, uint64_t T, const FileStamp &source)
+{
+  MeshBinaryHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MESH_BINARY_MAGIC, sizeof(header.magic));
+  header.version = MESH_BINARY_VERSION;
+  header.sourceSize = source.size;
+  header.sourceMtime = source.mtime;
+  header.sourceHash = source.hash;
+  header.vertexCount = V;
+  header.triangleCount = T;
+  header.positionsOffset = alignOffset(sizeof(header));
+  header.normalsOffset = alignOffset(header.positionsOffset + V*sizeof(glm::vec3));
+  header.texCoordsOffset = alignOffset(header.normalsOffset + V*sizeof(glm::vec3));
+  header.indicesOffset = alignOffset(header.texCoordsOffset + V*sizeof(glm::vec2));
+  return header;
+}
+
+template<typename T>
+bool readArray(const MappedFile &file, uint64_t offset, size_t count, std::vector<T> &out)
+{
+  if(offset % MESH_BINARY_ALIGNMENT != 0 || offset + count*sizeof(T) > file.size()) return false;
+  out.resize(count);
+  if(count) std::memcpy(out.data(), file.begin() + offset, count*sizeof(T));
+  return true;
+}
+
+} // namespace
+
+FileStamp computeFileStamp(const std::string &filename)
+{
+  FileStamp stamp;
+  struct stat st;
+  if(stat(filename.c_str(), &st) != 0) return stamp;
+  stamp.mtime = static_cast<int64_t>(st.st_mtime);
+
+  // FNV-1a over 8 byte words, then over the remaining bytes
+  MappedFile file(filename);
+  stamp.size = file.size();
+  uint64_t hash = 14695981039346656037ull;
+  const char *p = file.begin();
+  const size_t words = file.size()/8;
+  for(size_t i = 0; i < words; ++i, p += 8) {
+    uint64_t word;
+    std::memcpy(&word, p, 8);
+    hash = (hash ^ word)*1099511628211ull;
+  }
+  for(; p < file.end(); ++p)
+    hash = (hash ^ static_cast<unsigned char>(*p))*1099511628211ull;
+  stamp.hash = hash;
+  return stamp;
+}
+
+bool saveMeshBinary(const std::string &filename, const Mesh &mesh, const FileStamp &source, bool withAdjacency)
+{
+  const auto &P = mesh.vertexPositions();
+  const auto &N = mesh.vertexNormals();
+  const auto &UV = mesh.vertexTexCoords();
+  const auto &T = mesh.triangleIndices();
+  const auto &adjacencyOffsets = mesh.vertexFaceOffsets();
+  const auto &adjacency = mesh.vertexFaces();
+  if(N.size() != P.size() || UV.size() != P.size()) return false;
+  withAdjacency = withAdjacency && adjacencyOffsets.size() == P.size() + 1;
+
+  MeshBinaryHeader header = binaryHeader(P.size(), T.size(), source);
+  header.flags = withAdjacency ? MESH_BINARY_HAS_ADJACENCY : 0;
+  if(withAdjacency) {
+    header.adjacencyOffset = alignOffset(header.indicesOffset + T.size()*sizeof(glm::uvec3));
+    header.adjacencySize = adjacency.size();
+  }
+
+  // write to a temporary file first, so a crash never leaves a truncated cache behind
+  const std::string tmpFilename = filename + ".tmp";
+  std::FILE *f = std::fopen(tmpFilename.c_str(), "wb");
+  if(!f) return false;
+  uint64_t cursor = 0;
+  bool ok = writeAt(f, cursor, 0, &header, sizeof(header)) &&
+    writeAt(f, cursor, header.positionsOffset, P.data(), P.size()*sizeof(glm::vec3)) &&
+    writeAt(f, cursor, header.normalsOffset, N.data(), N.size()*sizeof(glm::vec3)) &&
+    writeAt(f, cursor, header.texCoordsOffset, UV.data(), UV.size()*sizeof(glm::vec2)) &&
+    writeAt(f, cursor, header.indicesOffset, T.data(), T.size()*sizeof(glm::uvec3));
+  if(ok && withAdjacency)
+    ok = writeAt(f, cursor, header.adjacencyOffset, adjacencyOffsets.data(), adjacencyOffsets.size()*sizeof(unsigned int)) &&
+      writeAt(f, cursor, cursor, adjacency.data(), adjacency.size()*sizeof(unsigned int));
+  ok = (std::fclose(f) == 0) && ok;
+  std::remove(filename.c_str());
+  if(!ok || std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+    std::remove(tmpFilename.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool loadMeshBinary(const std::string &filename, Mesh &mesh, const FileStamp *source)
+{
+  struct stat st;
+  if(stat(filename.c_str(), &st) != 0) return false;
+  MappedFile file(filename);
+  MeshBinaryHeader header;
+  if(file.size() < sizeof(header)) return false;
+  std::memcpy(&header, file.begin(), sizeof(header));
+  if(std::memcmp(header.magic, MESH_BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+     header.version != MESH_BINARY_VERSION ||
+     (source && (header.sourceSize != source->size || header.sourceMtime != source->mtime || header.sourceHash != source->hash)))
+    return false;
+
+  const size_t V = header.vertexCount;
+  if(!readArray(file, header.positionsOffset, V, mesh.vertexPositions()) ||
+     !readArray(file, header.normalsOffset, V, mesh.vertexNormals()) ||
+     !readArray(file, header.texCoordsOffset, V, mesh.vertexTexCoords()) ||
+     !readArray(file, header.indicesOffset, header.triangleCount, mesh.triangleIndices()))
+    return false;
+  for(const glm::uvec3 &t : mesh.triangleIndices())
+    if(t[0] >= V || t[1] >= V || t[2] >= V) return false;
+  mesh.topologyChanged();
+  mesh.normalsChanged();
+  mesh.texCoordsChanged();
+  if(header.flags & MESH_BINARY_HAS_ADJACENCY) {
+    // the adjacency is only taken when it is a valid CSR of faces of this mesh, otherwise it is
+    // rebuilt from the triangles
+    const uint64_t facesOffset = header.adjacencyOffset + (V + 1)*sizeof(unsigned int);
+    std::vector<unsigned int> offsets, faces;
+    bool valid = readArray(file, header.adjacencyOffset, V + 1, offsets) &&
+                 facesOffset + header.adjacencySize*sizeof(unsigned int) <= file.size() &&
+                 offsets[0] == 0 && offsets[V] == header.adjacencySize;
+    for(size_t v = 0; valid && v < V; ++v) valid = offsets[v] <= offsets[v + 1];
+    if(valid) {
+      faces.resize(header.adjacencySize);
+      if(!faces.empty())
+        std::memcpy(faces.data(), file.begin() + facesOffset, faces.size()*sizeof(unsigned int));
+      for(size_t k = 0; valid && k < faces.size(); ++k) valid = faces[k] < header.triangleCount;
+    }
+    if(valid) {
+      mesh.vertexFaceOffsets().swap(offsets);
+      mesh.vertexFaces().swap(faces);
+    } else {
+      std::cout << " > Invalid adjacency in <" << filename << ">, rebuilt from the triangles" << std::endl;
+      mesh.calculateVertexFaceAdjacency();
+    }
+  }
+  return true;
+}
+
+bool readMeshBinaryLayout(const char *data, size_t size, MeshBinaryLayout &layout)
+{
+  MeshBinaryHeader header;
+  if(size < sizeof(header)) return false;
+  std::memcpy(&header, data, sizeof(header));
+  if(std::memcmp(header.magic, MESH_BINARY_MAGIC, sizeof(header.magic)) != 0 || header.version != MESH_BINARY_VERSION)
+    return false;
+  const uint64_t V = header.vertexCount;
+  if(header.positionsOffset + V*sizeof(glm::vec3) > size || header.normalsOffset + V*sizeof(glm::vec3) > size ||
+     header.texCoordsOffset + V*sizeof(glm::vec2) > size ||
+     header.indicesOffset + uint64_t(header.triangleCount)*sizeof(glm::uvec3) > size)
+    return false;
+  layout.vertexCount = header.vertexCount;
+  layout.triangleCount = header.triangleCount;
+  layout.positionsOffset = header.positionsOffset;
+  layout.normalsOffset = header.normalsOffset;
+  layout.texCoordsOffset = header.texCoordsOffset;
+  layout.indicesOffset = header.indicesOffset;
+  return true;
+}
+
+MeshBinaryLayout createMeshBinary(const std::string &filename, uint32_t vertexCount, uint32_t triangleCount)
+{
+  const MeshBinaryHeader header = binaryHeader(vertexCount, triangleCount, FileStamp());
+  WritableMappedFile::createFile(filename, header.indicesOffset + uint64_t(triangleCount)*sizeof(glm::uvec3));
+  MeshBinaryLayout layout;
+  layout.vertexCount = vertexCount;
+  layout.triangleCount = triangleCount;
+  layout.positionsOffset = header.positionsOffset;
+  layout.normalsOffset = header.normalsOffset;
+  layout.texCoordsOffset = header.texCoordsOffset;
+  layout.indicesOffset = header.indicesOffset;
+  return layout;
+}
+
+void finishMeshBinary(WritableMappedFile &file, const MeshBinaryLayout &layout, bool computeNormals, bool computeTexCoords)
+{
+  const glm::vec3 *P = reinterpret_cast<const glm::vec3*>(file.begin() + layout.positionsOffset);
+  glm::vec3 *N = reinterpret_cast<glm::vec3*>(file.begin() + layout.normalsOffset);
+  glm::vec2 *UV = reinterpret_cast<glm::vec2*>(file.begin() + layout.texCoordsOffset);
+  const glm::uvec3 *T = reinterpret_cast<const glm::uvec3*>(file.begin() + layout.indicesOffset);
+  const uint32_t V = layout.vertexCount, F = layout.triangleCount;
+  if(computeNormals) {
+    // the file is zero filled: sum the area weighted face normals into it, then normalize
+    for(uint32_t f = 0; f < F; ++f) {
+      const glm::vec3 doubleAreaNormal = glm::cross(P[T[f][1]] - P[T[f][0]], P[T[f][2]] - P[T[f][0]]);
+      for(int k = 0; k < 3; ++k) N[T[f][k]] += doubleAreaNormal;
+      if((f + 1) % CONVERSION_BLOCK == 0) file.evict();
+    }
+    for(uint32_t v = 0; v < V; ++v) {
+      const float length = glm::length(N[v]);
+      if(length > 0.f) N[v] /= length;
+      if((v + 1) % CONVERSION_BLOCK == 0) file.evict();
+    }
+  }
+  if(computeTexCoords) {
+    // planar projection of Mesh::recomputePerVertexTextureCoordinates
+    glm::vec2 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+    for(uint32_t v = 0; v < V; ++v) {
+      boxMin = glm::min(boxMin, glm::vec2(P[v]));
+      boxMax = glm::max(boxMax, glm::vec2(P[v]));
+    }
+    for(uint32_t v = 0; v < V; ++v) {
+      UV[v] = (glm::vec2(P[v]) - boxMin)/(boxMax - boxMin);
+      if((v + 1) % CONVERSION_BLOCK == 0) file.evict();
+    }
+  }
+  const MeshBinaryHeader header = binaryHeader(V, F, FileStamp());
+  std::memcpy(file.begin(), &header, sizeof(header));
+}
+
+void convertToMeshBinary(const std::string &input, const std::string &output)
+{
+  const auto start = std::chrono::steady_clock::now();
+  const std::string extension = lowerCaseExtension(input);
+  try {
+    if(extension == "ply")
+      convertPLYToMeshBinary(input, output);
+    else if(extension == "off")
+      convertOFFToMeshBinary(input, output);
+    else
+      throw std::ios_base::failure("[Mesh Converter][convertToMeshBinary] Only OFF and PLY meshes are converted: " + input);
+  } catch(...) {
+    std::remove(output.c_str());
+    throw;
+  }
+  std::cout << " > Mesh <" << input << "> converted to <" << output << "> in "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << std::endl;
+}
+
+namespace {
+
+const char MESH_COMPRESSED_MAGIC[8] = { 'M', 'E', 'S', 'H', 'C', 'M', 'P', '\0' };
+const uint32_t MESH_COMPRESSED_VERSION = 1;
+const uint32_t MESH_COMPRESSED_BLOCK_SIZE = 1u << 16;  // vertices or triangles per block
+const unsigned int VERTEX_CACHE_SIZE = 16;
+const uint64_t MAX_VARINT_SIZE = 5;      // bytes of a 32 bit varint
+const uint64_t LZ4_MAX_EXPANSION = 255;  // bytes an LZ4 sequence can output per compressed byte
+
+enum MeshCompressedBlockType { POSITION_BLOCK = 0, NORMAL_BLOCK = 1, TRIANGLE_BLOCK = 2 };
+
+struct MeshCompressedHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t positionBits;
+  uint32_t vertexCount;
+  uint32_t triangleCount;
+  float boxMin[3];
+  float boxMax[3];
+  uint32_t blockCount;
+  uint32_t padding;
+};
+
+// followed in the file by blockCount of these, then by the compressed payloads
+struct MeshCompressedBlock {
+  uint32_t type;
+  uint32_t first;    // first vertex or triangle of the block
+  uint32_t count;
+  uint32_t rawSize;  // size of the payload once decompressed
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Tipsify (Sander et al. 2007): fans around the vertices still in a FIFO cache of cacheSize entries
+std::vector<unsigned int> tipsify(const std::vector<glm::uvec3> &T, size_t vertexCount, unsigned int cacheSize)
+{
+  std::vector<unsigned int> offsets(vertexCount + 1, 0), faces(3*T.size());
+  for(const auto &t : T)
+    for(int k = 0; k < 3; ++k) offsets[t[k] + 1]++;
+  for(size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
+  std::vector<unsigned int> live(vertexCount), fill(offsets.begin(), offsets.end() - 1);
+  for(unsigned int f = 0; f < T.size(); ++f)
+    for(int k = 0; k < 3; ++k) faces[fill[T[f][k]]++] = f;
+  for(size_t v = 0; v < vertexCount; ++v) live[v] = offsets[v + 1] - offsets[v];
+
+  std::vector<unsigned int> order, candidates, deadEnd;
+  order.reserve(T.size());
+  std::vector<unsigned int> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(T.size(), false);
+  unsigned int time = cacheSize + 1;
+  size_t cursor = 0;
+  long fanning = vertexCount ? 0 : -1;
+  while(fanning >= 0) {
+    candidates.clear();
+    for(unsigned int k = offsets[fanning]; k < offsets[fanning + 1]; ++k) {
+      const unsigned int f = faces[k];
+      if(emitted[f]) continue;
+      for(int c = 0; c < 3; ++c) {
+        const unsigned int v = T[f][c];
+        candidates.push_back(v);
+        deadEnd.push_back(v);
+        live[v]--;
+        if(time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+      }
+      emitted[f] = true;
+      order.push_back(f);
+    }
+    // next fanning vertex: the oldest candidate that stays in the cache during its whole fan
+    long best = -1;
+    int bestPriority = -1;
+    for(unsigned int v : candidates) {
+      if(live[v] == 0) continue;
+      int priority = 0;
+      if(time - cacheTime[v] + 2*live[v] <= cacheSize) priority = time - cacheTime[v];
+      if(priority > bestPriority) {
+        bestPriority = priority;
+        best = v;
+      }
+    }
+    while(best < 0 && !deadEnd.empty()) {
+      const unsigned int v = deadEnd.back();
+      deadEnd.pop_back();
+      if(live[v] > 0) best = v;
+    }
+    for(; best < 0 && cursor < vertexCount; ++cursor)
+      if(live[cursor] > 0) best = cursor;
+    fanning = best;
+  }
+  return order;
+}
+
+inline uint32_t zigzag(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+inline int32_t unzigzag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+inline void writeVarint(std::vector<uint8_t> &out, uint32_t v)
+{
+  for(; v >= 0x80; v >>= 7) out.push_back(static_cast<uint8_t>(v | 0x80));
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+inline bool readVarint(const uint8_t *&p, const uint8_t *end, uint32_t &v)
+{
+  v = 0;
+  for(int shift = 0; shift < 35 && p < end; shift += 7) {
+    const uint8_t b = *p++;
+    v |= static_cast<uint32_t>(b & 0x7f) << shift;
+    if(!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+// count elements of C 16 bit components: each component is delta coded against the previous
+// element and split in a plane of low bytes and a plane of high bytes, which LZ4 packs much better
+void encodeShortPlanes(const uint16_t *values, unsigned int count, unsigned int C, std::vector<uint8_t> &raw)
+{
+  raw.assign(2*C*count, 0);
+  for(unsigned int c = 0; c < C; ++c) {
+    uint8_t *low = &raw[2*c*count], *high = low + count;
+    uint16_t previous = 0;
+    for(unsigned int i = 0; i < count; ++i) {
+      const uint16_t delta = static_cast<uint16_t>(values[i*C + c] - previous);
+      previous = values[i*C + c];
+      low[i] = static_cast<uint8_t>(delta & 0xff);
+      high[i] = static_cast<uint8_t>(delta >> 8);
+    }
+  }
+}
+
+void decodeShortPlanes(const uint8_t *raw, unsigned int count, unsigned int C, uint16_t *values)
+{
+  for(unsigned int c = 0; c < C; ++c) {
+    const uint8_t *low = raw + 2*c*count, *high = low + count;
+    uint16_t previous = 0;
+    for(unsigned int i = 0; i < count; ++i) {
+      previous = static_cast<uint16_t>(previous + (low[i] | (high[i] << 8)));
+      values[i*C + c] = previous;
+    }
+  }
+}
+
+inline uint16_t toSnorm16(float v)
+{
+  return static_cast<uint16_t>(std::lround((glm::clamp(v, -1.f, 1.f)*0.5f + 0.5f)*65535.f));
+}
+
+inline float fromSnorm16(uint16_t v) { return v/65535.f*2.f - 1.f; }
+
+// Octahedral mapping of a unit vector to [-1,1]^2
+glm::vec2 octahedralEncode(glm::vec3 n)
+{
+  n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z) + 1e-20f;
+  glm::vec2 e(n.x, n.y);
+  if(n.z < 0.f)
+    e = glm::vec2((1.f - std::abs(n.y))*(n.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(n.x))*(n.y >= 0.f ? 1.f : -1.f));
+  return e;
+}
+
+glm::vec3 octahedralDecode(glm::vec2 e)
+{
+  glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+  const float t = glm::max(-n.z, 0.f);
+  n.x += n.x >= 0.f ? -t : t;
+  n.y += n.y >= 0.f ? -t : t;
+  return glm::normalize(n);
+}
+
+// Triangles are rotated so their smallest index comes first (orientation is kept), the first
+// index is coded relative to the first index of the previous triangle and the two others
+// relative to the first one
+void encodeTriangles(const glm::uvec3 *T, unsigned int count, std::vector<uint8_t> &raw)
+{
+  raw.clear();
+  raw.reserve(4*count);
+  uint32_t previous = 0;
+  for(unsigned int i = 0; i < count; ++i) {
+    glm::uvec3 t = T[i];
+    while(t[0] > t[1] || t[0] > t[2]) t = glm::uvec3(t[1], t[2], t[0]);
+    writeVarint(raw, zigzag(static_cast<int32_t>(t[0] - previous)));
+    writeVarint(raw, t[1] - t[0]);
+    writeVarint(raw, t[2] - t[0]);
+    previous = t[0];
+  }
+}
+
+bool decodeTriangles(const uint8_t *raw, size_t rawSize, unsigned int count, uint32_t vertexCount, glm::uvec3 *T)
+{
+  const uint8_t *p = raw, *end = raw + rawSize;
+  uint32_t previous = 0;
+  for(unsigned int i = 0; i < count; ++i) {
+    uint32_t d0, d1, d2;
+    if(!readVarint(p, end, d0) || !readVarint(p, end, d1) || !readVarint(p, end, d2)) return false;
+    const uint32_t a = previous + static_cast<uint32_t>(unzigzag(d0));
+    if(a >= vertexCount || d1 >= vertexCount - a || d2 >= vertexCount - a) return false;
+    T[i] = glm::uvec3(a, a + d1, a + d2);
+    previous = a;
+  }
+  return p == end;
+}
+
+} // namespace
+
+void saveMeshCompressed(const std::string &filename, const Mesh &mesh, unsigned int positionBits)
+{
+  if(positionBits < 1 || positionBits > 16)
+    throw std::ios_base::failure("[Mesh Saver][saveMeshCompressed] positionBits must be in [1, 16]");
+  const auto &P = mesh.vertexPositions();
+  const auto &N = mesh.vertexNormals();
+  const auto &T = mesh.triangleIndices();
+  const unsigned int V = P.size(), F = T.size();
+
+  // triangles in vertex cache order, vertices in order of first use (unused vertices last)
+  const std::vector<unsigned int> triangleOrder = tipsify(T, V, VERTEX_CACHE_SIZE);
+  std::vector<unsigned int> newIndex(V, V), vertexOrder;
+  vertexOrder.reserve(V);
+  std::vector<glm::uvec3> triangles(F);
+  for(unsigned int f = 0; f < F; ++f) {
+    const glm::uvec3 &t = T[triangleOrder[f]];
+    for(int k = 0; k < 3; ++k) {
+      if(newIndex[t[k]] == V) {
+        newIndex[t[k]] = vertexOrder.size();
+        vertexOrder.push_back(t[k]);
+      }
+      triangles[f][k] = newIndex[t[k]];
+    }
+  }
+  for(unsigned int v = 0; v < V; ++v)
+    if(newIndex[v] == V) {
+      newIndex[v] = vertexOrder.size();
+      vertexOrder.push_back(v);
+    }
+
+  MeshCompressedHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MESH_COMPRESSED_MAGIC, sizeof(header.magic));
+  header.version = MESH_COMPRESSED_VERSION;
+  header.positionBits = positionBits;
+  header.vertexCount = V;
+  header.triangleCount = F;
+  glm::vec3 boxMin(0.f), boxMax(0.f);
+  if(V) boxMin = boxMax = P[0];
+  for(const auto &p : P) {
+    boxMin = glm::min(boxMin, p);
+    boxMax = glm::max(boxMax, p);
+  }
+  for(int c = 0; c < 3; ++c) {
+    header.boxMin[c] = boxMin[c];
+    header.boxMax[c] = boxMax[c];
+  }
+
+  std::vector<MeshCompressedBlock> blocks;
+  const bool withNormals = N.size() == V;
+  for(unsigned int first = 0; first < V; first += MESH_COMPRESSED_BLOCK_SIZE) {
+    MeshCompressedBlock block = { POSITION_BLOCK, first, std::min(MESH_COMPRESSED_BLOCK_SIZE, V - first), 0, 0, 0 };
+    blocks.push_back(block);
+    if(withNormals) {
+      block.type = NORMAL_BLOCK;
+      blocks.push_back(block);
+    }
+  }
+  for(unsigned int first = 0; first < F; first += MESH_COMPRESSED_BLOCK_SIZE) {
+    MeshCompressedBlock block = { TRIANGLE_BLOCK, first, std::min(MESH_COMPRESSED_BLOCK_SIZE, F - first), 0, 0, 0 };
+    blocks.push_back(block);
+  }
+  header.blockCount = blocks.size();
+
+  const float maxQuantized = static_cast<float>((1u << positionBits) - 1);
+  const glm::vec3 extent = boxMax - boxMin;
+  std::vector<std::vector<uint8_t>> payloads(blocks.size());
+  parallelFor(0, blocks.size(), [&](unsigned int b) {
+    MeshCompressedBlock &block = blocks[b];
+    std::vector<uint16_t> values;
+    std::vector<uint8_t> raw;
+    if(block.type == POSITION_BLOCK) {
+      values.resize(3*block.count);
+      for(unsigned int i = 0; i < block.count; ++i) {
+        const glm::vec3 &p = P[vertexOrder[block.first + i]];
+        for(int c = 0; c < 3; ++c)
+          values[3*i + c] = extent[c] > 0.f ? static_cast<uint16_t>(std::lround((p[c] - boxMin[c])/extent[c]*maxQuantized)) : 0;
+      }
+      encodeShortPlanes(values.data(), block.count, 3, raw);
+    } else if(block.type == NORMAL_BLOCK) {
+      values.resize(2*block.count);
+      for(unsigned int i = 0; i < block.count; ++i) {
+        const glm::vec2 e = octahedralEncode(N[vertexOrder[block.first + i]]);
+        values[2*i] = toSnorm16(e.x);
+        values[2*i + 1] = toSnorm16(e.y);
+      }
+      encodeShortPlanes(values.data(), block.count, 2, raw);
+    } else {
+      encodeTriangles(&triangles[block.first], block.count, raw);
+    }
+    block.rawSize = raw.size();
+    lz4::compress(raw.data(), raw.size(), payloads[b]);
+    block.size = payloads[b].size();
+  }, 1);
+
+  uint64_t offset = sizeof(header) + blocks.size()*sizeof(MeshCompressedBlock);
+  for(auto &block : blocks) {
+    block.offset = offset;
+    offset += block.size;
+  }
+
+  std::FILE *f = std::fopen(filename.c_str(), "wb");
+  if(!f)
+    throw std::ios_base::failure("[Mesh Saver][saveMeshCompressed] Cannot open " + filename);
+  bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+    (blocks.empty() || std::fwrite(blocks.data(), sizeof(MeshCompressedBlock), blocks.size(), f) == blocks.size());
+  for(size_t b = 0; ok && b < payloads.size(); ++b)
+    ok = payloads[b].empty() || std::fwrite(payloads[b].data(), 1, payloads[b].size(), f) == payloads[b].size();
+  if(std::fclose(f) != 0 || !ok)
+    throw std::ios_base::failure("[Mesh Saver][saveMeshCompressed] Cannot write " + filename);
+  std::cout << " > Mesh saved to <" << filename << "> (" << offset << " bytes)" << std::endl;
+}
+
+void loadMeshCompressed(const std::string &filename, std::shared_ptr<Mesh> meshPtr)
+{
+  std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
+  meshPtr->clear();
+  MappedFile file(filename);
+  MeshCompressedHeader header;
+  if(file.size() < sizeof(header))
+    throw std::ios_base::failure("[Mesh Loader][loadMeshCompressed] File too small: " + filename);
+  std::memcpy(&header, file.begin(), sizeof(header));
+  if(std::memcmp(header.magic, MESH_COMPRESSED_MAGIC, sizeof(header.magic)) != 0 || header.version != MESH_COMPRESSED_VERSION)
+    throw std::ios_base::failure("[Mesh Loader][loadMeshCompressed] Not a compressed mesh or unsupported version: " + filename);
+  if(header.positionBits < 1 || header.positionBits > 16 ||
+     sizeof(header) + static_cast<uint64_t>(header.blockCount)*sizeof(MeshCompressedBlock) > file.size())
+    throw std::ios_base::failure("[Mesh Loader][loadMeshCompressed] Corrupted header: " + filename);
+  std::vector<MeshCompressedBlock> blocks(header.blockCount);
+  if(!blocks.empty())
+    std::memcpy(blocks.data(), file.begin() + sizeof(header), blocks.size()*sizeof(MeshCompressedBlock));
+
+  const unsigned int V = header.vertexCount, F = header.triangleCount;
+  // the sizes in the header are checked against each other and against the file before anything
+  // is allocated: the blocks cover the vertices and the triangles exactly once (the normals are
+  // optional), each payload has the size of its elements and fits what its compressed bytes can
+  // expand to
+  uint64_t positionCount = 0, normalCount = 0, triangleCount = 0;
+  for(const auto &block : blocks) {
+    const uint64_t limit = block.type == TRIANGLE_BLOCK ? F : V;
+    uint64_t minRawSize = 0, maxRawSize = 0;
+    if(block.type == POSITION_BLOCK || block.type == NORMAL_BLOCK)
+      minRawSize = maxRawSize = (block.type == POSITION_BLOCK ? 6 : 4)*static_cast<uint64_t>(block.count);
+    else if(block.type == TRIANGLE_BLOCK)
+      minRawSize = 3*static_cast<uint64_t>(block.count), maxRawSize = 3*MAX_VARINT_SIZE*static_cast<uint64_t>(block.count);
+    if(block.type > TRIANGLE_BLOCK || block.offset > file.size() || block.size > file.size() - block.offset ||
+       block.first > limit || block.count > limit - block.first ||
+       block.rawSize < minRawSize || block.rawSize > maxRawSize || block.rawSize > LZ4_MAX_EXPANSION*(block.size + 1))
+      throw std::ios_base::failure("[Mesh Loader][loadMeshCompressed] Corrupted block table: " + filename);
+    if(block.type == POSITION_BLOCK) positionCount += block.count;
+    else if(block.type == NORMAL_BLOCK) normalCount += block.count;
+    else triangleCount += block.count;
+  }
+  if(positionCount != V || (normalCount != 0 && normalCount != V) || triangleCount != F)
+    throw std::ios_base::failure("[Mesh Loader][loadMeshCompressed] The blocks do not cover the mesh: " + filename);
+
+  auto &P = meshPtr->vertexPositions();
+  auto &N = meshPtr->vertexNormals();
+  auto &T = meshPtr->triangleIndices();
+  P.resize(V);
+  N.resize(V, glm::vec3(0.f, 0.f, 1.f));
+  T.resize(F);
+  bool hasNormals = false;
+  for(const auto &block : blocks)
+    hasNormals = hasNormals || block.type == NORMAL_BLOCK;
+
+  const glm::vec3 boxMin(header.boxMin[0], header.boxMin[1], header.boxMin[2]);
+  const glm::vec3 boxMax(header.boxMax[0], header.boxMax[1], header.boxMax[2]);
+  const glm::vec3 step = (boxMax - boxMin)/static_cast<float>((1u << header.positionBits) - 1);
+  std::atomic<bool> valid(true);
+  parallelFor(0, blocks.size(), [&](unsigned int b) {
+    const MeshCompressedBlock &block = blocks[b];
+    std::vector<uint8_t> raw(block.rawSize);
+    if(!lz4::decompress(reinterpret_cast<const uint8_t*>(file.begin() + block.offset), block.size, raw.data(), raw.size())) {
+      valid = false;
+      return;
+    }
+    if(block.type == TRIANGLE_BLOCK) {
+      if(!decodeTriangles(raw.data(), raw.size(), block.count, V, &T[block.first])) valid = false;
+      return;
+    }
+    const unsigned int C = block.type == POSITION_BLOCK ? 3 : 2;
+    if(raw.size() != 2*C*block.count) {
+      valid = false;
+      return;
+    }
+    std::vector<uint16_t> values(C*block.count);
+    decodeShortPlanes(raw.data(), block.count, C, values.data());
+    for(unsigned int i = 0; i < block.count; ++i) {
+      if(block.type == POSITION_BLOCK)
+        P[block.first + i] = boxMin + step*glm::vec3(values[3*i], values[3*i + 1], values[3*i + 2]);
+      else
+        N[block.first + i] = octahedralDecode(glm::vec2(fromSnorm16(values[2*i]), fromSnorm16(values[2*i + 1])));
+    }
+  }, 1);
+  if(!valid) {
+    meshPtr->clear();
+    throw std::ios_base::failure("[Mesh Loader][loadMeshCompressed] Corrupted block in " + filename);
+  }
+
+  meshPtr->topologyChanged();
+  meshPtr->normalsChanged();
+  meshPtr->texCoordsChanged();
+  meshPtr->vertexTexCoords().resize(V, glm::vec2(0.f, 0.f));
+  if(!hasNormals) meshPtr->recomputePerVertexNormals();
+  meshPtr->recomputePerVertexTextureCoordinates();
+  std::cout << " > Mesh <" << filename << "> loaded" <<  std::endl;
+}
+
+
+void loadMesh(const std::string &filename, std::shared_ptr<Mesh> meshPtr)
+{
+  const std::string extension = lowerCaseExtension(filename);
+  if(extension == "mcmp")
+    loadMeshCompressed(filename, meshPtr);
+  else if(extension == "ply")
+    loadPLY(filename, meshPtr);
+  else if(extension == "obj")
+    loadOBJ(filename, meshPtr);
+  else if(extension == "stl")
+    loadSTL(filename, meshPtr);
+  else if(extension == "mbin") {
+    meshPtr->clear();
+    if(!loadMeshBinary(filename, *meshPtr))
+      throw std::ios_base::failure("[Mesh Loader][loadMesh] Cannot read the binary mesh " + filename);
+  } else
+    loadOFF(filename, meshPtr);
+}
+
+void saveMesh(const std::string &filename, const Mesh &mesh)
+{
+  const std::string extension = lowerCaseExtension(filename);
+  if(extension == "mcmp")
+    saveMeshCompressed(filename, mesh);
+  else if(extension == "ply")
+    savePLY(filename, mesh);
+  else if(extension == "mbin") {
+    if(!saveMeshBinary(filename, mesh))
+      throw std::ios_base::failure("[Mesh Saver][saveMesh] Cannot write " + filename);
+  } else if(extension == "off")
+    saveOFF(filename, mesh);
+  else
+    throw std::ios_base::failure("[Mesh Saver][saveMesh] Unknown mesh format: " + filename);
+}
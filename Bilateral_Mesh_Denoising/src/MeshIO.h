@@ -0,0 +1,90 @@
+#ifndef MESH_IO_H
+#define MESH_IO_H
+
+#include <string>
+#include <cstdint>
+#include <memory>
+
+class Mesh;
+class WritableMappedFile;
+
+// Identifies the content of a source file (size, modification time and hash of the content)
+struct FileStamp {
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  uint64_t hash = 0;
+};
+
+FileStamp computeFileStamp(const std::string &filename);
+
+// Native binary mesh format, used as a cache next to the text meshes (<file>.mbin).
+// A versioned header is followed by the positions, normals, texture coordinates and triangle
+// indices, each array aligned on 64 bytes, and by an optional vertex -> faces adjacency section.
+bool saveMeshBinary(const std::string &filename, const Mesh &mesh, const FileStamp &source = FileStamp(), bool withAdjacency = true);
+// Returns false when the file is missing, of another version or, when source is given, was built
+// from another source.
+bool loadMeshBinary(const std::string &filename, Mesh &mesh, const FileStamp *source = nullptr);
+
+// Where the arrays of a binary mesh are, for the readers that map the file instead of loading it
+struct MeshBinaryLayout {
+  uint32_t vertexCount = 0;
+  uint32_t triangleCount = 0;
+  uint64_t positionsOffset = 0;   // glm::vec3 per vertex
+  uint64_t normalsOffset = 0;     // glm::vec3 per vertex
+  uint64_t texCoordsOffset = 0;   // glm::vec2 per vertex
+  uint64_t indicesOffset = 0;     // glm::uvec3 per triangle
+};
+// Returns false when data is not a binary mesh of the current version or its arrays do not fit
+// in the size bytes
+bool readMeshBinaryLayout(const char *data, size_t size, MeshBinaryLayout &layout);
+
+// Binary meshes written in place through a WritableMappedFile, by the converters of the meshes
+// too large to be loaded. createMeshBinary creates the zero filled file of the final size and
+// returns where its arrays go. Once the positions and the triangles (and maybe the normals and
+// texture coordinates) are written, finishMeshBinary computes the missing arrays as the loaders
+// do, then writes the header: an interrupted conversion never leaves a file that reads as a mesh.
+MeshBinaryLayout createMeshBinary(const std::string &filename, uint32_t vertexCount, uint32_t triangleCount);
+void finishMeshBinary(WritableMappedFile &file, const MeshBinaryLayout &layout, bool computeNormals, bool computeTexCoords);
+
+// Converts an OFF or binary PLY mesh to a binary mesh without loading it, for the out-of-core
+// filters: the input is mapped and parsed straight into the mapped output, and the mapped pages
+// are dropped as the passes go, so the memory used does not grow with the mesh. The result has no
+// adjacency section and no source stamp.
+void convertToMeshBinary(const std::string &input, const std::string &output);
+// The two converters behind it
+void convertOFFToMeshBinary(const std::string &input, const std::string &output);
+void convertPLYToMeshBinary(const std::string &input, const std::string &output);
+
+// Compressed mesh container (.mcmp) for archiving. Positions are quantized to positionBits
+// per axis in the bounding box, normals are stored in octahedral form on 2x16 bits, triangles
+// are reordered for the vertex cache (and vertices in order of first use) and their indices are
+// delta and varint coded. Every block of 64k elements is then LZ4 compressed on its own, so the
+// blocks are encoded and decoded in parallel. Texture coordinates are not stored but recomputed.
+void saveMeshCompressed(const std::string &filename, const Mesh &mesh, unsigned int positionBits = 16);
+void loadMeshCompressed(const std::string &filename, std::shared_ptr<Mesh> meshPtr);
+
+// Binary PLY (little or big endian). Vertex x/y/z, optional nx/ny/nz, red/green/blue and s/t
+// (or u/v) properties are read, other properties and elements are skipped; polygons are fan
+// triangulated. Vertex records made of float x, y, z only are copied with a single memcpy.
+// Normals and texture coordinates are recomputed when the file does not provide them.
+void loadPLY(const std::string &filename, std::shared_ptr<Mesh> meshPtr);
+// Writes a binary little endian PLY with positions, normals, colors (when present) and triangles
+void savePLY(const std::string &filename, const Mesh &mesh);
+
+// Wavefront OBJ (v, vt, vn and f records, everything else is ignored). The file is parsed in
+// parallel chunks and the (position, texcoord, normal) corners of the faces are merged into
+// unified vertices through a hash table; polygons are fan triangulated. Normals and texture
+// coordinates are recomputed unless every corner references one.
+void loadOBJ(const std::string &filename, std::shared_ptr<Mesh> meshPtr, unsigned int threadCount = 0);
+
+// STL, binary or ASCII. The triangle corners are welded into shared vertices when they are closer
+// than weldTolerance times the bounding box diagonal (parallel spatial hashing), and triangles that
+// collapse are removed. Normals and texture coordinates are recomputed.
+void loadSTL(const std::string &filename, std::shared_ptr<Mesh> meshPtr, float weldTolerance = 1e-6f);
+
+// Loads a mesh, picking the reader from the file extension (.off, .ply, .obj, .stl, .mbin or .mcmp)
+void loadMesh(const std::string &filename, std::shared_ptr<Mesh> meshPtr);
+// Saves a mesh, picking the writer from the file extension (.off, .ply, .mbin or .mcmp)
+void saveMesh(const std::string &filename, const Mesh &mesh);
+
+#endif  // MESH_IO_H
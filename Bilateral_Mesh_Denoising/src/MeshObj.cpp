@@ -0,0 +1,283 @@
+#include "MeshIO.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "TextTokenizer.h"
+#include "Parallel.h"
+
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace {
+
+const unsigned int NO_INDEX = 0xFFFFFFFFu;
+
+enum ObjLineType { OBJ_OTHER, OBJ_POSITION, OBJ_TEXCOORD, OBJ_NORMAL, OBJ_FACE };
+
+// Kind of the line starting at p (after the leading blanks)
+ObjLineType objLineType(const char *p, const char *lineEnd)
+{
+  while(p < lineEnd && (*p == ' ' || *p == '\t')) ++p;
+  if(lineEnd - p < 2) return OBJ_OTHER;
+  const bool blank = p[1] == ' ' || p[1] == '\t';
+  if(p[0] == 'f' && blank) return OBJ_FACE;
+  if(p[0] != 'v') return OBJ_OTHER;
+  if(blank) return OBJ_POSITION;
+  if(lineEnd - p < 3 || (p[2] != ' ' && p[2] != '\t')) return OBJ_OTHER;
+  return p[1] == 't' ? OBJ_TEXCOORD : p[1] == 'n' ? OBJ_NORMAL : OBJ_OTHER;
+}
+
+// Counts the blank separated tokens of a face line (the corners)
+size_t countFaceCorners(const char *p, const char *lineEnd)
+{
+  while(p < lineEnd && *p != 'f') ++p;
+  size_t count = 0;
+  bool inToken = false;
+  for(++p; p < lineEnd && *p != '#'; ++p) {
+    const bool blank = *p == ' ' || *p == '\t' || *p == '\r';
+    if(!blank && !inToken) ++count;
+    inToken = !blank;
+  }
+  return count;
+}
+
+// Part of the file parsed by one task. The counts come from a first pass, the prefix sums of
+// these counts give the place of the chunk records in the global arrays.
+struct ObjChunk {
+  const char *begin, *end;
+  size_t lines = 0, positions = 0, texCoords = 0, normals = 0, faces = 0, corners = 0;
+  size_t firstLine = 0, firstPosition = 0, firstTexCoord = 0, firstNormal = 0, firstFace = 0, firstCorner = 0;
+  std::exception_ptr error;
+};
+
+// Converts a 1-based (or negative, relative) OBJ index to a 0-based index, NO_INDEX when invalid
+unsigned int resolveObjIndex(int64_t index, size_t countSoFar)
+{
+  if(index > 0) return static_cast<unsigned int>(index - 1);
+  if(index < 0 && static_cast<size_t>(-index) <= countSoFar) return static_cast<unsigned int>(countSoFar + index);
+  return NO_INDEX;
+}
+
+void parseObjChunk(ObjChunk &chunk, const std::string &filename,
+                   std::vector<glm::vec3> &positions, std::vector<glm::vec2> &texCoords,
+                   std::vector<glm::vec3> &normals, std::vector<size_t> &faceStart,
+                   std::vector<glm::uvec3> &corners)
+{
+  size_t line = chunk.firstLine, position = chunk.firstPosition, texCoord = chunk.firstTexCoord;
+  size_t normal = chunk.firstNormal, face = chunk.firstFace, corner = chunk.firstCorner;
+  const size_t cornerEnd = chunk.firstCorner + chunk.corners;
+  for(const char *p = chunk.begin; p < chunk.end; ++line) {
+    const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+    if(!lineEnd) lineEnd = chunk.end;
+    const ObjLineType type = objLineType(p, lineEnd);
+    if(type != OBJ_OTHER) {
+      while(*p == ' ' || *p == '\t') ++p;
+      TextTokenizer in(p + (type == OBJ_POSITION || type == OBJ_FACE ? 1 : 2), lineEnd, "loadOBJ", filename, line);
+      if(type == OBJ_POSITION) {
+        glm::vec3 &v = positions[position++];
+        v.x = in.readFloat("x");
+        v.y = in.readFloat("y");
+        v.z = in.readFloat("z");
+      } else if(type == OBJ_TEXCOORD) {
+        glm::vec2 &t = texCoords[texCoord++];
+        t.x = in.readFloat("u");
+        t.y = in.atLineEnd() ? 0.f : in.readFloat("v");
+      } else if(type == OBJ_NORMAL) {
+        glm::vec3 &n = normals[normal++];
+        n.x = in.readFloat("nx");
+        n.y = in.readFloat("ny");
+        n.z = in.readFloat("nz");
+      } else {
+        faceStart[face++] = corner;
+        while(!in.atLineEnd()) {
+          // v, v/t, v//n or v/t/n
+          if(corner == cornerEnd) in.fail("end of line");
+          glm::uvec3 &c = corners[corner++];
+          c = glm::uvec3(resolveObjIndex(in.readInt("vertex index"), position), NO_INDEX, NO_INDEX);
+          if(in.readChar('/')) {
+            if(!in.readChar('/')) {
+              c[1] = resolveObjIndex(in.readInt("texture coordinate index"), texCoord);
+              if(!in.readChar('/')) continue;
+            }
+            c[2] = resolveObjIndex(in.readInt("normal index"), normal);
+          }
+        }
+      }
+    }
+    p = lineEnd + 1;
+  }
+}
+
+// Open addressing table from (position, texcoord, normal) triples to the unified vertex index.
+// The slots only hold vertex indices, the triples are read back from the vertex array.
+class CornerTable {
+public:
+  explicit CornerTable(size_t expected)
+  {
+    size_t capacity = 16;
+    while(capacity < 2*expected) capacity *= 2;
+    _slots.assign(capacity, NO_INDEX);
+  }
+
+  unsigned int insert(const glm::uvec3 &key, std::vector<glm::uvec3> &vertices)
+  {
+    if(2*(vertices.size() + 1) > _slots.size()) grow(vertices);
+    const size_t mask = _slots.size() - 1;
+    for(size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+      if(_slots[i] == NO_INDEX) {
+        _slots[i] = vertices.size();
+        vertices.push_back(key);
+        return _slots[i];
+      }
+      if(vertices[_slots[i]] == key) return _slots[i];
+    }
+  }
+
+private:
+  static size_t hash(const glm::uvec3 &key)
+  {
+    uint64_t h = key[0]*0x9E3779B97F4A7C15ull;
+    h ^= (key[1] + 0x632BE59BD9B4E019ull)*0xC2B2AE3D27D4EB4Full;
+    h ^= (key[2] + 0x85EBCA77C2B2AE63ull)*0x165667B19E3779F9ull;
+    return static_cast<size_t>(h ^ (h >> 29));
+  }
+
+  void grow(const std::vector<glm::uvec3> &vertices)
+  {
+    _slots.assign(2*_slots.size(), NO_INDEX);
+    const size_t mask = _slots.size() - 1;
+    for(unsigned int v = 0; v < vertices.size(); ++v) {
+      size_t i = hash(vertices[v]) & mask;
+      while(_slots[i] != NO_INDEX) i = (i + 1) & mask;
+      _slots[i] = v;
+    }
+  }
+
+  std::vector<unsigned int> _slots;
+};
+
+} // namespace
+
+void loadOBJ(const std::string &filename, std::shared_ptr<Mesh> meshPtr, unsigned int threadCount)
+{
+  std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
+  meshPtr->clear();
+  MappedFile file(filename);
+
+  // cut the file in chunks at line boundaries, at least 1MB each
+  if(threadCount == 0) threadCount = parallelThreadCount();
+  const size_t MIN_CHUNK_SIZE = 1 << 20;
+  const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(4*threadCount, file.size()/MIN_CHUNK_SIZE));
+  std::vector<ObjChunk> chunks(chunkCount);
+  for(size_t c = 0; c < chunkCount; ++c) {
+    const char *p = c == 0 ? file.begin() : std::max(chunks[c - 1].begin, file.begin() + file.size()*c/chunkCount);
+    while(c > 0 && p < file.end() && p[-1] != '\n') ++p;
+    chunks[c].begin = p;
+    if(c > 0) chunks[c - 1].end = p;
+  }
+  chunks.back().end = file.end();
+
+  // first pass: count the records of every chunk
+  parallelFor(0, chunkCount, [&](unsigned int c) {
+    ObjChunk &chunk = chunks[c];
+    for(const char *p = chunk.begin; p < chunk.end; ++chunk.lines) {
+      const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+      if(!lineEnd) lineEnd = chunk.end;
+      switch(objLineType(p, lineEnd)) {
+      case OBJ_POSITION: ++chunk.positions; break;
+      case OBJ_TEXCOORD: ++chunk.texCoords; break;
+      case OBJ_NORMAL: ++chunk.normals; break;
+      case OBJ_FACE:
+        ++chunk.faces;
+        chunk.corners += countFaceCorners(p, lineEnd);
+        break;
+      default: break;
+      }
+      p = lineEnd + 1;
+    }
+  }, 1);
+  chunks[0].firstLine = 1;
+  for(size_t c = 1; c < chunkCount; ++c) {
+    const ObjChunk &previous = chunks[c - 1];
+    chunks[c].firstLine = previous.firstLine + previous.lines;
+    chunks[c].firstPosition = previous.firstPosition + previous.positions;
+    chunks[c].firstTexCoord = previous.firstTexCoord + previous.texCoords;
+    chunks[c].firstNormal = previous.firstNormal + previous.normals;
+    chunks[c].firstFace = previous.firstFace + previous.faces;
+    chunks[c].firstCorner = previous.firstCorner + previous.corners;
+  }
+  const ObjChunk &last = chunks.back();
+  std::vector<glm::vec3> positions(last.firstPosition + last.positions), normals(last.firstNormal + last.normals);
+  std::vector<glm::vec2> texCoords(last.firstTexCoord + last.texCoords);
+  std::vector<size_t> faceStart(last.firstFace + last.faces + 1);
+  std::vector<glm::uvec3> corners(last.firstCorner + last.corners);
+  faceStart.back() = corners.size();
+
+  // second pass: parse every chunk in place
+  parallelFor(0, chunkCount, [&](unsigned int c) {
+    try {
+      parseObjChunk(chunks[c], filename, positions, texCoords, normals, faceStart, corners);
+    } catch(...) {
+      chunks[c].error = std::current_exception();
+    }
+  }, 1);
+  for(const auto &chunk : chunks)
+    if(chunk.error) std::rethrow_exception(chunk.error);
+
+  // unify the corners into vertices
+  bool allTexCoords = !texCoords.empty(), allNormals = !normals.empty();
+  for(const auto &c : corners) {
+    if(c[0] >= positions.size() || (c[1] != NO_INDEX && c[1] >= texCoords.size()) || (c[2] != NO_INDEX && c[2] >= normals.size()))
+      throw std::ios_base::failure("[Mesh Loader][loadOBJ] Index out of range in " + filename);
+    allTexCoords = allTexCoords && c[1] != NO_INDEX;
+    allNormals = allNormals && c[2] != NO_INDEX;
+  }
+  std::vector<unsigned int> cornerVertex(corners.size());
+  std::vector<glm::uvec3> vertices;
+  if(!allTexCoords && !allNormals) {
+    // positions only: the OBJ vertices are the mesh vertices
+    for(size_t k = 0; k < corners.size(); ++k) cornerVertex[k] = corners[k][0];
+    vertices.resize(positions.size());
+    for(unsigned int v = 0; v < vertices.size(); ++v) vertices[v] = glm::uvec3(v, 0, 0);
+  } else {
+    vertices.reserve(positions.size());
+    CornerTable table(positions.size());
+    for(size_t k = 0; k < corners.size(); ++k) {
+      const glm::uvec3 key(corners[k][0], allTexCoords ? corners[k][1] : 0, allNormals ? corners[k][2] : 0);
+      cornerVertex[k] = table.insert(key, vertices);
+    }
+  }
+
+  auto &P = meshPtr->vertexPositions();
+  auto &N = meshPtr->vertexNormals();
+  auto &UV = meshPtr->vertexTexCoords();
+  auto &T = meshPtr->triangleIndices();
+  P.resize(vertices.size());
+  N.resize(vertices.size(), glm::vec3(0.f, 0.f, 1.f));
+  UV.resize(vertices.size(), glm::vec2(0.f, 0.f));
+  for(size_t v = 0; v < vertices.size(); ++v) {
+    P[v] = positions[vertices[v][0]];
+    if(allTexCoords) UV[v] = texCoords[vertices[v][1]];
+    if(allNormals) {
+      // a zero normal of the file stays zero instead of becoming NaN
+      const glm::vec3 &n = normals[vertices[v][2]];
+      const float length = glm::length(n);
+      N[v] = length > 0.f ? n/length : n;
+    }
+  }
+  // fan triangulation of the polygons
+  const size_t faceCount = faceStart.size() - 1;
+  T.reserve(corners.size() > 2*faceCount ? corners.size() - 2*faceCount : 0);
+  for(size_t f = 0; f < faceCount; ++f)
+    for(size_t k = faceStart[f] + 2; k < faceStart[f + 1]; ++k)
+      T.push_back(glm::uvec3(cornerVertex[faceStart[f]], cornerVertex[k - 1], cornerVertex[k]));
+
+  meshPtr->topologyChanged();
+  meshPtr->normalsChanged();
+  meshPtr->texCoordsChanged();
+  if(!allNormals) meshPtr->recomputePerVertexNormals();
+  if(!allTexCoords) meshPtr->recomputePerVertexTextureCoordinates();
+  std::cout << " > Mesh <" << filename << "> loaded (" << positions.size() << " positions, "
+            << P.size() << " vertices after merging the corners)" << std::endl;
+}
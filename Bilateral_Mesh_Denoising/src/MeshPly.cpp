@@ -0,0 +1,496 @@
+#include "MeshIO.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+enum PlyType { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID };
+
+PlyType parsePlyType(const std::string &name)
+{
+  if(name == "char" || name == "int8") return PLY_INT8;
+  if(name == "uchar" || name == "uint8") return PLY_UINT8;
+  if(name == "short" || name == "int16") return PLY_INT16;
+  if(name == "ushort" || name == "uint16") return PLY_UINT16;
+  if(name == "int" || name == "int32") return PLY_INT32;
+  if(name == "uint" || name == "uint32") return PLY_UINT32;
+  if(name == "float" || name == "float32") return PLY_FLOAT32;
+  if(name == "double" || name == "float64") return PLY_FLOAT64;
+  return PLY_INVALID;
+}
+
+size_t plyTypeSize(PlyType type)
+{
+  static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+  return sizes[type];
+}
+
+struct PlyProperty {
+  std::string name;
+  PlyType type;
+  bool isList;
+  PlyType countType;
+  size_t offset;  // in the record, only meaningful when the element has no list property
+};
+
+struct PlyElement {
+  std::string name;
+  size_t count;
+  std::vector<PlyProperty> properties;
+  bool fixedSize;
+  size_t stride;
+
+  const PlyProperty *find(const char *name) const
+  {
+    for(const auto &p : properties)
+      if(p.name == name) return &p;
+    return nullptr;
+  }
+};
+
+bool isHostBigEndian()
+{
+  const uint16_t one = 1;
+  uint8_t first;
+  std::memcpy(&first, &one, 1);
+  return first == 0;
+}
+
+// Reads one value of the given type, swapping its bytes when the file endianness is not the host one
+double readPlyValue(const char *p, PlyType type, bool swap)
+{
+  unsigned char bytes[8];
+  const size_t size = plyTypeSize(type);
+  std::memcpy(bytes, p, size);
+  if(swap) std::reverse(bytes, bytes + size);
+  switch(type) {
+  case PLY_INT8: { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+  case PLY_UINT8: return bytes[0];
+  case PLY_INT16: { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+  case PLY_UINT16: { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+  case PLY_INT32: { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+  case PLY_UINT32: { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+  case PLY_FLOAT32: { float v; std::memcpy(&v, bytes, 4); return v; }
+  case PLY_FLOAT64: { double v; std::memcpy(&v, bytes, 8); return v; }
+  default: return 0.0;
+  }
+}
+
+// Largest value of an integer type, integer colors are stored in [0, max]; 1 for the float types
+double plyColorMax(PlyType type)
+{
+  switch(type) {
+  case PLY_INT8: return 127.0;
+  case PLY_UINT8: return 255.0;
+  case PLY_INT16: return 32767.0;
+  case PLY_UINT16: return 65535.0;
+  case PLY_INT32: return 2147483647.0;
+  case PLY_UINT32: return 4294967295.0;
+  default: return 1.0;
+  }
+}
+
+// Cursor on the binary body, every read is bounds checked
+class PlyReader {
+public:
+  PlyReader(const char *begin, const char *end, bool swap, const std::string &filename)
+    : _p(begin), _end(end), _swap(swap), _filename(filename) {}
+
+  const char *take(size_t size)
+  {
+    if(size > static_cast<size_t>(_end - _p))
+      throw std::ios_base::failure("[Mesh Loader][loadPLY] Unexpected end of file in " + _filename);
+    const char *p = _p;
+    _p += size;
+    return p;
+  }
+
+  double read(PlyType type) { return readPlyValue(take(plyTypeSize(type)), type, _swap); }
+
+  bool swap() const { return _swap; }
+
+private:
+  const char *_p, *_end;
+  bool _swap;
+  const std::string &_filename;
+};
+
+void skipElement(PlyReader &reader, const PlyElement &element)
+{
+  if(element.fixedSize) {
+    reader.take(element.count*element.stride);
+    return;
+  }
+  for(size_t i = 0; i < element.count; ++i)
+    for(const auto &property : element.properties) {
+      if(property.isList)
+        reader.take(static_cast<size_t>(reader.read(property.countType))*plyTypeSize(property.type));
+      else
+        reader.take(plyTypeSize(property.type));
+    }
+}
+
+// Properties of the vertex element that are read, null when absent
+struct PlyVertexFormat {
+  const PlyProperty *position[3], *normal[3], *color[3], *texCoord[2];
+  bool hasNormals, hasTexCoords, hasColors;
+  bool packed;  // the record is exactly a glm::vec3
+};
+
+PlyVertexFormat vertexFormat(const PlyElement &element, bool swap, const std::string &filename)
+{
+  PlyVertexFormat format;
+  const PlyProperty *x = element.find("x"), *y = element.find("y"), *z = element.find("z");
+  if(!element.fixedSize || !x || !y || !z)
+    throw std::ios_base::failure("[Mesh Loader][loadPLY] Unsupported vertex element in " + filename);
+  format.packed = element.properties.size() == 3 && element.stride == sizeof(glm::vec3) && !swap &&
+    x->offset == 0 && y->offset == 4 && z->offset == 8 &&
+    x->type == PLY_FLOAT32 && y->type == PLY_FLOAT32 && z->type == PLY_FLOAT32;
+  format.position[0] = x;
+  format.position[1] = y;
+  format.position[2] = z;
+  const char *normalNames[3] = { "nx", "ny", "nz" }, *colorNames[3] = { "red", "green", "blue" };
+  for(int c = 0; c < 3; ++c) {
+    format.normal[c] = element.find(normalNames[c]);
+    format.color[c] = element.find(colorNames[c]);
+  }
+  const char *texCoordNames[3][2] = { { "s", "t" }, { "u", "v" }, { "texture_u", "texture_v" } };
+  for(int n = 0; n < 3; ++n) {
+    format.texCoord[0] = element.find(texCoordNames[n][0]);
+    format.texCoord[1] = element.find(texCoordNames[n][1]);
+    if(format.texCoord[0] && format.texCoord[1]) break;
+  }
+  format.hasNormals = format.normal[0] && format.normal[1] && format.normal[2];
+  format.hasTexCoords = format.texCoord[0] && format.texCoord[1];
+  format.hasColors = format.color[0] && format.color[1] && format.color[2];
+  return format;
+}
+
+// Decodes the vertex records [begin, end) of data into the arrays, indexed like the records. The
+// normals, texture coordinates and colors are skipped when their array is null.
+void decodeVertices(const char *data, size_t begin, size_t end, const PlyElement &element, const PlyVertexFormat &format,
+                    bool swap, glm::vec3 *P, glm::vec3 *N, glm::vec2 *UV, glm::vec3 *C)
+{
+  // the record is exactly a glm::vec3: one copy
+  if(format.packed) {
+    if(end > begin) std::memcpy(P + begin, data + begin*element.stride, (end - begin)*sizeof(glm::vec3));
+    return;
+  }
+  for(size_t i = begin; i < end; ++i) {
+    const char *record = data + i*element.stride;
+    for(int c = 0; c < 3; ++c)
+      P[i][c] = static_cast<float>(readPlyValue(record + format.position[c]->offset, format.position[c]->type, swap));
+    if(N)
+      for(int c = 0; c < 3; ++c)
+        N[i][c] = static_cast<float>(readPlyValue(record + format.normal[c]->offset, format.normal[c]->type, swap));
+    if(UV)
+      for(int c = 0; c < 2; ++c)
+        UV[i][c] = static_cast<float>(readPlyValue(record + format.texCoord[c]->offset, format.texCoord[c]->type, swap));
+    if(C)
+      for(int c = 0; c < 3; ++c) {
+        const double value = readPlyValue(record + format.color[c]->offset, format.color[c]->type, swap);
+        // integer colors are in [0, max of their type], float colors already in [0, 1]
+        C[i][c] = static_cast<float>(value/plyColorMax(format.color[c]->type));
+      }
+  }
+}
+
+void readVertices(PlyReader &reader, const PlyElement &element, Mesh &mesh, bool &hasNormals, bool &hasTexCoords, const std::string &filename)
+{
+  const PlyVertexFormat format = vertexFormat(element, reader.swap(), filename);
+  auto &P = mesh.vertexPositions();
+  P.resize(element.count);
+  const char *data = reader.take(element.count*element.stride);
+  hasNormals = !format.packed && format.hasNormals;
+  hasTexCoords = !format.packed && format.hasTexCoords;
+  const bool hasColors = !format.packed && format.hasColors;
+  if(hasNormals) mesh.vertexNormals().resize(element.count);
+  if(hasTexCoords) mesh.vertexTexCoords().resize(element.count);
+  if(hasColors) mesh.vertexColors().resize(element.count);
+  decodeVertices(data, 0, element.count, element, format, reader.swap(), P.data(),
+                 hasNormals ? mesh.vertexNormals().data() : nullptr,
+                 hasTexCoords ? mesh.vertexTexCoords().data() : nullptr,
+                 hasColors ? mesh.vertexColors().data() : nullptr);
+}
+
+// Reads the face element and calls emit(triangle) for every triangle of the fan triangulation
+template<typename Emit>
+void readFaces(PlyReader &reader, const PlyElement &element, size_t vertexCount, const std::string &filename, Emit emit)
+{
+  const PlyProperty *indices = element.find("vertex_indices");
+  if(!indices) indices = element.find("vertex_index");
+  if(!indices || !indices->isList || indices->type == PLY_FLOAT32 || indices->type == PLY_FLOAT64)
+    throw std::ios_base::failure("[Mesh Loader][loadPLY] Unsupported face element in " + filename);
+
+  // common case: a single "list uchar int/uint" property, triangles are read as whole records
+  const bool fastPath = element.properties.size() == 1 && indices->countType == PLY_UINT8 &&
+    plyTypeSize(indices->type) == 4 && !reader.swap();
+  std::vector<unsigned int> polygon;
+  for(size_t f = 0; f < element.count; ++f) {
+    if(fastPath) {
+      const size_t count = static_cast<unsigned char>(*reader.take(1));
+      if(count == 3) {
+        glm::uvec3 t;
+        std::memcpy(&t, reader.take(sizeof(t)), sizeof(t));
+        if(t[0] >= vertexCount || t[1] >= vertexCount || t[2] >= vertexCount)
+          throw std::ios_base::failure("[Mesh Loader][loadPLY] Vertex index out of range in " + filename);
+        emit(t);
+        continue;
+      }
+      polygon.resize(count);
+      for(size_t k = 0; k < count; ++k)
+        polygon[k] = static_cast<unsigned int>(reader.read(indices->type));
+    } else {
+      for(const auto &property : element.properties) {
+        if(&property != indices) {
+          if(property.isList)
+            reader.take(static_cast<size_t>(reader.read(property.countType))*plyTypeSize(property.type));
+          else
+            reader.take(plyTypeSize(property.type));
+          continue;
+        }
+        polygon.resize(static_cast<size_t>(reader.read(property.countType)));
+        for(auto &index : polygon)
+          index = static_cast<unsigned int>(reader.read(property.type));
+      }
+    }
+    for(auto index : polygon)
+      if(index >= vertexCount)
+        throw std::ios_base::failure("[Mesh Loader][loadPLY] Vertex index out of range in " + filename);
+    for(size_t k = 2; k < polygon.size(); ++k)
+      emit(glm::uvec3(polygon[0], polygon[k - 1], polygon[k]));
+  }
+}
+
+// Parses the header of a binary PLY file, returns the start of the body
+const char *readPlyHeader(const MappedFile &file, const std::string &filename, std::vector<PlyElement> &elements, bool &swap)
+{
+  const char *headerEnd = nullptr;
+  static const char END_HEADER[] = "end_header";
+  for(const char *p = file.begin(); p + sizeof(END_HEADER) - 1 <= file.end(); ++p)
+    if(std::memcmp(p, END_HEADER, sizeof(END_HEADER) - 1) == 0 && (p == file.begin() || p[-1] == '\n')) {
+      headerEnd = static_cast<const char*>(std::memchr(p, '\n', file.end() - p));
+      break;
+    }
+  if(file.size() < 3 || std::memcmp(file.begin(), "ply", 3) != 0 || !headerEnd)
+    throw std::ios_base::failure("[Mesh Loader][loadPLY] Not a PLY file: " + filename);
+  std::istringstream header(std::string(file.begin(), headerEnd));
+  std::string line, format;
+  while(std::getline(header, line)) {
+    std::istringstream words(line);
+    std::string keyword;
+    words >> keyword;
+    if(keyword == "format") {
+      words >> format;
+    } else if(keyword == "element") {
+      PlyElement element;
+      words >> element.name >> element.count;
+      element.fixedSize = true;
+      element.stride = 0;
+      elements.push_back(element);
+    } else if(keyword == "property") {
+      if(elements.empty())
+        throw std::ios_base::failure("[Mesh Loader][loadPLY] Property outside of an element in " + filename);
+      PlyProperty property;
+      std::string type;
+      words >> type;
+      property.isList = type == "list";
+      property.countType = PLY_INVALID;
+      if(property.isList) {
+        std::string countType;
+        words >> countType >> type;
+        property.countType = parsePlyType(countType);
+      }
+      property.type = parsePlyType(type);
+      words >> property.name;
+      if(property.type == PLY_INVALID || (property.isList && property.countType == PLY_INVALID))
+        throw std::ios_base::failure("[Mesh Loader][loadPLY] Unknown property type in " + filename + ": " + line);
+      PlyElement &element = elements.back();
+      property.offset = element.stride;
+      element.stride += plyTypeSize(property.type);
+      element.fixedSize = element.fixedSize && !property.isList;
+      element.properties.push_back(property);
+    }
+  }
+  bool bigEndian;
+  if(format == "binary_little_endian") bigEndian = false;
+  else if(format == "binary_big_endian") bigEndian = true;
+  else throw std::ios_base::failure("[Mesh Loader][loadPLY] Only binary PLY files are supported: " + filename);
+  swap = bigEndian != isHostBigEndian();
+  return headerEnd + 1;
+}
+
+} // namespace
+
+void loadPLY(const std::string &filename, std::shared_ptr<Mesh> meshPtr)
+{
+  std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
+  meshPtr->clear();
+  MappedFile file(filename);
+  std::vector<PlyElement> elements;
+  bool swap;
+  const char *body = readPlyHeader(file, filename, elements, swap);
+
+  PlyReader reader(body, file.end(), swap, filename);
+  bool hasNormals = false, hasTexCoords = false, hasVertices = false;
+  for(const auto &element : elements) {
+    if(element.name == "vertex" && !hasVertices) {
+      readVertices(reader, element, *meshPtr, hasNormals, hasTexCoords, filename);
+      hasVertices = true;
+    } else if(element.name == "face" && hasVertices) {
+      auto &T = meshPtr->triangleIndices();
+      T.reserve(element.count);
+      readFaces(reader, element, meshPtr->vertexPositions().size(), filename,
+                [&](const glm::uvec3 &t) { T.push_back(t); });
+    } else {
+      skipElement(reader, element);
+    }
+  }
+
+  meshPtr->topologyChanged();
+  meshPtr->normalsChanged();
+  meshPtr->texCoordsChanged();
+  const size_t V = meshPtr->vertexPositions().size();
+  if(!hasNormals) {
+    meshPtr->vertexNormals().resize(V, glm::vec3(0.f, 0.f, 1.f));
+    meshPtr->recomputePerVertexNormals();
+  }
+  if(!hasTexCoords) {
+    meshPtr->vertexTexCoords().resize(V, glm::vec2(0.f, 0.f));
+    meshPtr->recomputePerVertexTextureCoordinates();
+  }
+  std::cout << " > Mesh <" << filename << "> loaded" <<  std::endl;
+}
+
+// PLY to binary mesh, see convertToMeshBinary. A first pass counts the triangles of the faces, a
+// second one writes the vertices (normals and texture coordinates included) and the triangles.
+void convertPLYToMeshBinary(const std::string &input, const std::string &output)
+{
+  std::cout << " > Start converting mesh <" << input << ">" << std::endl;
+  const MappedFile file(input);
+  std::vector<PlyElement> elements;
+  bool swap;
+  const char *body = readPlyHeader(file, input, elements, swap);
+  const size_t BLOCK = size_t(1) << 20;  // records between evictions of the mapped pages
+
+  const PlyElement *vertices = nullptr;
+  size_t triangleCount = 0;
+  PlyReader counter(body, file.end(), swap, input);
+  for(const auto &element : elements) {
+    if(element.name == "vertex" && !vertices) {
+      vertices = &element;
+      skipElement(counter, element);
+    } else if(element.name == "face" && vertices) {
+      readFaces(counter, element, vertices->count, input, [&](const glm::uvec3 &) {
+        if(++triangleCount % BLOCK == 0) file.evict();
+      });
+    } else {
+      skipElement(counter, element);
+    }
+  }
+  if(!vertices || vertices->count > UINT32_MAX || triangleCount > UINT32_MAX)
+    throw std::ios_base::failure("[Mesh Converter][convertPLYToMeshBinary] No vertex element or too many elements in " + input);
+  const PlyVertexFormat format = vertexFormat(*vertices, swap, input);
+  const bool hasNormals = !format.packed && format.hasNormals;
+  const bool hasTexCoords = !format.packed && format.hasTexCoords;
+
+  const MeshBinaryLayout layout = createMeshBinary(output, vertices->count, triangleCount);
+  WritableMappedFile out(output);
+  glm::vec3 *P = reinterpret_cast<glm::vec3*>(out.begin() + layout.positionsOffset);
+  glm::vec3 *N = reinterpret_cast<glm::vec3*>(out.begin() + layout.normalsOffset);
+  glm::vec2 *UV = reinterpret_cast<glm::vec2*>(out.begin() + layout.texCoordsOffset);
+  glm::uvec3 *T = reinterpret_cast<glm::uvec3*>(out.begin() + layout.indicesOffset);
+  PlyReader reader(body, file.end(), swap, input);
+  size_t triangle = 0;
+  bool verticesRead = false;
+  for(const auto &element : elements) {
+    if(&element == vertices) {
+      verticesRead = true;
+      const char *data = reader.take(element.count*element.stride);
+      for(size_t begin = 0; begin < element.count; begin += BLOCK) {
+        decodeVertices(data, begin, std::min(element.count, begin + BLOCK), element, format, swap, P,
+                       hasNormals ? N : nullptr, hasTexCoords ? UV : nullptr, nullptr);
+        file.evict();
+        out.evict();
+      }
+    } else if(element.name == "face" && verticesRead) {
+      readFaces(reader, element, vertices->count, input, [&](const glm::uvec3 &t) {
+        T[triangle++] = t;
+        if(triangle % BLOCK == 0) {
+          file.evict();
+          out.evict();
+        }
+      });
+    } else {
+      skipElement(reader, element);
+    }
+  }
+  file.evict();
+  finishMeshBinary(out, layout, !hasNormals, !hasTexCoords);
+}
+
+void savePLY(const std::string &filename, const Mesh &mesh)
+{
+  const auto &P = mesh.vertexPositions();
+  const auto &N = mesh.vertexNormals();
+  const auto &C = mesh.vertexColors();
+  const auto &T = mesh.triangleIndices();
+  const bool withNormals = N.size() == P.size();
+  const bool withColors = C.size() == P.size();
+
+  // written in the host byte order, which the header declares
+  std::ostringstream header;
+  header << "ply\nformat " << (isHostBigEndian() ? "binary_big_endian" : "binary_little_endian") << " 1.0\n"
+         << "element vertex " << P.size() << "\nproperty float x\nproperty float y\nproperty float z\n";
+  if(withNormals) header << "property float nx\nproperty float ny\nproperty float nz\n";
+  if(withColors) header << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+  header << "element face " << T.size() << "\nproperty list uchar uint vertex_indices\nend_header\n";
+
+  std::FILE *f = std::fopen(filename.c_str(), "wb");
+  if(!f)
+    throw std::ios_base::failure("[Mesh Saver][savePLY] Cannot open " + filename);
+  const std::string headerText = header.str();
+  bool ok = std::fwrite(headerText.data(), 1, headerText.size(), f) == headerText.size();
+
+  // records are assembled in a buffer and written by chunks
+  const size_t CHUNK = 1 << 16;
+  const size_t vertexStride = sizeof(glm::vec3)*(withNormals ? 2 : 1) + (withColors ? 3 : 0);
+  std::vector<char> buffer;
+  for(size_t first = 0; ok && first < P.size(); first += CHUNK) {
+    const size_t count = std::min(CHUNK, P.size() - first);
+    buffer.resize(count*vertexStride);
+    char *out = buffer.data();
+    for(size_t i = first; i < first + count; ++i) {
+      std::memcpy(out, &P[i], sizeof(glm::vec3));
+      out += sizeof(glm::vec3);
+      if(withNormals) {
+        std::memcpy(out, &N[i], sizeof(glm::vec3));
+        out += sizeof(glm::vec3);
+      }
+      if(withColors)
+        for(int c = 0; c < 3; ++c)
+          *out++ = static_cast<char>(static_cast<unsigned char>(std::lround(glm::clamp(C[i][c], 0.f, 1.f)*255.f)));
+    }
+    ok = std::fwrite(buffer.data(), 1, buffer.size(), f) == buffer.size();
+  }
+  const size_t faceStride = 1 + sizeof(glm::uvec3);
+  for(size_t first = 0; ok && first < T.size(); first += CHUNK) {
+    const size_t count = std::min(CHUNK, T.size() - first);
+    buffer.resize(count*faceStride);
+    for(size_t i = 0; i < count; ++i) {
+      buffer[i*faceStride] = 3;
+      std::memcpy(&buffer[i*faceStride + 1], &T[first + i], sizeof(glm::uvec3));
+    }
+    ok = std::fwrite(buffer.data(), 1, buffer.size(), f) == buffer.size();
+  }
+  if(std::fclose(f) != 0 || !ok)
+    throw std::ios_base::failure("[Mesh Saver][savePLY] Cannot write " + filename);
+  std::cout << " > Mesh saved to <" << filename << ">" << std::endl;
+}
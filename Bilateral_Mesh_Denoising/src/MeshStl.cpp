@@ -0,0 +1,224 @@
+#include "MeshIO.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "TextTokenizer.h"
+#include "Parallel.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const size_t STL_HEADER_SIZE = 80;
+const size_t STL_TRIANGLE_SIZE = 50;  // normal, 3 vertices (floats) and a 16 bit attribute
+const unsigned int STL_GRID_BITS = 21;
+const uint64_t EMPTY_CELL = ~0ull;
+const unsigned int NO_CELL = 0xFFFFFFFFu;
+
+void readBinarySTL(const MappedFile &file, std::vector<glm::vec3> &soup)
+{
+  uint32_t count;
+  std::memcpy(&count, file.begin() + STL_HEADER_SIZE, sizeof(count));
+  soup.resize(3*static_cast<size_t>(count));
+  const char *data = file.begin() + STL_HEADER_SIZE + sizeof(count);
+  parallelFor(0, count, [&](unsigned int f) {
+    std::memcpy(&soup[3*f], data + f*STL_TRIANGLE_SIZE + sizeof(glm::vec3), 3*sizeof(glm::vec3));
+  }, 1 << 16);
+}
+
+void readAsciiSTL(const MappedFile &file, const std::string &filename, std::vector<glm::vec3> &soup)
+{
+  TextTokenizer in(file.begin(), file.end(), "loadSTL", filename);
+  if(!in.readKeyword("solid")) in.fail("solid");
+  // skip the name of the solid
+  while(!in.atLineEnd()) in.readChar(*in.position());
+  for(;;) {
+    in.skipSpaces();
+    if(in.readKeyword("endsolid")) break;
+    if(!in.readKeyword("facet") || !in.readKeyword("normal")) in.fail("facet normal");
+    in.readFloat("nx");
+    in.readFloat("ny");
+    in.readFloat("nz");
+    if(!in.readKeyword("outer") || !in.readKeyword("loop")) in.fail("outer loop");
+    for(int k = 0; k < 3; ++k) {
+      if(!in.readKeyword("vertex")) in.fail("vertex");
+      glm::vec3 p;
+      p.x = in.readFloat("x");
+      p.y = in.readFloat("y");
+      p.z = in.readFloat("z");
+      soup.push_back(p);
+    }
+    if(!in.readKeyword("endloop")) in.fail("endloop");
+    if(!in.readKeyword("endfacet")) in.fail("endfacet");
+  }
+}
+
+// Flat table from a cell code to the range of the points of the cell in the sorted point list
+class CellTable {
+public:
+  explicit CellTable(size_t cellCount)
+  {
+    size_t capacity = 16;
+    while(capacity < 2*cellCount) capacity *= 2;
+    _codes.assign(capacity, EMPTY_CELL);
+    _starts.resize(capacity);
+  }
+
+  void insert(uint64_t code, unsigned int start)
+  {
+    size_t i = slot(code);
+    _codes[i] = code;
+    _starts[i] = start;
+  }
+
+  // first point of the cell, or NO_CELL
+  unsigned int find(uint64_t code) const
+  {
+    const size_t i = slot(code);
+    return _codes[i] == code ? _starts[i] : NO_CELL;
+  }
+
+private:
+  size_t slot(uint64_t code) const
+  {
+    const size_t mask = _codes.size() - 1;
+    size_t i = static_cast<size_t>((code*0x9E3779B97F4A7C15ull) >> 17) & mask;
+    while(_codes[i] != EMPTY_CELL && _codes[i] != code) i = (i + 1) & mask;
+    return i;
+  }
+
+  std::vector<uint64_t> _codes;
+  std::vector<unsigned int> _starts;
+};
+
+// Merges the points closer than epsilon. The grid cells are 2*epsilon wide, so all the points
+// within epsilon of a point lie in the 2x2x2 cells around the corner of its cell it is closest to.
+// Every point first picks the smallest index within epsilon, then the picks are followed to
+// their root, which gives the same result whatever the number of threads.
+void weldPoints(const std::vector<glm::vec3> &points, float epsilon,
+                std::vector<unsigned int> &pointToVertex, std::vector<glm::vec3> &vertices)
+{
+  const unsigned int n = points.size();
+  glm::vec3 boxMin(0.f), boxMax(0.f);
+  if(n) boxMin = boxMax = points[0];
+  for(const auto &p : points) {
+    boxMin = glm::min(boxMin, p);
+    boxMax = glm::max(boxMax, p);
+  }
+  const glm::vec3 extent = boxMax - boxMin;
+  const float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+  // a coarser grid is still correct, it is only slower
+  const float cellSize = std::max(std::max(2.f*epsilon, maxExtent/((1u << STL_GRID_BITS) - 2)), 1e-30f);
+  auto cellOf = [&](const glm::vec3 &p) {
+    return glm::min(glm::uvec3((p - boxMin)/cellSize), glm::uvec3((1u << STL_GRID_BITS) - 2));
+  };
+  auto codeOf = [](const glm::uvec3 &c) {
+    return (static_cast<uint64_t>(c.x) << (2*STL_GRID_BITS)) | (static_cast<uint64_t>(c.y) << STL_GRID_BITS) | c.z;
+  };
+
+  // points sorted by cell
+  std::vector<std::pair<uint64_t, unsigned int>> sorted(n);
+  parallelFor(0, n, [&](unsigned int i) { sorted[i] = std::make_pair(codeOf(cellOf(points[i])), i); });
+  const unsigned int threadCount = std::min(parallelThreadCount(), std::max(1u, n/(1u << 16)));
+  const unsigned int chunk = (n + threadCount - 1)/std::max(1u, threadCount);
+  parallelFor(0, threadCount, [&](unsigned int t) {
+    std::sort(sorted.begin() + std::min(n, t*chunk), sorted.begin() + std::min(n, (t + 1)*chunk));
+  }, 1);
+  for(unsigned int width = chunk; width < n; width *= 2)
+    for(unsigned int begin = 0; begin + width < n; begin += 2*width)
+      std::inplace_merge(sorted.begin() + begin, sorted.begin() + begin + width, sorted.begin() + std::min(n, begin + 2*width));
+
+  unsigned int cellCount = 0;
+  for(unsigned int k = 0; k < n; ++k)
+    if(k == 0 || sorted[k].first != sorted[k - 1].first) ++cellCount;
+  CellTable cells(cellCount);
+  for(unsigned int k = 0; k < n; ++k)
+    if(k == 0 || sorted[k].first != sorted[k - 1].first) cells.insert(sorted[k].first, k);
+
+  std::vector<unsigned int> representative(n);
+  const float epsilon2 = epsilon*epsilon;
+  parallelFor(0, n, [&](unsigned int i) {
+    const glm::vec3 &p = points[i];
+    const glm::uvec3 cell = cellOf(p);
+    const glm::vec3 local = (p - boxMin)/cellSize - glm::vec3(cell);
+    unsigned int best = i;
+    for(int corner = 0; corner < 8; ++corner) {
+      glm::ivec3 c(cell);
+      for(int axis = 0; axis < 3; ++axis)
+        if(corner & (1 << axis)) c[axis] += local[axis] < 0.5f ? -1 : 1;
+      if(c.x < 0 || c.y < 0 || c.z < 0) continue;
+      const uint64_t code = codeOf(glm::uvec3(c));
+      for(unsigned int k = cells.find(code); k < n && sorted[k].first == code; ++k) {
+        const unsigned int j = sorted[k].second;
+        if(j < best) {
+          const glm::vec3 d = points[j] - p;
+          if(glm::dot(d, d) <= epsilon2) best = j;
+        }
+      }
+    }
+    representative[i] = best;
+  });
+
+  // representatives have smaller indices, so one pass in order reaches the roots
+  pointToVertex.resize(n);
+  vertices.clear();
+  for(unsigned int i = 0; i < n; ++i) {
+    if(representative[i] == i) {
+      pointToVertex[i] = vertices.size();
+      vertices.push_back(points[i]);
+    } else {
+      representative[i] = representative[representative[i]];
+      pointToVertex[i] = pointToVertex[representative[i]];
+    }
+  }
+}
+
+} // namespace
+
+void loadSTL(const std::string &filename, std::shared_ptr<Mesh> meshPtr, float weldTolerance)
+{
+  std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
+  meshPtr->clear();
+  MappedFile file(filename);
+
+  // binary files may start with "solid" too, the size tells them apart
+  std::vector<glm::vec3> soup;
+  uint32_t binaryCount = 0;
+  if(file.size() >= STL_HEADER_SIZE + sizeof(binaryCount))
+    std::memcpy(&binaryCount, file.begin() + STL_HEADER_SIZE, sizeof(binaryCount));
+  if(file.size() >= STL_HEADER_SIZE + sizeof(binaryCount) &&
+     file.size() == STL_HEADER_SIZE + sizeof(binaryCount) + binaryCount*static_cast<uint64_t>(STL_TRIANGLE_SIZE))
+    readBinarySTL(file, soup);
+  else
+    readAsciiSTL(file, filename, soup);
+
+  glm::vec3 boxMin(0.f), boxMax(0.f);
+  if(!soup.empty()) boxMin = boxMax = soup[0];
+  for(const auto &p : soup) {
+    boxMin = glm::min(boxMin, p);
+    boxMax = glm::max(boxMax, p);
+  }
+  std::vector<unsigned int> pointToVertex;
+  weldPoints(soup, weldTolerance*glm::length(boxMax - boxMin), pointToVertex, meshPtr->vertexPositions());
+
+  // triangles collapsed by the welding are dropped
+  auto &T = meshPtr->triangleIndices();
+  T.reserve(soup.size()/3);
+  size_t degenerate = 0;
+  for(size_t f = 0; 3*f < soup.size(); ++f) {
+    const glm::uvec3 t(pointToVertex[3*f], pointToVertex[3*f + 1], pointToVertex[3*f + 2]);
+    if(t[0] == t[1] || t[1] == t[2] || t[2] == t[0]) ++degenerate;
+    else T.push_back(t);
+  }
+
+  meshPtr->topologyChanged();
+  meshPtr->normalsChanged();
+  meshPtr->texCoordsChanged();
+  const size_t V = meshPtr->vertexPositions().size();
+  meshPtr->vertexNormals().resize(V, glm::vec3(0.f, 0.f, 1.f));
+  meshPtr->vertexTexCoords().resize(V, glm::vec2(0.f, 0.f));
+  meshPtr->recomputePerVertexNormals();
+  meshPtr->recomputePerVertexTextureCoordinates();
+  std::cout << " > Mesh <" << filename << "> loaded: " << soup.size() << " corners welded into " << V
+            << " vertices (" << soup.size() - V << " merged), " << degenerate << " degenerate triangles removed" << std::endl;
+}
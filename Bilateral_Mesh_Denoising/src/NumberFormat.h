@@ -0,0 +1,98 @@
+#ifndef NUMBER_FORMAT_H
+#define NUMBER_FORMAT_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Locale independent number formatting into a caller provided buffer, for the text mesh writers.
+// Each function writes at most the given number of characters and returns the end of the output.
+
+const size_t MAX_FORMATTED_UNSIGNED = 10;
+const size_t MAX_FORMATTED_FLOAT = 16;
+
+inline char *formatUnsigned(char *out, unsigned int value)
+{
+  char digits[MAX_FORMATTED_UNSIGNED];
+  int n = 0;
+  do {
+    digits[n++] = static_cast<char>('0' + value%10);
+    value /= 10;
+  } while(value);
+  while(n) *out++ = digits[--n];
+  return out;
+}
+
+// Nine significant digits, which is enough for the value to read back as the same float.
+// Trailing zeros are dropped; plain notation for exponents in [-5, 8], scientific otherwise.
+inline char *formatFloat(char *out, float value)
+{
+  if(value != value) {
+    std::memcpy(out, "nan", 3);
+    return out + 3;
+  }
+  if(std::signbit(value)) {
+    *out++ = '-';
+    value = -value;
+  }
+  if(std::isinf(value)) {
+    std::memcpy(out, "inf", 3);
+    return out + 3;
+  }
+  if(value == 0.f) {
+    *out++ = '0';
+    return out;
+  }
+
+  static const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23, 1e24, 1e25, 1e26, 1e27, 1e28, 1e29, 1e30,
+    1e31, 1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39, 1e40, 1e41, 1e42, 1e43, 1e44, 1e45,
+    1e46, 1e47, 1e48, 1e49, 1e50, 1e51, 1e52, 1e53, 1e54, 1e55 };
+  // the double product errs by far less than a unit of the 9th digit, which float needs not
+  const double v = value;
+  auto scaledDigits = [&](int exponent) {
+    const int k = 8 - exponent;
+    return static_cast<uint64_t>(std::llround(k >= 0 ? v*powersOfTen[k] : v/powersOfTen[-k]));
+  };
+  int binaryExponent;
+  std::frexp(v, &binaryExponent);
+  int exponent = static_cast<int>(std::floor((binaryExponent - 1)*0.30102999566398120));
+  uint64_t digits = scaledDigits(exponent);
+  while(digits >= 1000000000ull) digits = scaledDigits(++exponent);
+  while(digits < 100000000ull) digits = scaledDigits(--exponent);
+
+  char text[9];
+  for(int i = 8; i >= 0; --i, digits /= 10)
+    text[i] = static_cast<char>('0' + digits%10);
+  int n = 9;
+  while(n > 1 && text[n - 1] == '0') --n;
+
+  if(exponent >= 0 && exponent <= 8) {
+    for(int i = 0; i <= exponent; ++i) *out++ = i < n ? text[i] : '0';
+    if(n > exponent + 1) {
+      *out++ = '.';
+      for(int i = exponent + 1; i < n; ++i) *out++ = text[i];
+    }
+  } else if(exponent < 0 && exponent >= -5) {
+    *out++ = '0';
+    *out++ = '.';
+    for(int i = -1; i > exponent; --i) *out++ = '0';
+    for(int i = 0; i < n; ++i) *out++ = text[i];
+  } else {
+    *out++ = text[0];
+    if(n > 1) {
+      *out++ = '.';
+      for(int i = 1; i < n; ++i) *out++ = text[i];
+    }
+    *out++ = 'e';
+    if(exponent < 0) {
+      *out++ = '-';
+      exponent = -exponent;
+    }
+    out = formatUnsigned(out, static_cast<unsigned int>(exponent));
+  }
+  return out;
+}
+
+#endif  // NUMBER_FORMAT_H
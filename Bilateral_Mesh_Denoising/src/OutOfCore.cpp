@@ -0,0 +1,552 @@
+#include "OutOfCore.h"
+#include "Mesh.h"
+#include "MeshIO.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t BYTES_PER_LOCAL_VERTEX = 128;  // tile working set: positions, normals, triangles, search grid
+const unsigned int MAX_TILE_COUNT = 1u << 18;
+const unsigned int STREAMING_BLOCK = 1u << 22;  // vertices or triangles per block of the streaming passes
+const size_t COPY_BUFFER_SIZE = 1 << 22;
+
+// Current resident set size, 0 when unknown
+size_t residentBytes()
+{
+#ifdef __linux__
+  std::FILE *f = std::fopen("/proc/self/statm", "r");
+  if(!f) return 0;
+  unsigned long size = 0, resident = 0;
+  const bool ok = std::fscanf(f, "%lu %lu", &size, &resident) == 2;
+  std::fclose(f);
+  return ok ? static_cast<size_t>(resident)*static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+#else
+  return 0;
+#endif
+}
+
+void copyFile(const std::string &from, const std::string &to)
+{
+  std::FILE *in = std::fopen(from.c_str(), "rb");
+  if(!in)
+    throw std::ios_base::failure("[Out Of Core][copyFile] Cannot open " + from);
+  std::FILE *out = std::fopen(to.c_str(), "wb");
+  if(!out) {
+    std::fclose(in);
+    throw std::ios_base::failure("[Out Of Core][copyFile] Cannot open " + to);
+  }
+  std::vector<char> buffer(COPY_BUFFER_SIZE);
+  bool ok = true;
+  for(size_t read; ok && (read = std::fread(buffer.data(), 1, buffer.size(), in)) > 0; )
+    ok = std::fwrite(buffer.data(), 1, read, out) == read;
+  ok = !std::ferror(in) && ok;
+  std::fclose(in);
+  if(std::fclose(out) != 0 || !ok)
+    throw std::ios_base::failure("[Out Of Core][copyFile] Cannot write " + to);
+}
+
+// Calls f(thread, begin, end) on one contiguous chunk of [begin, end) per thread
+template<typename Function>
+void parallelChunks(unsigned int begin, unsigned int end, unsigned int threadCount, Function f)
+{
+  const unsigned int count = end > begin ? end - begin : 0;
+  const unsigned int chunk = (count + threadCount - 1)/std::max(1u, threadCount);
+  std::vector<std::thread> threads;
+  for(unsigned int t = 0; t < threadCount; ++t) {
+    const unsigned int chunkBegin = begin + std::min(count, t*chunk);
+    const unsigned int chunkEnd = begin + std::min(count, (t + 1)*chunk);
+    threads.push_back(std::thread(f, t, chunkBegin, chunkEnd));
+  }
+  for(auto &thread : threads) thread.join();
+}
+
+// Noise of Mesh::addNoise on an axis of vertex i
+float vertexNoise(unsigned int seed, unsigned int i, unsigned int axis)
+{
+  uint64_t x = ((static_cast<uint64_t>(seed) << 32) | i)*3 + axis;
+  x += 0x9e3779b97f4a7c15ull;  // splitmix64
+  x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27))*0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return (static_cast<int>(x % 100) - 50)*0.0001f;
+}
+
+// Distance from a tile beyond which no vertex changes the result of the vertices it owns. An
+// iteration moves a vertex by at most the radius: the offset is a weighted mean of heights over
+// neighbors within the radius, along a normal no longer than 1. So two vertices within the radius
+// at iteration j were within (2j + 1)*radius at the start. Iteration j reads those neighbors and
+// the one-ring (for the normal), and the final normals read the one-ring once more.
+float haloWidth(int iterations, float radius, float maxEdge)
+{
+  float halo = maxEdge;
+  for(int j = 0; j < iterations; ++j) halo += std::max((2*j + 1)*radius, maxEdge);
+  return halo*1.0001f;  // rounding of the float sums
+}
+
+struct MeshStatistics {
+  glm::vec3 boxMin = glm::vec3(FLT_MAX);
+  glm::vec3 boxMax = glm::vec3(-FLT_MAX);
+  float maxEdge = 0.f;
+  double longestEdgeSum = 0.0;
+};
+
+// Regular grid of cubic tiles over the bounding box of the mesh
+struct TileGrid {
+  glm::vec3 origin;
+  float tileSize;
+  glm::ivec3 dims;
+
+  TileGrid(const glm::vec3 &boxMin, const glm::vec3 &boxMax, float size) : origin(boxMin), tileSize(size)
+  {
+    const glm::vec3 extent = boxMax - boxMin;
+    for(int a = 0; a < 3; ++a) dims[a] = std::max(1, static_cast<int>(std::ceil(extent[a]/tileSize)));
+  }
+
+  size_t tileCount() const { return static_cast<size_t>(dims.x)*dims.y*dims.z; }
+  glm::ivec3 cell(const glm::vec3 &p) const
+  {
+    glm::ivec3 c;
+    for(int a = 0; a < 3; ++a)
+      c[a] = std::min(dims[a] - 1, std::max(0, static_cast<int>(std::floor((p[a] - origin[a])/tileSize))));
+    return c;
+  }
+  unsigned int index(const glm::ivec3 &c) const { return (c.z*dims.y + c.y)*dims.x + c.x; }
+  unsigned int tileOf(const glm::vec3 &p) const { return index(cell(p)); }
+};
+
+// Working arrays of a thread, kept from one tile to the next
+struct TileScratch {
+  std::vector<unsigned int> ids;        // global ids of the local vertices, sorted
+  std::vector<glm::vec3> positions, nextPositions, normals;
+  std::vector<float> areas;
+  std::vector<glm::uvec3> triangles;    // local indices
+  std::vector<unsigned int> cellOf, cellStart, cellCursor, cellEntries, candidates;
+};
+
+class TileFilter {
+public:
+  TileFilter(const glm::vec3 *positions, const glm::uvec3 *triangles, unsigned int vertexCount,
+             unsigned int triangleCount, const OutOfCoreOptions &options) :
+    _positions(positions), _triangles(triangles), _vertexCount(vertexCount), _triangleCount(triangleCount),
+    _options(options),
+    _threadCount(options.threadCount ? options.threadCount : parallelThreadCount()) {}
+
+  // Mapped files to drop from the resident set when it grows past the budget
+  void addMapping(const MappedFile *file) { _inputs.push_back(file); }
+  void addMapping(WritableMappedFile *file) { _outputs.push_back(file); }
+
+  MeshStatistics measure();
+
+  // Applies iterations of the filter and writes the positions (unless outPositions is null, then
+  // iterations must be 0) and the normalized normals of every vertex
+  void run(int iterations, float sigma_c, const MeshStatistics &statistics, glm::vec3 *outPositions,
+           glm::vec3 *outNormals, const std::string &tilesFilename);
+
+private:
+  void evictIfOverBudget();
+  void buildTiles(const TileGrid &grid, unsigned int *vertexBuckets, unsigned int *triangleBuckets);
+  std::vector<unsigned int> countTiles(const TileGrid &grid);
+  size_t largestTile(const TileGrid &grid, const std::vector<unsigned int> &counts, float halo) const;
+  void filterTile(unsigned int tile, const TileGrid &grid, float halo, int iterations, float sigma_c,
+                  glm::vec3 *outPositions, glm::vec3 *outNormals, TileScratch &scratch);
+  void computeNormals(TileScratch &scratch) const;
+
+  const glm::vec3 *_positions;
+  const glm::uvec3 *_triangles;
+  unsigned int _vertexCount, _triangleCount;
+  OutOfCoreOptions _options;
+  unsigned int _threadCount;
+  std::vector<const MappedFile*> _inputs;
+  std::vector<WritableMappedFile*> _outputs;
+  std::mutex _evictMutex;
+
+  // buckets of the tiles, in the mapped tiles file
+  const unsigned int *_vertexBuckets = nullptr, *_triangleBuckets = nullptr;
+  std::vector<size_t> _vertexStart, _triangleStart;
+};
+
+void TileFilter::evictIfOverBudget()
+{
+  if(residentBytes() <= _options.memoryBudget) return;
+  std::unique_lock<std::mutex> lock(_evictMutex, std::try_to_lock);
+  if(!lock.owns_lock()) return;  // another thread is evicting
+  for(auto file : _inputs) file->evict();
+  for(auto file : _outputs) file->evict();
+}
+
+MeshStatistics TileFilter::measure()
+{
+  std::vector<MeshStatistics> partial(_threadCount);
+  for(unsigned int block = 0; block < _vertexCount; block += std::min(STREAMING_BLOCK, _vertexCount - block)) {
+    parallelChunks(block, block + std::min(STREAMING_BLOCK, _vertexCount - block), _threadCount,
+                   [&](unsigned int t, unsigned int begin, unsigned int end) {
+      for(unsigned int i = begin; i < end; ++i) {
+        partial[t].boxMin = glm::min(partial[t].boxMin, _positions[i]);
+        partial[t].boxMax = glm::max(partial[t].boxMax, _positions[i]);
+      }
+    });
+    evictIfOverBudget();
+  }
+  for(unsigned int block = 0; block < _triangleCount; block += std::min(STREAMING_BLOCK, _triangleCount - block)) {
+    parallelChunks(block, block + std::min(STREAMING_BLOCK, _triangleCount - block), _threadCount,
+                   [&](unsigned int t, unsigned int begin, unsigned int end) {
+      for(unsigned int i = begin; i < end; ++i) {
+        const glm::uvec3 &T = _triangles[i];
+        const float longest = std::max(glm::distance(_positions[T[0]], _positions[T[1]]),
+                                       std::max(glm::distance(_positions[T[1]], _positions[T[2]]),
+                                                glm::distance(_positions[T[2]], _positions[T[0]])));
+        partial[t].maxEdge = std::max(partial[t].maxEdge, longest);
+        partial[t].longestEdgeSum += longest;
+      }
+    });
+    evictIfOverBudget();
+  }
+  MeshStatistics statistics;
+  for(const auto &p : partial) {
+    statistics.boxMin = glm::min(statistics.boxMin, p.boxMin);
+    statistics.boxMax = glm::max(statistics.boxMax, p.boxMax);
+    statistics.maxEdge = std::max(statistics.maxEdge, p.maxEdge);
+    statistics.longestEdgeSum += p.longestEdgeSum;
+  }
+  return statistics;
+}
+
+std::vector<unsigned int> TileFilter::countTiles(const TileGrid &grid)
+{
+  std::vector<std::vector<unsigned int>> partial(_threadCount, std::vector<unsigned int>(grid.tileCount(), 0));
+  for(unsigned int block = 0; block < _vertexCount; block += std::min(STREAMING_BLOCK, _vertexCount - block)) {
+    parallelChunks(block, block + std::min(STREAMING_BLOCK, _vertexCount - block), _threadCount,
+                   [&](unsigned int t, unsigned int begin, unsigned int end) {
+      for(unsigned int i = begin; i < end; ++i) ++partial[t][grid.tileOf(_positions[i])];
+    });
+    evictIfOverBudget();
+  }
+  for(unsigned int t = 1; t < _threadCount; ++t)
+    for(size_t tile = 0; tile < grid.tileCount(); ++tile) partial[0][tile] += partial[t][tile];
+  return partial[0];
+}
+
+// Upper bound of the local vertices of the tiles: the vertices of every tile the halo overlaps,
+// summed with a 3D prefix sum
+size_t TileFilter::largestTile(const TileGrid &grid, const std::vector<unsigned int> &counts, float halo) const
+{
+  const int X = grid.dims.x, Y = grid.dims.y, Z = grid.dims.z;
+  auto at = [=](int x, int y, int z) { return (static_cast<size_t>(z)*(Y + 1) + y)*(X + 1) + x; };
+  std::vector<uint64_t> sums(static_cast<size_t>(X + 1)*(Y + 1)*(Z + 1), 0);
+  for(int z = 0; z < Z; ++z)
+    for(int y = 0; y < Y; ++y)
+      for(int x = 0; x < X; ++x)
+        sums[at(x + 1, y + 1, z + 1)] = counts[grid.index(glm::ivec3(x, y, z))]
+          + sums[at(x, y + 1, z + 1)] + sums[at(x + 1, y, z + 1)] + sums[at(x + 1, y + 1, z)]
+          - sums[at(x, y, z + 1)] - sums[at(x, y + 1, z)] - sums[at(x + 1, y, z)] + sums[at(x, y, z)];
+  const int reach = static_cast<int>(std::ceil(halo/grid.tileSize));
+  uint64_t largest = 0;
+  for(int z = 0; z < Z; ++z)
+    for(int y = 0; y < Y; ++y)
+      for(int x = 0; x < X; ++x) {
+        const int x0 = std::max(0, x - reach), y0 = std::max(0, y - reach), z0 = std::max(0, z - reach);
+        const int x1 = std::min(X, x + reach + 1), y1 = std::min(Y, y + reach + 1), z1 = std::min(Z, z + reach + 1);
+        const uint64_t local = sums[at(x1, y1, z1)] - sums[at(x0, y1, z1)] - sums[at(x1, y0, z1)] - sums[at(x1, y1, z0)]
+          + sums[at(x0, y0, z1)] + sums[at(x0, y1, z0)] + sums[at(x1, y0, z0)] - sums[at(x0, y0, z0)];
+        largest = std::max(largest, local);
+      }
+  return static_cast<size_t>(largest);
+}
+
+// Counting sort of the vertices by tile, and of the triangles by the tile of their first vertex
+void TileFilter::buildTiles(const TileGrid &grid, unsigned int *vertexBuckets, unsigned int *triangleBuckets)
+{
+  const size_t tileCount = grid.tileCount();
+  std::unique_ptr<std::atomic<unsigned int>[]> cursors(new std::atomic<unsigned int>[tileCount]);
+  auto bucket = [&](unsigned int count, std::vector<size_t> &start, unsigned int *buckets,
+                    std::function<unsigned int(unsigned int)> tileOf) {
+    for(size_t tile = 0; tile < tileCount; ++tile) cursors[tile] = 0;
+    for(unsigned int block = 0; block < count; block += std::min(STREAMING_BLOCK, count - block)) {
+      parallelChunks(block, block + std::min(STREAMING_BLOCK, count - block), _threadCount,
+                     [&](unsigned int, unsigned int begin, unsigned int end) {
+        for(unsigned int i = begin; i < end; ++i) cursors[tileOf(i)].fetch_add(1, std::memory_order_relaxed);
+      });
+      evictIfOverBudget();
+    }
+    start.assign(tileCount + 1, 0);
+    for(size_t tile = 0; tile < tileCount; ++tile) {
+      start[tile + 1] = start[tile] + cursors[tile];
+      cursors[tile] = 0;
+    }
+    for(unsigned int block = 0; block < count; block += std::min(STREAMING_BLOCK, count - block)) {
+      parallelChunks(block, block + std::min(STREAMING_BLOCK, count - block), _threadCount,
+                     [&](unsigned int, unsigned int begin, unsigned int end) {
+        for(unsigned int i = begin; i < end; ++i) {
+          const unsigned int tile = tileOf(i);
+          buckets[start[tile] + cursors[tile].fetch_add(1, std::memory_order_relaxed)] = i;
+        }
+      });
+      evictIfOverBudget();
+    }
+  };
+  bucket(_vertexCount, _vertexStart, vertexBuckets,
+         [&](unsigned int i) { return grid.tileOf(_positions[i]); });
+  bucket(_triangleCount, _triangleStart, triangleBuckets,
+         [&](unsigned int i) { return grid.tileOf(_positions[_triangles[i][0]]); });
+  _vertexBuckets = vertexBuckets;
+  _triangleBuckets = triangleBuckets;
+}
+
+// Area weighted normals of the local vertices, as Mesh::calculateVertexWeightedNormals
+void TileFilter::computeNormals(TileScratch &scratch) const
+{
+  scratch.normals.assign(scratch.positions.size(), glm::vec3(0.f));
+  scratch.areas.assign(scratch.positions.size(), 0.f);
+  for(const glm::uvec3 &T : scratch.triangles) {
+    const glm::vec3 &a = scratch.positions[T[0]];
+    const glm::vec3 doubleAreaNormal = glm::cross(scratch.positions[T[1]] - a, scratch.positions[T[2]] - a);
+    const float area = 0.5f*glm::length(doubleAreaNormal);
+    if(area <= 0.f) continue;
+    for(int c = 0; c < 3; ++c) {
+      scratch.normals[T[c]] += 0.5f*doubleAreaNormal;  // unit normal times area
+      scratch.areas[T[c]] += area;
+    }
+  }
+  for(size_t i = 0; i < scratch.normals.size(); ++i)
+    if(scratch.areas[i] > 0.f) scratch.normals[i] /= scratch.areas[i];
+}
+
+void TileFilter::filterTile(unsigned int tile, const TileGrid &grid, float halo, int iterations, float sigma_c,
+                            glm::vec3 *outPositions, glm::vec3 *outNormals, TileScratch &scratch)
+{
+  const size_t ownedBegin = _vertexStart[tile], ownedEnd = _vertexStart[tile + 1];
+  if(ownedBegin == ownedEnd) return;
+  const glm::ivec3 c(tile % grid.dims.x, (tile/grid.dims.x) % grid.dims.y, tile/(grid.dims.x*grid.dims.y));
+  const glm::vec3 boxMin = grid.origin + glm::vec3(c)*grid.tileSize - glm::vec3(halo);
+  const glm::vec3 boxMax = grid.origin + glm::vec3(c + 1)*grid.tileSize + glm::vec3(halo);
+  const glm::ivec3 first = grid.cell(boxMin), last = grid.cell(boxMax);
+
+  // local vertices: the vertices of the overlapped tiles inside the box, sorted by global id
+  scratch.ids.clear();
+  for(int z = first.z; z <= last.z; ++z)
+    for(int y = first.y; y <= last.y; ++y)
+      for(int x = first.x; x <= last.x; ++x) {
+        const unsigned int other = grid.index(glm::ivec3(x, y, z));
+        for(size_t k = _vertexStart[other]; k < _vertexStart[other + 1]; ++k) {
+          const glm::vec3 &p = _positions[_vertexBuckets[k]];
+          if(glm::all(glm::greaterThanEqual(p, boxMin)) && glm::all(glm::lessThanEqual(p, boxMax)))
+            scratch.ids.push_back(_vertexBuckets[k]);
+        }
+      }
+  std::sort(scratch.ids.begin(), scratch.ids.end());
+  auto localIndex = [&](unsigned int id) {
+    auto it = std::lower_bound(scratch.ids.begin(), scratch.ids.end(), id);
+    return it != scratch.ids.end() && *it == id ? static_cast<unsigned int>(it - scratch.ids.begin()) : UINT32_MAX;
+  };
+
+  // local triangles: those with their three vertices local, all in the overlapped tiles
+  scratch.triangles.clear();
+  for(int z = first.z; z <= last.z; ++z)
+    for(int y = first.y; y <= last.y; ++y)
+      for(int x = first.x; x <= last.x; ++x) {
+        const unsigned int other = grid.index(glm::ivec3(x, y, z));
+        for(size_t k = _triangleStart[other]; k < _triangleStart[other + 1]; ++k) {
+          const glm::uvec3 &T = _triangles[_triangleBuckets[k]];
+          const glm::uvec3 local(localIndex(T[0]), localIndex(T[1]), localIndex(T[2]));
+          if(local[0] != UINT32_MAX && local[1] != UINT32_MAX && local[2] != UINT32_MAX)
+            scratch.triangles.push_back(local);
+        }
+      }
+
+  const size_t n = scratch.ids.size();
+  scratch.positions.resize(n);
+  for(size_t i = 0; i < n; ++i) scratch.positions[i] = _positions[scratch.ids[i]];
+
+  const float radius = 2.f*sigma_c;
+  for(int iteration = 0; iteration < iterations && radius > 0.f; ++iteration) {
+    computeNormals(scratch);
+
+    // neighbors within radius through a hash grid of cells of that size
+    size_t tableSize = 1;
+    while(tableSize < 2*n) tableSize <<= 1;
+    auto cellKey = [&](int x, int y, int z) {
+      return static_cast<unsigned int>((static_cast<unsigned int>(x)*73856093u ^ static_cast<unsigned int>(y)*19349663u ^
+                                        static_cast<unsigned int>(z)*83492791u) & (tableSize - 1));
+    };
+    auto cellCoordinates = [&](const glm::vec3 &p) { return glm::ivec3(glm::floor((p - boxMin)/radius)); };
+    scratch.cellOf.resize(n);
+    scratch.cellStart.assign(tableSize + 1, 0);
+    for(size_t i = 0; i < n; ++i) {
+      const glm::ivec3 cell = cellCoordinates(scratch.positions[i]);
+      scratch.cellOf[i] = cellKey(cell.x, cell.y, cell.z);
+      ++scratch.cellStart[scratch.cellOf[i] + 1];
+    }
+    for(size_t k = 0; k < tableSize; ++k) scratch.cellStart[k + 1] += scratch.cellStart[k];
+    scratch.cellEntries.resize(n);
+    scratch.cellCursor.assign(scratch.cellStart.begin(), scratch.cellStart.end() - 1);
+    for(size_t i = 0; i < n; ++i) scratch.cellEntries[scratch.cellCursor[scratch.cellOf[i]]++] = static_cast<unsigned int>(i);
+
+    scratch.nextPositions = scratch.positions;
+    unsigned int keys[27];
+    for(size_t i = 0; i < n; ++i) {
+      const glm::vec3 &point = scratch.positions[i];
+      const glm::ivec3 cell = cellCoordinates(point);
+      unsigned int keyCount = 0;
+      for(int z = -1; z <= 1; ++z)
+        for(int y = -1; y <= 1; ++y)
+          for(int x = -1; x <= 1; ++x) keys[keyCount++] = cellKey(cell.x + x, cell.y + y, cell.z + z);
+      std::sort(keys, keys + keyCount);
+      keyCount = static_cast<unsigned int>(std::unique(keys, keys + keyCount) - keys);  // colliding cells
+      scratch.candidates.clear();
+      for(unsigned int k = 0; k < keyCount; ++k)
+        for(unsigned int e = scratch.cellStart[keys[k]]; e < scratch.cellStart[keys[k] + 1]; ++e)
+          if(scratch.cellEntries[e] != i) scratch.candidates.push_back(scratch.cellEntries[e]);
+      const glm::vec3 &normal = scratch.normals[i];
+      float offset = 0.f;
+      if(Mesh::bilateralOffset(point, normal, scratch.positions, scratch.candidates.data(), scratch.candidates.size(),
+                               sigma_c, _options.sigma_s, radius, offset)) {
+        const glm::vec3 moved = point + normal*offset;
+        if(!std::isnan(moved.x)) scratch.nextPositions[i] = moved;
+      }
+    }
+    std::swap(scratch.positions, scratch.nextPositions);
+  }
+  computeNormals(scratch);
+
+  for(size_t k = ownedBegin; k < ownedEnd; ++k) {
+    const unsigned int id = _vertexBuckets[k];
+    const unsigned int i = localIndex(id);
+    if(outPositions) outPositions[id] = scratch.positions[i];
+    const float length = glm::length(scratch.normals[i]);
+    outNormals[id] = length > 0.f ? scratch.normals[i]/length : glm::vec3(0.f, 0.f, 1.f);
+  }
+}
+
+void TileFilter::run(int iterations, float sigma_c, const MeshStatistics &statistics, glm::vec3 *outPositions,
+                     glm::vec3 *outNormals, const std::string &tilesFilename)
+{
+  const float halo = haloWidth(iterations, 2.f*sigma_c, statistics.maxEdge);
+  const size_t localVertexLimit = std::max<size_t>(1, _options.memoryBudget/2/_threadCount/BYTES_PER_LOCAL_VERTEX);
+  const glm::vec3 extent = statistics.boxMax - statistics.boxMin;
+  const float largestExtent = std::max(extent.x, std::max(extent.y, extent.z));
+
+  // halve the tiles until the largest one fits, or its halo dominates it
+  TileGrid grid(statistics.boxMin, statistics.boxMax, largestExtent > 0.f ? largestExtent : 1.f);
+  std::vector<unsigned int> counts = countTiles(grid);
+  size_t largest = largestTile(grid, counts, halo);
+  while(largest > localVertexLimit && grid.tileSize > halo) {
+    TileGrid finer(statistics.boxMin, statistics.boxMax, 0.5f*grid.tileSize);
+    if(finer.tileCount() > MAX_TILE_COUNT) break;
+    grid = finer;
+    counts = countTiles(grid);
+    largest = largestTile(grid, counts, halo);
+  }
+  std::cout << " > " << grid.dims.x << "x" << grid.dims.y << "x" << grid.dims.z << " tiles, halo " << halo
+            << ", up to " << largest << " local vertices per tile" << std::endl;
+  if(largest > localVertexLimit)
+    std::cerr << " > [Warning] The tiles exceed the memory budget by " << (largest - localVertexLimit)*BYTES_PER_LOCAL_VERTEX*_threadCount
+              << " bytes" << std::endl;
+  counts.clear();
+  counts.shrink_to_fit();
+
+  WritableMappedFile::createFile(tilesFilename, (static_cast<size_t>(_vertexCount) + _triangleCount)*sizeof(unsigned int));
+  {
+    WritableMappedFile tilesFile(tilesFilename);
+    _outputs.push_back(&tilesFile);
+    unsigned int *buckets = reinterpret_cast<unsigned int*>(tilesFile.begin());
+    buildTiles(grid, buckets, buckets + _vertexCount);
+
+    // dynamic scheduling, the tiles hold very different numbers of vertices
+    std::atomic<unsigned int> nextTile(0);
+    const unsigned int tileCount = static_cast<unsigned int>(grid.tileCount());
+    std::vector<std::thread> threads;
+    for(unsigned int t = 0; t < _threadCount; ++t)
+      threads.push_back(std::thread([&]() {
+        TileScratch scratch;
+        for(unsigned int tile; (tile = nextTile++) < tileCount; ) {
+          filterTile(tile, grid, halo, iterations, sigma_c, outPositions, outNormals, scratch);
+          evictIfOverBudget();
+        }
+      }));
+    for(auto &thread : threads) thread.join();
+    _outputs.pop_back();
+  }
+  std::remove(tilesFilename.c_str());
+}
+
+MeshBinaryLayout mapLayout(const char *data, size_t size, const std::string &filename, const char *caller)
+{
+  MeshBinaryLayout layout;
+  if(!readMeshBinaryLayout(data, size, layout))
+    throw std::ios_base::failure(std::string("[Out Of Core][") + caller + "] Not a binary mesh or unsupported version: " + filename);
+  return layout;
+}
+
+} // namespace
+
+void addNoiseOutOfCore(const std::string &input, const std::string &output, const OutOfCoreOptions &options, unsigned int seed)
+{
+  const auto start = std::chrono::steady_clock::now();
+  if(input != output) copyFile(input, output);
+  WritableMappedFile file(output);
+  const MeshBinaryLayout layout = mapLayout(file.begin(), file.size(), output, "addNoiseOutOfCore");
+  glm::vec3 *positions = reinterpret_cast<glm::vec3*>(file.begin() + layout.positionsOffset);
+  glm::vec3 *normals = reinterpret_cast<glm::vec3*>(file.begin() + layout.normalsOffset);
+  const glm::uvec3 *triangles = reinterpret_cast<const glm::uvec3*>(file.begin() + layout.indicesOffset);
+
+  TileFilter filter(positions, triangles, layout.vertexCount, layout.triangleCount, options);
+  filter.addMapping(&file);
+  const unsigned int V = layout.vertexCount;
+  for(unsigned int block = 0; block < V; block += std::min(STREAMING_BLOCK, V - block)) {
+    parallelFor(block, block + std::min(STREAMING_BLOCK, V - block), [&](unsigned int i) {
+      for(unsigned int axis = 0; axis < 3; ++axis) positions[i][axis] += vertexNoise(seed, i, axis);
+    });
+    if(residentBytes() > options.memoryBudget) file.evict();
+  }
+  // the positions are only read from now on, the tiles only write the normals
+  const MeshStatistics statistics = filter.measure();
+  filter.run(0, 0.f, statistics, nullptr, normals, output + ".tiles");
+  std::cout << " > Noise added out of core to " << V << " vertices in "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << std::endl;
+}
+
+void bilateralFilteringOutOfCore(const std::string &input, const std::string &output, const OutOfCoreOptions &options)
+{
+  const auto start = std::chrono::steady_clock::now();
+  if(input == output)
+    throw std::ios_base::failure("[Out Of Core][bilateralFilteringOutOfCore] The output must differ from the input: " + input);
+  copyFile(input, output);
+  const MappedFile in(input);
+  WritableMappedFile out(output);
+  const MeshBinaryLayout layout = mapLayout(in.begin(), in.size(), input, "bilateralFilteringOutOfCore");
+  const glm::vec3 *positions = reinterpret_cast<const glm::vec3*>(in.begin() + layout.positionsOffset);
+  const glm::uvec3 *triangles = reinterpret_cast<const glm::uvec3*>(in.begin() + layout.indicesOffset);
+
+  TileFilter filter(positions, triangles, layout.vertexCount, layout.triangleCount, options);
+  filter.addMapping(&in);
+  filter.addMapping(&out);
+  const MeshStatistics statistics = filter.measure();
+  float sigma_c = options.sigma_c;
+  if(sigma_c <= 0.f && layout.triangleCount > 0)
+    sigma_c = static_cast<float>(statistics.longestEdgeSum/layout.triangleCount);
+  std::cout << "Value of sigma_s: " << options.sigma_s << std::endl;
+  std::cout << "Value of sigma_c: " << sigma_c << std::endl;
+  filter.run(options.iterations, sigma_c, statistics, reinterpret_cast<glm::vec3*>(out.begin() + layout.positionsOffset),
+             reinterpret_cast<glm::vec3*>(out.begin() + layout.normalsOffset), output + ".tiles");
+  std::cout << " > Bilateral filtering applied out of core to " << layout.vertexCount << " vertices in "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << std::endl;
+}
@@ -0,0 +1,38 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+#include <cstddef>
+#include <string>
+
+// Noise and bilateral denoising of binary meshes (.mbin, see MeshIO.h) too large to be loaded;
+// convertToMeshBinary makes one from an OFF or PLY mesh without loading it either.
+// The output starts as a copy of the input and both files are memory mapped. The vertices and
+// triangles are bucketed into a grid of spatial tiles (the buckets are kept in a temporary
+// <output>.tiles file). Every tile is filtered on its own together with a halo of the vertices
+// around it, derived from the filter radius and the iterations so that the vertices the tile owns
+// see the same neighbors as on the whole mesh, and only the owned vertices are written back, so
+// the tiles stitch without seams. The results match the untiled filter up to the rounding of sums
+// taken in another order.
+// The tiles are processed in parallel; their size is chosen so that the working sets of the
+// threads fit in half of the memory budget, and the mapped pages are dropped from the resident set
+// whenever it grows past the budget.
+struct OutOfCoreOptions {
+  size_t memoryBudget = size_t(1) << 30;  // bytes of resident memory
+  unsigned int threadCount = 0;           // 0: one per hardware thread
+  float sigma_s = 0.001f;
+  float sigma_c = 0.f;                    // 0: mean length of the longest edge of the triangles
+  int iterations = 5;
+};
+
+// Mesh::addNoise out of core. The noise of a vertex is drawn from its index and the seed, so it
+// does not depend on the tiling or on the threads. The normals are recomputed.
+void addNoiseOutOfCore(const std::string &input, const std::string &output,
+                       const OutOfCoreOptions &options = OutOfCoreOptions(), unsigned int seed = 0);
+
+// Mesh::bilateralFiltering out of core, with the neighbors within 2*sigma_c. Unlike the in-core
+// filter, which moves the vertices one after the other, all the vertices of an iteration move
+// from the same positions. The normals are recomputed; texture coordinates are kept.
+void bilateralFilteringOutOfCore(const std::string &input, const std::string &output,
+                                 const OutOfCoreOptions &options = OutOfCoreOptions());
+
+#endif  // OUT_OF_CORE_H
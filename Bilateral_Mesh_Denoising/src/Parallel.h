@@ -0,0 +1,61 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// Number of worker threads used by the parallel loops
+inline unsigned int parallelThreadCount()
+{
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls f(i) for every i in [begin, end), splitting the range in one contiguous chunk per thread.
+// f must only write to data owned by index i. A thread is only started for at least grain indices.
+template<typename Function>
+void parallelFor(unsigned int begin, unsigned int end, Function f, unsigned int grain = 1024)
+{
+  const unsigned int count = end > begin ? end - begin : 0;
+  const unsigned int threadCount = std::min(parallelThreadCount(), std::max(1u, count/std::max(1u, grain)));
+  if(threadCount <= 1) {
+    for(unsigned int i = begin; i < end; ++i) f(i);
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(threadCount);
+  const unsigned int chunk = (count + threadCount - 1)/threadCount;
+  for(unsigned int t = 0; t < threadCount; ++t) {
+    const unsigned int chunkBegin = begin + t*chunk;
+    const unsigned int chunkEnd = std::min(end, chunkBegin + chunk);
+    threads.push_back(std::thread([=]() {
+      for(unsigned int i = chunkBegin; i < chunkEnd; ++i) f(i);
+    }));
+  }
+  for(auto &thread : threads) thread.join();
+}
+
+// Sorts [begin, end) with less: one chunk per thread is sorted on its own, then the sorted chunks
+// are merged pairwise, the merges of a round running in parallel.
+template<typename Iterator, typename Less>
+void parallelSort(Iterator begin, Iterator end, Less less, unsigned int grain = 1 << 16)
+{
+  const size_t count = end - begin;
+  const unsigned int chunkCount = std::min<size_t>(parallelThreadCount(), std::max<size_t>(1, count/std::max(1u, grain)));
+  if(chunkCount <= 1) {
+    std::sort(begin, end, less);
+    return;
+  }
+  const size_t chunk = (count + chunkCount - 1)/chunkCount;
+  auto bound = [=](size_t c) { return begin + std::min(count, c*chunk); };
+  parallelFor(0, chunkCount, [&](unsigned int c) { std::sort(bound(c), bound(c + 1), less); }, 1);
+  for(size_t width = 1; width < chunkCount; width *= 2) {
+    const unsigned int mergeCount = static_cast<unsigned int>((chunkCount + 2*width - 1)/(2*width));
+    parallelFor(0, mergeCount, [&](unsigned int m) {
+      const size_t first = 2*width*m;
+      std::inplace_merge(bound(first), bound(first + width), bound(first + 2*width), less);
+    }, 1);
+  }
+}
+
+#endif  // PARALLEL_H
@@ -0,0 +1,198 @@
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// One (row, column, value) entry used to assemble a sparse matrix
+struct Triplet {
+  unsigned int row, col;
+  double value;
+  Triplet(unsigned int r, unsigned int c, double v) : row(r), col(c), value(v) {}
+  bool operator < (Triplet const &o) const { return row < o.row || (row == o.row && col < o.col); }
+};
+
+// Compressed sparse row matrix, enough for the symmetric operators we build on meshes
+class SparseMatrix {
+public:
+  unsigned int rows() const { return _rows; }
+
+  // Build the matrix from a list of triplets, duplicated entries are summed
+  void setFromTriplets(unsigned int n, std::vector<Triplet> &triplets)
+  {
+    std::sort(triplets.begin(), triplets.end());
+    _rows = n;
+    _rowStart.assign(n + 1, 0);
+    _columns.clear();
+    _values.clear();
+    for(unsigned int i = 0; i < triplets.size(); ++i) {
+      const Triplet &t = triplets[i];
+      if(!_columns.empty() && i > 0 && triplets[i-1].row == t.row && triplets[i-1].col == t.col) {
+        _values.back() += t.value;
+        continue;
+      }
+      _columns.push_back(t.col);
+      _values.push_back(t.value);
+      _rowStart[t.row + 1]++;
+    }
+    for(unsigned int r = 0; r < n; ++r)
+      _rowStart[r + 1] += _rowStart[r];
+  }
+
+  // this = a*A + b*B, A and B must have the same size
+  void setLinearCombination(double a, const SparseMatrix &A, double b, const SparseMatrix &B)
+  {
+    std::vector<Triplet> triplets;
+    triplets.reserve(A._values.size() + B._values.size());
+    A.appendTriplets(a, triplets);
+    B.appendTriplets(b, triplets);
+    setFromTriplets(A._rows, triplets);
+  }
+
+  const std::vector<unsigned int> &rowStart() const { return _rowStart; }
+  const std::vector<unsigned int> &columns() const { return _columns; }
+  const std::vector<double> &values() const { return _values; }
+
+private:
+  void appendTriplets(double scale, std::vector<Triplet> &triplets) const
+  {
+    for(unsigned int r = 0; r < _rows; ++r)
+      for(unsigned int k = _rowStart[r]; k < _rowStart[r + 1]; ++k)
+        triplets.push_back(Triplet(r, _columns[k], scale*_values[k]));
+  }
+
+  unsigned int _rows = 0;
+  std::vector<unsigned int> _rowStart;
+  std::vector<unsigned int> _columns;
+  std::vector<double> _values;
+};
+
+// Envelope (profile) LDL^T factorization of a symmetric positive definite matrix.
+// The rows are first renumbered with reverse Cuthill-McKee to keep the envelope narrow,
+// so factorizing once and reusing the factors makes every later solve cheap.
+class SparseCholesky {
+public:
+  bool empty() const { return _diagonal.empty(); }
+
+  bool factorize(const SparseMatrix &A)
+  {
+    const unsigned int n = A.rows();
+    computeReverseCuthillMcKee(A);
+
+    // first non zero column of each (permuted) row
+    _first.assign(n, 0);
+    for(unsigned int r = 0; r < n; ++r) {
+      const unsigned int pr = _permutation[r];
+      unsigned int first = pr;
+      for(unsigned int k = A.rowStart()[r]; k < A.rowStart()[r + 1]; ++k)
+        first = std::min(first, _permutation[A.columns()[k]]);
+      _first[pr] = first;
+    }
+    _rowOffset.assign(n + 1, 0);
+    for(unsigned int i = 0; i < n; ++i)
+      _rowOffset[i + 1] = _rowOffset[i] + (i - _first[i]);
+    _lower.assign(_rowOffset[n], 0.0);
+    _diagonal.assign(n, 0.0);
+
+    // scatter the lower part of A in the envelope
+    for(unsigned int r = 0; r < n; ++r) {
+      const unsigned int i = _permutation[r];
+      for(unsigned int k = A.rowStart()[r]; k < A.rowStart()[r + 1]; ++k) {
+        const unsigned int j = _permutation[A.columns()[k]];
+        if(j == i) _diagonal[i] = A.values()[k];
+        else if(j < i) _lower[_rowOffset[i] + j - _first[i]] = A.values()[k];
+      }
+    }
+
+    // row by row LDL^T, in place
+    for(unsigned int i = 0; i < n; ++i) {
+      double *Li = &_lower[_rowOffset[i]] - _first[i];
+      for(unsigned int j = _first[i]; j < i; ++j) {
+        const double *Lj = &_lower[_rowOffset[j]] - _first[j];
+        double sum = Li[j];
+        for(unsigned int k = std::max(_first[i], _first[j]); k < j; ++k)
+          sum -= Li[k]*_diagonal[k]*Lj[k];
+        Li[j] = sum/_diagonal[j];
+      }
+      double d = _diagonal[i];
+      for(unsigned int k = _first[i]; k < i; ++k)
+        d -= Li[k]*Li[k]*_diagonal[k];
+      if(d <= 0.0) {
+        _diagonal.clear();
+        return false;
+      }
+      _diagonal[i] = d;
+    }
+    return true;
+  }
+
+  void solve(const std::vector<double> &b, std::vector<double> &x) const
+  {
+    const unsigned int n = _diagonal.size();
+    std::vector<double> y(n);
+    for(unsigned int r = 0; r < n; ++r)
+      y[_permutation[r]] = b[r];
+    for(unsigned int i = 0; i < n; ++i) {
+      const double *Li = &_lower[_rowOffset[i]] - _first[i];
+      for(unsigned int k = _first[i]; k < i; ++k)
+        y[i] -= Li[k]*y[k];
+    }
+    for(unsigned int i = 0; i < n; ++i)
+      y[i] /= _diagonal[i];
+    for(unsigned int i = n; i-- > 0;) {
+      const double *Li = &_lower[_rowOffset[i]] - _first[i];
+      for(unsigned int k = _first[i]; k < i; ++k)
+        y[k] -= Li[k]*y[i];
+    }
+    x.resize(n);
+    for(unsigned int r = 0; r < n; ++r)
+      x[r] = y[_permutation[r]];
+  }
+
+private:
+  // _permutation[old index] = new index
+  void computeReverseCuthillMcKee(const SparseMatrix &A)
+  {
+    const unsigned int n = A.rows();
+    std::vector<unsigned int> degree(n), order;
+    order.reserve(n);
+    for(unsigned int r = 0; r < n; ++r)
+      degree[r] = A.rowStart()[r + 1] - A.rowStart()[r];
+    std::vector<bool> visited(n, false);
+    std::vector<unsigned int> byDegree(n);
+    for(unsigned int r = 0; r < n; ++r) byDegree[r] = r;
+    std::stable_sort(byDegree.begin(), byDegree.end(),
+                     [&](unsigned int a, unsigned int b) { return degree[a] < degree[b]; });
+    std::vector<unsigned int> neighbors;
+    for(unsigned int seed : byDegree) {
+      if(visited[seed]) continue;
+      visited[seed] = true;
+      unsigned int head = order.size();
+      order.push_back(seed);
+      while(head < order.size()) {
+        const unsigned int r = order[head++];
+        neighbors.clear();
+        for(unsigned int k = A.rowStart()[r]; k < A.rowStart()[r + 1]; ++k)
+          if(!visited[A.columns()[k]]) {
+            visited[A.columns()[k]] = true;
+            neighbors.push_back(A.columns()[k]);
+          }
+        std::sort(neighbors.begin(), neighbors.end(),
+                  [&](unsigned int a, unsigned int b) { return degree[a] < degree[b]; });
+        order.insert(order.end(), neighbors.begin(), neighbors.end());
+      }
+    }
+    _permutation.resize(n);
+    for(unsigned int k = 0; k < n; ++k)
+      _permutation[order[k]] = n - 1 - k;
+  }
+
+  std::vector<unsigned int> _permutation;
+  std::vector<unsigned int> _first;
+  std::vector<size_t> _rowOffset;
+  std::vector<double> _lower;
+  std::vector<double> _diagonal;
+};
+
+#endif  // SPARSE_MATRIX_H
@@ -0,0 +1,166 @@
+#ifndef TEXT_TOKENIZER_H
+#define TEXT_TOKENIZER_H
+
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <ios>
+
+// Allocation free tokenizer on a text mesh buffer (OFF, OBJ). Keeps track of the line for the
+// error messages, which are prefixed with the name of the loader.
+class TextTokenizer {
+public:
+  TextTokenizer(const char *begin, const char *end, const char *loader, const std::string &filename, unsigned int line = 1)
+    : _cur(begin), _end(end), _line(line), _loader(loader), _filename(filename) {}
+
+  const char *position() const { return _cur; }
+  unsigned int line() const { return _line; }
+
+  // Skip the blanks, the line breaks and the # comments
+  void skipSpaces()
+  {
+    while(_cur < _end) {
+      const char c = *_cur;
+      if(c == '\n') {
+        ++_line;
+        ++_cur;
+      } else if(c == ' ' || c == '\t' || c == '\r') {
+        ++_cur;
+      } else if(c == '#') {
+        while(_cur < _end && *_cur != '\n') ++_cur;
+      } else {
+        break;
+      }
+    }
+  }
+
+  // Line oriented formats (OBJ): skip the blanks of the current line only
+  void skipBlanks()
+  {
+    while(_cur < _end && (*_cur == ' ' || *_cur == '\t' || *_cur == '\r')) ++_cur;
+  }
+
+  // True at the end of the line or of the buffer, or at a comment
+  bool atLineEnd()
+  {
+    skipBlanks();
+    return _cur == _end || *_cur == '\n' || *_cur == '#';
+  }
+
+  bool readChar(char c)
+  {
+    if(_cur == _end || *_cur != c) return false;
+    ++_cur;
+    return true;
+  }
+
+  // Signed integer, ended by a blank, a line break or a '/'
+  int64_t readInt(const char *what)
+  {
+    skipBlanks();
+    bool negative = false;
+    if(_cur < _end && (*_cur == '-' || *_cur == '+')) negative = (*_cur++ == '-');
+    const char *start = _cur;
+    int64_t value = 0;
+    while(_cur < _end && *_cur >= '0' && *_cur <= '9' && value <= 0xFFFFFFFFll)
+      value = 10*value + (*_cur++ - '0');
+    if(_cur == start || value > 0xFFFFFFFFll || (_cur < _end && !isSpace(*_cur) && *_cur != '/'))
+      fail(what);
+    return negative ? -value : value;
+  }
+
+  bool readKeyword(const char *keyword)
+  {
+    skipSpaces();
+    const char *p = _cur;
+    for(; *keyword; ++keyword, ++p)
+      if(p == _end || *p != *keyword) return false;
+    if(p < _end && !isSpace(*p)) return false;
+    _cur = p;
+    return true;
+  }
+
+  unsigned int readUnsigned(const char *what)
+  {
+    skipSpaces();
+    const char *start = _cur;
+    uint64_t value = 0;
+    while(_cur < _end && *_cur >= '0' && *_cur <= '9' && value <= 0xFFFFFFFFull)
+      value = 10*value + (*_cur++ - '0');
+    if(_cur == start || value > 0xFFFFFFFFull || (_cur < _end && !isSpace(*_cur)))
+      fail(what);
+    return static_cast<unsigned int>(value);
+  }
+
+  float readFloat(const char *what)
+  {
+    skipSpaces();
+    const char *start = _cur;
+    bool negative = false;
+    if(_cur < _end && (*_cur == '-' || *_cur == '+')) negative = (*_cur++ == '-');
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool anyDigit = false;
+    for(; _cur < _end && *_cur >= '0' && *_cur <= '9'; ++_cur, anyDigit = true) {
+      if(digits < 19) { mantissa = 10*mantissa + (*_cur - '0'); if(mantissa) ++digits; }
+      else ++exponent;
+    }
+    if(_cur < _end && *_cur == '.') {
+      for(++_cur; _cur < _end && *_cur >= '0' && *_cur <= '9'; ++_cur, anyDigit = true) {
+        if(digits < 19) { mantissa = 10*mantissa + (*_cur - '0'); if(mantissa) ++digits; --exponent; }
+      }
+    }
+    if(anyDigit && _cur < _end && (*_cur == 'e' || *_cur == 'E')) {
+      ++_cur;
+      bool negativeExponent = false;
+      if(_cur < _end && (*_cur == '-' || *_cur == '+')) negativeExponent = (*_cur++ == '-');
+      int e = 0;
+      const char *exponentStart = _cur;
+      while(_cur < _end && *_cur >= '0' && *_cur <= '9' && e < 100000) e = 10*e + (*_cur++ - '0');
+      if(_cur == exponentStart) fail(what);
+      exponent += negativeExponent ? -e : e;
+    }
+    if(anyDigit && (_cur == _end || isSpace(*_cur))) {
+      // exact when the mantissa and the power of ten are both representable (Clinger's fast path)
+      static const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+      if(mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        double value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value/powersOfTen[-exponent] : value*powersOfTen[exponent];
+        return static_cast<float>(negative ? -value : value);
+      }
+    }
+    // slow path (long mantissas, huge exponents, inf, nan): strtof on a terminated copy of the token
+    _cur = start;
+    while(_cur < _end && !isSpace(*_cur)) ++_cur;
+    char token[128];
+    const size_t length = std::min<size_t>(_cur - start, sizeof(token) - 1);
+    std::memcpy(token, start, length);
+    token[length] = '\0';
+    char *parsedEnd = nullptr;
+    const float value = std::strtof(token, &parsedEnd);
+    if(length == 0 || parsedEnd != token + length)
+      fail(what);
+    return value;
+  }
+
+  void fail(const std::string &what) const
+  {
+    throw std::ios_base::failure(
+      "[Mesh Loader][" + std::string(_loader) + "] " + _filename + ":" + std::to_string(_line) + ": expected " + what);
+  }
+
+private:
+  static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#'; }
+
+  const char *_cur;
+  const char *_end;
+  unsigned int _line;
+  const char *_loader;
+  const std::string &_filename;
+};
+
+#endif  // TEXT_TOKENIZER_H
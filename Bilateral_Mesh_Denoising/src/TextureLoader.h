@@ -0,0 +1,58 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Normal maps are stored with their x and y only; shaders rebuild z = sqrt(1 - x^2 - y^2)
+enum class TextureKind { Color, NormalMap };
+
+struct TextureFile {
+  std::string filename;
+  TextureKind kind;
+};
+
+// Image and its whole mip pyramid (level 0 first, down to 1x1) in one buffer, either as 8 bit
+// texels or as 4x4 compressed blocks. A chain read from the cache points into the mapped cache
+// file instead of owning a copy.
+struct MipChain {
+  int width = 0;
+  int height = 0;
+  int components = 0;                 // of the decoded image: 1 grey, 2 grey+alpha, 3 RGB, 4 RGBA
+  GLenum format = 0;                  // GL_RED, GL_RG, GL_RGB, GL_RGBA or a compressed format
+  bool compressed = false;
+  std::vector<size_t> levelOffsets;   // start of every level in data, plus the total size
+  std::vector<unsigned char> data;
+  const unsigned char *mapped = nullptr;  // levels in the mapped cache file, used instead of data
+  std::shared_ptr<const void> mapping;    // keeps the mapping alive
+  bool fromCache = false;
+
+  int levelCount() const { return levelOffsets.empty() ? 0 : static_cast<int>(levelOffsets.size()) - 1; }
+  int levelWidth(int level) const { return std::max(1, width >> level); }
+  int levelHeight(int level) const { return std::max(1, height >> level); }
+  size_t levelSize(int level) const;
+  const unsigned char *levelData(int level) const { return (mapped ? mapped : data.data()) + levelOffsets[level]; }
+};
+
+// Decodes the images in parallel, one task per image, and builds their mip chains on the CPU with
+// a 2x2 box filter. Every level is then block compressed: normal maps to BC5, color images to BC1
+// (BC3 when they have transparent texels, BC4 when grey), but RGB and RGBA images stay
+// uncompressed when the GL has no S3TC support (s3tc false). Each chain is cached as uploaded next
+// to its image (<file>.mips, levels aligned on 64 bytes after a fixed header) and mapped as is on
+// the next runs while the size and modification time of the image
+// are unchanged, skipping decoding, filtering and encoding. Throws std::ios_base::failure when an
+// image cannot be decoded.
+std::vector<MipChain> loadMipChains(const std::vector<TextureFile> &files, bool s3tc);
+
+// Creates a trilinear filtered, repeating texture holding every level of the chain
+GLuint uploadMipChain(const MipChain &chain);
+
+// Loads the images with loadMipChains and uploads them; the GL calls stay on the calling thread
+std::vector<GLuint> loadTexturesFromFilesToGPU(const std::vector<TextureFile> &files);
+GLuint loadTextureFromFileToGPU(const std::string &filename, TextureKind kind = TextureKind::Color);
+
+#endif  // TEXTURE_LOADER_H
@@ -0,0 +1,358 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// BLOCK_COMPRESSION_NO_SIMD selects the scalar palette search, to test it against the SSE2 one
+#if defined(__SSE2__) && !defined(BLOCK_COMPRESSION_NO_SIMD)
+#define BLOCK_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const unsigned int BLOCKS_PER_THREAD = 4096;
+
+// The 16 texels of a block, one array per channel
+struct Block {
+  float channels[4][16];
+};
+
+void loadBlock(const unsigned char *pixels, int width, int height, int components, int bx, int by, Block &block)
+{
+  for(int y = 0; y < 4; ++y) {
+    const int sy = std::min(4*by + y, height - 1);
+    for(int x = 0; x < 4; ++x) {
+      const int sx = std::min(4*bx + x, width - 1);
+      const unsigned char *p = pixels + (static_cast<size_t>(sy)*width + sx)*components;
+      for(int c = 0; c < 4; ++c) block.channels[c][4*y + x] = p[std::min(c, components - 1)];
+    }
+  }
+}
+
+// Picks the closest palette entry for every texel, returns the sum of the squared distances.
+// With SSE2 four texels are compared to a palette entry at once.
+float nearestIndices(const float *const channels[], int channelCount, const float palette[][3], int paletteSize,
+                     unsigned char indices[16])
+{
+  float error = 0.f;
+  int i = 0;
+#ifdef BLOCK_COMPRESSION_SSE2
+  for(; i < 16; i += 4) {
+    __m128 best = _mm_set1_ps(FLT_MAX);
+    __m128i bestIndex = _mm_setzero_si128();
+    for(int k = 0; k < paletteSize; ++k) {
+      __m128 distance = _mm_setzero_ps();
+      for(int c = 0; c < channelCount; ++c) {
+        const __m128 d = _mm_sub_ps(_mm_loadu_ps(channels[c] + i), _mm_set1_ps(palette[k][c]));
+        distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+      }
+      const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+      best = _mm_min_ps(distance, best);
+      bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(k)));
+    }
+    int32_t lanes[4];
+    float errors[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+    _mm_storeu_ps(errors, best);
+    for(int j = 0; j < 4; ++j) {
+      indices[i + j] = static_cast<unsigned char>(lanes[j]);
+      error += errors[j];
+    }
+  }
+#endif
+  for(; i < 16; ++i) {
+    float best = FLT_MAX;
+    for(int k = 0; k < paletteSize; ++k) {
+      float distance = 0.f;
+      for(int c = 0; c < channelCount; ++c) {
+        const float d = channels[c][i] - palette[k][c];
+        distance += d*d;
+      }
+      if(distance < best) {
+        best = distance;
+        indices[i] = static_cast<unsigned char>(k);
+      }
+    }
+    error += best;
+  }
+  return error;
+}
+
+uint16_t packRgb565(const float color[3])
+{
+  const int r = std::min(31, std::max(0, static_cast<int>(std::lround(color[0]*31.f/255.f))));
+  const int g = std::min(63, std::max(0, static_cast<int>(std::lround(color[1]*63.f/255.f))));
+  const int b = std::min(31, std::max(0, static_cast<int>(std::lround(color[2]*31.f/255.f))));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpackRgb565(uint16_t value, float color[3])
+{
+  const int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+  color[0] = static_cast<float>((r << 3) | (r >> 2));
+  color[1] = static_cast<float>((g << 2) | (g >> 4));
+  color[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+// Writes the BC1 block for the two endpoints, always in four color mode, and returns its error
+float encodeColorEndpoints(const Block &block, uint16_t c0, uint16_t c1, unsigned char out[8])
+{
+  if(c0 < c1) std::swap(c0, c1);
+  float palette[4][3];
+  unpackRgb565(c0, palette[0]);
+  unpackRgb565(c1, palette[1]);
+  for(int c = 0; c < 3; ++c) {
+    palette[2][c] = (2.f*palette[0][c] + palette[1][c])/3.f;
+    palette[3][c] = (palette[0][c] + 2.f*palette[1][c])/3.f;
+  }
+  const float *channels[3] = { block.channels[0], block.channels[1], block.channels[2] };
+  unsigned char indices[16];
+  // equal endpoints select the three color mode, where index 3 is black
+  const float error = nearestIndices(channels, 3, palette, c0 == c1 ? 1 : 4, indices);
+  out[0] = static_cast<unsigned char>(c0 & 0xff);
+  out[1] = static_cast<unsigned char>(c0 >> 8);
+  out[2] = static_cast<unsigned char>(c1 & 0xff);
+  out[3] = static_cast<unsigned char>(c1 >> 8);
+  for(int row = 0; row < 4; ++row)
+    out[4 + row] = static_cast<unsigned char>(indices[4*row] | (indices[4*row + 1] << 2) |
+                                              (indices[4*row + 2] << 4) | (indices[4*row + 3] << 6));
+  return error;
+}
+
+// Endpoints at the extremes of the principal axis of the colors, then least squares refits of
+// the endpoints to the chosen indices while they lower the error.
+void encodeColorBlock(const Block &block, unsigned char out[8])
+{
+  float mean[3] = {0.f, 0.f, 0.f};
+  for(int c = 0; c < 3; ++c) {
+    for(int i = 0; i < 16; ++i) mean[c] += block.channels[c][i];
+    mean[c] /= 16.f;
+  }
+  float covariance[3][3] = {};
+  for(int i = 0; i < 16; ++i)
+    for(int a = 0; a < 3; ++a)
+      for(int b = 0; b < 3; ++b)
+        covariance[a][b] += (block.channels[a][i] - mean[a])*(block.channels[b][i] - mean[b]);
+  float axis[3] = {1.f, 1.f, 1.f};
+  for(int iteration = 0; iteration < 8; ++iteration) {
+    float next[3];
+    for(int a = 0; a < 3; ++a) next[a] = covariance[a][0]*axis[0] + covariance[a][1]*axis[1] + covariance[a][2]*axis[2];
+    const float length = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+    if(length < 1e-6f) break;
+    for(int a = 0; a < 3; ++a) axis[a] = next[a]/length;
+  }
+  float tMin = FLT_MAX, tMax = -FLT_MAX;
+  for(int i = 0; i < 16; ++i) {
+    float t = 0.f;
+    for(int c = 0; c < 3; ++c) t += (block.channels[c][i] - mean[c])*axis[c];
+    tMin = std::min(tMin, t);
+    tMax = std::max(tMax, t);
+  }
+  const float axisLength2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+  float end0[3], end1[3];
+  for(int c = 0; c < 3; ++c) {
+    end0[c] = mean[c] + axis[c]*tMax/axisLength2;
+    end1[c] = mean[c] + axis[c]*tMin/axisLength2;
+  }
+  float bestError = encodeColorEndpoints(block, packRgb565(end0), packRgb565(end1), out);
+
+  static const float weights[4] = {1.f, 0.f, 2.f/3.f, 1.f/3.f};  // share of endpoint 0 per index
+  for(int iteration = 0; iteration < 2 && bestError > 0.f; ++iteration) {
+    float aa = 0.f, ab = 0.f, bb = 0.f, ap[3] = {0.f, 0.f, 0.f}, bp[3] = {0.f, 0.f, 0.f};
+    for(int i = 0; i < 16; ++i) {
+      const float a = weights[(out[4 + i/4] >> (2*(i%4))) & 3], b = 1.f - a;
+      aa += a*a;
+      ab += a*b;
+      bb += b*b;
+      for(int c = 0; c < 3; ++c) {
+        ap[c] += a*block.channels[c][i];
+        bp[c] += b*block.channels[c][i];
+      }
+    }
+    const float determinant = aa*bb - ab*ab;
+    if(std::fabs(determinant) < 1e-6f) break;
+    for(int c = 0; c < 3; ++c) {
+      end0[c] = (bb*ap[c] - ab*bp[c])/determinant;
+      end1[c] = (aa*bp[c] - ab*ap[c])/determinant;
+    }
+    unsigned char candidate[8];
+    const float error = encodeColorEndpoints(block, packRgb565(end0), packRgb565(end1), candidate);
+    if(error >= bestError) break;
+    bestError = error;
+    std::memcpy(out, candidate, sizeof(candidate));
+  }
+}
+
+// BC4 block (also the alpha block of BC3): the extremes of the block in eight value mode
+void encodeChannelBlock(const float values[16], unsigned char out[8])
+{
+  const float low = *std::min_element(values, values + 16);
+  const float high = *std::max_element(values, values + 16);
+  float palette[8][3];
+  palette[0][0] = high;
+  palette[1][0] = low;
+  for(int k = 2; k < 8; ++k) palette[k][0] = ((8 - k)*high + (k - 1)*low)/7.f;
+  unsigned char indices[16];
+  nearestIndices(&values, 1, palette, high > low ? 8 : 1, indices);
+  out[0] = static_cast<unsigned char>(high);
+  out[1] = static_cast<unsigned char>(low);
+  uint64_t bits = 0;
+  for(int i = 0; i < 16; ++i) bits |= static_cast<uint64_t>(indices[i]) << (3*i);
+  for(int byte = 0; byte < 6; ++byte) out[2 + byte] = static_cast<unsigned char>(bits >> (8*byte));
+}
+
+// Palette of a BC4 block (also the alpha block of BC3): eight interpolated values when the first
+// endpoint is the larger, else six plus 0 and 255
+void decodeChannelBlock(const unsigned char in[8], unsigned char values[16])
+{
+  const int e0 = in[0], e1 = in[1];
+  int palette[8] = { e0, e1 };
+  if(e0 > e1) {
+    for(int k = 2; k < 8; ++k) palette[k] = ((8 - k)*e0 + (k - 1)*e1 + 3)/7;
+  } else {
+    for(int k = 2; k < 6; ++k) palette[k] = ((6 - k)*e0 + (k - 1)*e1 + 2)/5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+  uint64_t bits = 0;
+  for(int byte = 0; byte < 6; ++byte) bits |= static_cast<uint64_t>(in[2 + byte]) << (8*byte);
+  for(int i = 0; i < 16; ++i) values[i] = static_cast<unsigned char>(palette[(bits >> (3*i)) & 7]);
+}
+
+// BC1 block, or the color block of BC3 (fourColors), which ignores the order of the endpoints
+void decodeColorBlock(const unsigned char in[8], bool fourColors, unsigned char colors[16][3])
+{
+  const uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8)), c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+  float palette[4][3];
+  unpackRgb565(c0, palette[0]);
+  unpackRgb565(c1, palette[1]);
+  for(int c = 0; c < 3; ++c) {
+    if(fourColors || c0 > c1) {
+      palette[2][c] = (2.f*palette[0][c] + palette[1][c])/3.f;
+      palette[3][c] = (palette[0][c] + 2.f*palette[1][c])/3.f;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c])/2.f;
+      palette[3][c] = 0.f;
+    }
+  }
+  for(int i = 0; i < 16; ++i) {
+    const int index = (in[4 + i/4] >> (2*(i%4))) & 3;
+    for(int c = 0; c < 3; ++c) colors[i][c] = static_cast<unsigned char>(std::lround(palette[index][c]));
+  }
+}
+
+size_t blockSize(BlockFormat format)
+{
+  return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+void encodeBlock(const Block &block, BlockFormat format, unsigned char *out)
+{
+  switch(format) {
+  case BlockFormat::BC1:
+    encodeColorBlock(block, out);
+    break;
+  case BlockFormat::BC3:
+    encodeChannelBlock(block.channels[3], out);
+    encodeColorBlock(block, out + 8);
+    break;
+  case BlockFormat::BC4:
+    encodeChannelBlock(block.channels[0], out);
+    break;
+  case BlockFormat::BC5:
+    encodeChannelBlock(block.channels[0], out);
+    encodeChannelBlock(block.channels[1], out + 8);
+    break;
+  }
+}
+
+} // namespace
+
+size_t blockCompressedSize(int width, int height, BlockFormat format)
+{
+  return static_cast<size_t>((width + 3)/4)*((height + 3)/4)*blockSize(format);
+}
+
+void compressImage(const unsigned char *pixels, int width, int height, int components,
+                   BlockFormat format, unsigned char *out)
+{
+  const int blocksX = (width + 3)/4, blocksY = (height + 3)/4;
+  const size_t rowBytes = blocksX*blockSize(format);
+  auto encodeRows = [=](int begin, int end) {
+    Block block;
+    for(int by = begin; by < end; ++by)
+      for(int bx = 0; bx < blocksX; ++bx) {
+        loadBlock(pixels, width, height, components, bx, by, block);
+        encodeBlock(block, format, out + by*rowBytes + bx*blockSize(format));
+      }
+  };
+  const unsigned int threadCount = std::min(std::max(1u, std::thread::hardware_concurrency()),
+                                            std::max(1u, static_cast<unsigned int>(blocksX*blocksY)/BLOCKS_PER_THREAD));
+  if(threadCount <= 1) {
+    encodeRows(0, blocksY);
+    return;
+  }
+  std::vector<std::thread> threads;
+  const int band = (blocksY + threadCount - 1)/threadCount;
+  for(unsigned int t = 0; t < threadCount; ++t)
+    threads.push_back(std::thread(encodeRows, std::min(blocksY, static_cast<int>(t)*band),
+                                  std::min(blocksY, static_cast<int>(t + 1)*band)));
+  for(auto &thread : threads) thread.join();
+}
+
+int blockComponents(BlockFormat format)
+{
+  switch(format) {
+  case BlockFormat::BC1: return 3;
+  case BlockFormat::BC3: return 4;
+  case BlockFormat::BC4: return 1;
+  default: return 2;
+  }
+}
+
+void decompressImage(const unsigned char *blocks, int width, int height, BlockFormat format,
+                     unsigned char *pixels)
+{
+  const int blocksX = (width + 3)/4, blocksY = (height + 3)/4;
+  const int components = blockComponents(format);
+  unsigned char texels[16][4];
+  unsigned char colors[16][3];
+  unsigned char values[16];
+  for(int by = 0; by < blocksY; ++by)
+    for(int bx = 0; bx < blocksX; ++bx, blocks += blockSize(format)) {
+      switch(format) {
+      case BlockFormat::BC1:
+        decodeColorBlock(blocks, false, colors);
+        for(int i = 0; i < 16; ++i) std::memcpy(texels[i], colors[i], 3);
+        break;
+      case BlockFormat::BC3:
+        decodeChannelBlock(blocks, values);
+        decodeColorBlock(blocks + 8, true, colors);
+        for(int i = 0; i < 16; ++i) {
+          std::memcpy(texels[i], colors[i], 3);
+          texels[i][3] = values[i];
+        }
+        break;
+      case BlockFormat::BC4:
+        decodeChannelBlock(blocks, values);
+        for(int i = 0; i < 16; ++i) texels[i][0] = values[i];
+        break;
+      case BlockFormat::BC5:
+        decodeChannelBlock(blocks, values);
+        for(int i = 0; i < 16; ++i) texels[i][0] = values[i];
+        decodeChannelBlock(blocks + 8, values);
+        for(int i = 0; i < 16; ++i) texels[i][1] = values[i];
+        break;
+      }
+      // the texels of the border blocks outside of the image are dropped
+      for(int y = 0; y < 4 && 4*by + y < height; ++y)
+        for(int x = 0; x < 4 && 4*bx + x < width; ++x)
+          std::memcpy(pixels + (static_cast<size_t>(4*by + y)*width + 4*bx + x)*components, texels[4*y + x], components);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstddef>
+
+// CPU encoders and decoders for the 4x4 block compressed texture formats, independent of OpenGL.
+//  - BC1 (DXT1): opaque RGB, 8 bytes per block
+//  - BC3 (DXT5): RGB as BC1 plus an interpolated alpha block, 16 bytes per block
+//  - BC4 (RGTC1): one channel, 8 bytes per block
+//  - BC5 (RGTC2): two independent channels (the x and y of a normal map), 16 bytes per block
+enum class BlockFormat { BC1, BC3, BC4, BC5 };
+
+size_t blockCompressedSize(int width, int height, BlockFormat format);
+
+// Encodes an 8 bit image of the given number of components (rows tightly packed) into out, which
+// must hold blockCompressedSize bytes. Blocks crossing the border repeat the last row and column.
+// BC1 reads the first three components, BC3 four, BC4 the first and BC5 the first two.
+// Large images are encoded by several threads, one band of block rows each.
+void compressImage(const unsigned char *pixels, int width, int height, int components,
+                   BlockFormat format, unsigned char *out);
+
+// Number of components decompressImage writes per texel: 3 for BC1, 4 for BC3, 1 for BC4, 2 for BC5
+int blockComponents(BlockFormat format);
+
+// Decodes the blocks of a width x height image, as a GL implementation would, into 8 bit texels
+// of blockComponents(format) components (rows tightly packed). Handles both BC1 color modes and
+// both BC4 value modes, so it also reads blocks from other encoders.
+void decompressImage(const unsigned char *blocks, int width, int height, BlockFormat format,
+                     unsigned char *pixels);
+
+#endif  // BLOCK_COMPRESSION_H
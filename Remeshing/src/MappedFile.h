@@ -0,0 +1,83 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <ios>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view on the whole content of a file, memory mapped when the platform allows it
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &filename)
+  {
+#ifdef _WIN32
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if(!in)
+      throw std::ios_base::failure("[Mesh Loader] Cannot open " + filename);
+    _buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    _data = _buffer.data();
+    _size = _buffer.size();
+#else
+    _fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if(_fd < 0 || fstat(_fd, &st) != 0) {
+      if(_fd >= 0) close(_fd);
+      throw std::ios_base::failure("[Mesh Loader] Cannot open " + filename);
+    }
+    _size = st.st_size;
+    if(_size > 0) {
+      void *p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+      if(p == MAP_FAILED) {
+        close(_fd);
+        throw std::ios_base::failure("[Mesh Loader] Cannot map " + filename);
+      }
+      madvise(p, _size, MADV_SEQUENTIAL);
+      _data = static_cast<const char*>(p);
+    }
+#endif
+  }
+
+  ~MappedFile()
+  {
+#ifndef _WIN32
+    if(_data) munmap(const_cast<char*>(_data), _size);
+    if(_fd >= 0) close(_fd);
+#endif
+  }
+
+  const char *begin() const { return _data; }
+  const char *end() const { return _data + _size; }
+  size_t size() const { return _size; }
+
+  // Drops the pages read so far from the resident set, the next accesses read them again from the
+  // page cache or the file. Safe while other threads read the mapping.
+  void evict() const
+  {
+#ifndef _WIN32
+    if(_data) madvise(const_cast<char*>(_data), _size, MADV_DONTNEED);
+#endif
+  }
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  const char *_data = nullptr;
+  size_t _size = 0;
+#ifdef _WIN32
+  std::vector<char> _buffer;
+#else
+  int _fd = -1;
+#endif
+};
+
+#endif  // MAPPED_FILE_H
@@ -1,6 +1,7 @@
 #define _USE_MATH_DEFINES
 
 #include "Mesh.h"
+#include "MappedFile.h"
 
 #include <cmath>
 #include <algorithm>
@@ -10,6 +11,14 @@
 #include <ios>
 #include <string>
 #include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <functional>
+
 
 Mesh::~Mesh()
 {
@@ -29,22 +38,63 @@ void Mesh::computeBoundingSphere(glm::vec3 &center, float &radius) const
 
 void Mesh::recomputePerVertexNormals(bool angleBased)
 {
-  _vertexNormals.clear();
-  // Change the following code to compute a proper per-vertex normal
-  _vertexNormals.resize(_vertexPositions.size(), glm::vec3(0.0, 0.0, 0.0));
-
-  for(unsigned int tIt=0 ; tIt < _triangleIndices.size() ; ++tIt) {
-    glm::uvec3 t = _triangleIndices[tIt];
-    glm::vec3 n_t = glm::cross(
-      _vertexPositions[t[1]] - _vertexPositions[t[0]],
-      _vertexPositions[t[2]] - _vertexPositions[t[0]]);
-    _vertexNormals[t[0]] += n_t;
-    _vertexNormals[t[1]] += n_t;
-    _vertexNormals[t[2]] += n_t;
+  calculateVertexFaceAdjacency();
+  const unsigned int faceCount = _triangleIndices.size();
+  _triangleNormals.resize(faceCount);
+  _triangleArea.resize(faceCount);
+  _triangleAngles.resize(angleBased ? faceCount : 0);
+  for(unsigned int tIt = 0; tIt < faceCount; ++tIt) {
+    const glm::uvec3 &t = _triangleIndices[tIt];
+    const glm::vec3 a = _vertexPositions[t[0]], b = _vertexPositions[t[1]], c = _vertexPositions[t[2]];
+    const glm::vec3 n = glm::cross(b - a, c - a);
+    const float length = glm::length(n);
+    _triangleNormals[tIt] = length > 0.f ? n/length : n;
+    _triangleArea[tIt] = 0.5f*length;
+    if(angleBased) {
+      const glm::vec3 ab = b - a, ac = c - a, bc = c - b;
+      const float angleA = std::acos(glm::clamp(glm::dot(ab, ac)/std::sqrt(glm::dot(ab, ab)*glm::dot(ac, ac)), -1.f, 1.f));
+      const float angleB = std::acos(glm::clamp(-glm::dot(ab, bc)/std::sqrt(glm::dot(ab, ab)*glm::dot(bc, bc)), -1.f, 1.f));
+      _triangleAngles[tIt] = glm::vec3(angleA, angleB, 3.14159265358979f - angleA - angleB);
+    }
   }
-  for(unsigned int nIt = 0 ; nIt < _vertexNormals.size() ; ++nIt) {
-    glm::normalize(_vertexNormals[nIt]);
+  _vertexNormals.resize(_vertexPositions.size());
+  for(unsigned int v = 0; v < _vertexPositions.size(); ++v)
+    _vertexNormals[v] = gatherVertexNormal(v, angleBased);
+}
+
+// Sum of the unit normals of the faces around v, weighted by their area or by the angle of their
+// corner at v, normalized; zero for a vertex without faces. Degenerate faces are skipped.
+glm::vec3 Mesh::gatherVertexNormal(unsigned int v, bool angleBased) const
+{
+  glm::vec3 normal(0.f);
+  for(unsigned int k = _vertexFaceOffsets[v]; k < _vertexFaceOffsets[v + 1]; ++k) {
+    const unsigned int f = _vertexFaces[k];
+    if(!(_triangleArea[f] > 0.f)) continue;
+    float weight = _triangleArea[f];
+    if(angleBased) {
+      const glm::uvec3 &t = _triangleIndices[f];
+      weight = _triangleAngles[f][t[0] == v ? 0 : (t[1] == v ? 1 : 2)];
+    }
+    normal += weight*_triangleNormals[f];
   }
+  const float length = glm::length(normal);
+  return length > 0.f ? normal/length : normal;
+}
+
+void Mesh::calculateVertexFaceAdjacency()
+{
+  _vertexFaceOffsets.assign(_vertexPositions.size() + 1, 0);
+  for(const glm::uvec3 &t : _triangleIndices)
+    for(unsigned int c = 0; c < 3; ++c)
+      _vertexFaceOffsets[t[c] + 1]++;
+  for(unsigned int i = 0; i < _vertexPositions.size(); ++i)
+    _vertexFaceOffsets[i + 1] += _vertexFaceOffsets[i];
+
+  std::vector<unsigned int> cursor(_vertexFaceOffsets.begin(), _vertexFaceOffsets.end() - 1);
+  _vertexFaces.resize(_vertexFaceOffsets.back());
+  for(unsigned int tIt = 0; tIt < _triangleIndices.size(); ++tIt)
+    for(unsigned int c = 0; c < 3; ++c)
+      _vertexFaces[cursor[_triangleIndices[tIt][c]]++] = tIt;
 }
 
 void Mesh::recomputePerVertexTextureCoordinates()
@@ -210,38 +260,260 @@ void Mesh::clear()
   }
 }
 
+namespace {
+
+// Allocation free tokenizer on an OFF text buffer. Keeps track of the line for the error messages.
+class OffTokenizer {
+public:
+  OffTokenizer(const char *begin, const char *end, const std::string &filename, unsigned int line = 1)
+    : _cur(begin), _end(end), _line(line), _filename(filename) {}
+
+  const char *position() const { return _cur; }
+  unsigned int line() const { return _line; }
+
+  // Skip the blanks, the line breaks and the # comments
+  void skipSpaces()
+  {
+    while(_cur < _end) {
+      const char c = *_cur;
+      if(c == '\n') {
+        ++_line;
+        ++_cur;
+      } else if(c == ' ' || c == '\t' || c == '\r') {
+        ++_cur;
+      } else if(c == '#') {
+        while(_cur < _end && *_cur != '\n') ++_cur;
+      } else {
+        break;
+      }
+    }
+  }
+
+  bool readKeyword(const char *keyword)
+  {
+    skipSpaces();
+    const char *p = _cur;
+    for(; *keyword; ++keyword, ++p)
+      if(p == _end || *p != *keyword) return false;
+    if(p < _end && !isSpace(*p)) return false;
+    _cur = p;
+    return true;
+  }
+
+  unsigned int readUnsigned(const char *what)
+  {
+    skipSpaces();
+    const char *start = _cur;
+    uint64_t value = 0;
+    while(_cur < _end && *_cur >= '0' && *_cur <= '9' && value <= 0xFFFFFFFFull)
+      value = 10*value + (*_cur++ - '0');
+    if(_cur == start || value > 0xFFFFFFFFull || (_cur < _end && !isSpace(*_cur)))
+      fail(what);
+    return static_cast<unsigned int>(value);
+  }
+
+  float readFloat(const char *what)
+  {
+    skipSpaces();
+    const char *start = _cur;
+    bool negative = false;
+    if(_cur < _end && (*_cur == '-' || *_cur == '+')) negative = (*_cur++ == '-');
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool anyDigit = false;
+    for(; _cur < _end && *_cur >= '0' && *_cur <= '9'; ++_cur, anyDigit = true) {
+      if(digits < 19) { mantissa = 10*mantissa + (*_cur - '0'); if(mantissa) ++digits; }
+      else ++exponent;
+    }
+    if(_cur < _end && *_cur == '.') {
+      for(++_cur; _cur < _end && *_cur >= '0' && *_cur <= '9'; ++_cur, anyDigit = true) {
+        if(digits < 19) { mantissa = 10*mantissa + (*_cur - '0'); if(mantissa) ++digits; --exponent; }
+      }
+    }
+    if(anyDigit && _cur < _end && (*_cur == 'e' || *_cur == 'E')) {
+      ++_cur;
+      bool negativeExponent = false;
+      if(_cur < _end && (*_cur == '-' || *_cur == '+')) negativeExponent = (*_cur++ == '-');
+      int e = 0;
+      const char *exponentStart = _cur;
+      while(_cur < _end && *_cur >= '0' && *_cur <= '9' && e < 100000) e = 10*e + (*_cur++ - '0');
+      if(_cur == exponentStart) fail(what);
+      exponent += negativeExponent ? -e : e;
+    }
+    if(anyDigit && (_cur == _end || isSpace(*_cur))) {
+      // exact when the mantissa and the power of ten are both representable (Clinger's fast path)
+      static const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+      if(mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        double value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value/powersOfTen[-exponent] : value*powersOfTen[exponent];
+        return static_cast<float>(negative ? -value : value);
+      }
+    }
+    // slow path (long mantissas, huge exponents, inf, nan): strtof on a terminated copy of the token
+    _cur = start;
+    while(_cur < _end && !isSpace(*_cur)) ++_cur;
+    char token[128];
+    const size_t length = std::min<size_t>(_cur - start, sizeof(token) - 1);
+    std::memcpy(token, start, length);
+    token[length] = '\0';
+    char *parsedEnd = nullptr;
+    const float value = std::strtof(token, &parsedEnd);
+    if(length == 0 || parsedEnd != token + length)
+      fail(what);
+    return value;
+  }
+
+  void fail(const std::string &what) const
+  {
+    throw std::ios_base::failure(
+      "[Mesh Loader][loadOFF] " + _filename + ":" + std::to_string(_line) + ": expected " + what);
+  }
+
+private:
+  static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#'; }
+
+  const char *_cur;
+  const char *_end;
+  unsigned int _line;
+  const std::string &_filename;
+};
+
+// Parses the vertices and faces of an OFF body with several threads. The buffer is cut in chunks
+// at line boundaries, the records (non empty, non comment lines) of every chunk are counted, and
+// a prefix sum gives the first record and line of each chunk, so that all the chunks are parsed
+// concurrently into the preallocated arrays. Returns false when the body does not hold exactly
+// one vertex or one face per line, or on any parsing error: the caller then runs the sequential
+// parser, which reports the error.
+bool parseOffBodyInParallel(const char *begin, const char *end, unsigned int firstLine,
+                            const std::string &filename, unsigned int threadCount,
+                            std::vector<glm::vec3> &P, std::vector<glm::uvec3> &T)
+{
+  const unsigned int chunkCount = 4*threadCount;
+  std::vector<const char*> bounds(chunkCount + 1, end);
+  bounds[0] = begin;
+  for(unsigned int c = 1; c < chunkCount; ++c) {
+    const char *p = std::max(bounds[c - 1], begin + (end - begin)*c/chunkCount);
+    while(p < end && p[-1] != '\n') ++p;
+    bounds[c] = p;
+  }
+
+  auto runChunks = [&](std::function<void(unsigned int)> job) {
+    std::vector<std::thread> threads;
+    for(unsigned int t = 0; t < threadCount; ++t)
+      threads.push_back(std::thread([&, t]() {
+        for(unsigned int c = t; c < chunkCount; c += threadCount) job(c);
+      }));
+    for(auto &thread : threads) thread.join();
+  };
+  // first non blank character of the line starting at p, which is a record unless it is a comment
+  auto isRecord = [](const char *p, const char *lineEnd) {
+    while(p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p < lineEnd && *p != '#';
+  };
+
+  // 1. count the records and the lines of every chunk
+  std::vector<size_t> records(chunkCount + 1, 0), lines(chunkCount + 1, 0);
+  runChunks([&](unsigned int c) {
+    for(const char *p = bounds[c]; p < bounds[c + 1];) {
+      const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', bounds[c + 1] - p));
+      if(!lineEnd) lineEnd = bounds[c + 1];
+      if(isRecord(p, lineEnd)) records[c + 1]++;
+      if(lineEnd < bounds[c + 1]) lines[c + 1]++;
+      p = lineEnd + 1;
+    }
+  });
+  for(unsigned int c = 0; c < chunkCount; ++c) {
+    records[c + 1] += records[c];
+    lines[c + 1] += lines[c];
+  }
+  const size_t sizeV = P.size(), sizeT = T.size();
+  if(records[chunkCount] != sizeV + sizeT)
+    return false;
+
+  // 2. parse every chunk at its own offset
+  std::atomic<bool> failed(false);
+  runChunks([&](unsigned int c) {
+    size_t record = records[c];
+    unsigned int line = firstLine + lines[c];
+    try {
+      for(const char *p = bounds[c]; p < bounds[c + 1] && !failed; ++line) {
+        const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', bounds[c + 1] - p));
+        if(!lineEnd) lineEnd = bounds[c + 1];
+        if(isRecord(p, lineEnd)) {
+          OffTokenizer in(p, lineEnd, filename, line);
+          if(record < sizeV) {
+            glm::vec3 &v = P[record];
+            v[0] = in.readFloat("a vertex coordinate");
+            v[1] = in.readFloat("a vertex coordinate");
+            v[2] = in.readFloat("a vertex coordinate");
+          } else {
+            glm::uvec3 &t = T[record - sizeV];
+            if(in.readUnsigned("a face size") != 3)
+              in.fail("a triangle (face size 3)");
+            for(unsigned int j=0; j<3; ++j) {
+              t[j] = in.readUnsigned("a vertex index");
+              if(t[j] >= sizeV)
+                in.fail("a vertex index lower than " + std::to_string(sizeV));
+            }
+          }
+          in.skipSpaces();
+          if(in.position() != lineEnd)
+            in.fail("the end of the line");
+          ++record;
+        }
+        p = lineEnd + 1;
+      }
+    } catch(std::exception &) {
+      failed = true;
+    }
+  });
+  return !failed;
+}
+
+} // namespace
+
 // Loads an OFF mesh file. See https://en.wikipedia.org/wiki/OFF_(file_format)
-void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr)
+// The file is memory mapped and parsed in place, straight into the mesh arrays. Large files are
+// parsed by threadCount threads (0: one per hardware thread, 1: sequential) with the same result.
+void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr, unsigned int threadCount)
 {
   std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
   meshPtr->clear();
-  std::ifstream in(filename.c_str());
-  if(!in)
-    throw std::ios_base::failure("[Mesh Loader][loadOFF] Cannot open " + filename);
-  std::string offString;
-  unsigned int sizeV, sizeT, tmp;
-  in >> offString >> sizeV >> sizeT >> tmp;
+  MappedFile file(filename);
+  OffTokenizer in(file.begin(), file.end(), filename);
+  if(!in.readKeyword("OFF"))
+    in.fail("the OFF header");
+  const unsigned int sizeV = in.readUnsigned("the number of vertices");
+  const unsigned int sizeT = in.readUnsigned("the number of faces");
+  in.readUnsigned("the number of edges");
   auto &P = meshPtr->vertexPositions();
   auto &T = meshPtr->triangleIndices();
   P.resize(sizeV);
   T.resize(sizeT);
-  size_t tracker = (sizeV + sizeT)/20;
-  std::cout << " > [" << std::flush;
-  for(unsigned int i=0; i<sizeV; ++i) {
-    if(i % tracker == 0)
-      std::cout << "-" << std::flush;
-    in >> P[i][0] >> P[i][1] >> P[i][2];
-  }
-  int s;
-  for(unsigned int i=0; i<sizeT; ++i) {
-    if((sizeV + i) % tracker == 0)
-      std::cout << "-" << std::flush;
-    in >> s;
-    for(unsigned int j=0; j<3; ++j)
-      in >> T[i][j];
-  }
-  std::cout << "]" << std::endl;
-  in.close();
+
+  if(threadCount == 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  const size_t minimumChunkSize = 1 << 20;
+  threadCount = std::min<size_t>(threadCount, std::max<size_t>(1, (file.end() - in.position())/minimumChunkSize));
+  const bool parsedInParallel = threadCount > 1 &&
+    parseOffBodyInParallel(in.position(), file.end(), in.line(), filename, threadCount, P, T);
+
+  for(unsigned int i=0; !parsedInParallel && i<sizeV; ++i) {
+    P[i][0] = in.readFloat("a vertex coordinate");
+    P[i][1] = in.readFloat("a vertex coordinate");
+    P[i][2] = in.readFloat("a vertex coordinate");
+  }
+  for(unsigned int i=0; !parsedInParallel && i<sizeT; ++i) {
+    if(in.readUnsigned("a face size") != 3)
+      in.fail("a triangle (face size 3)");
+    for(unsigned int j=0; j<3; ++j) {
+      T[i][j] = in.readUnsigned("a vertex index");
+      if(T[i][j] >= sizeV)
+        in.fail("a vertex index lower than " + std::to_string(sizeV));
+    }
+  }
   meshPtr->vertexNormals().resize(P.size(), glm::vec3(0.f, 0.f, 1.f));
   meshPtr->vertexTexCoords().resize(P.size(), glm::vec2(0.f, 0.f));
   meshPtr->recomputePerVertexNormals();
@@ -0,0 +1,332 @@
+#include "TextureLoader.h"
+#include "BlockCompression.h"
+#include "MappedFile.h"
+
+#include "stb_image.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <ios>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// S3TC is an extension, its enums are not in every generated glad header
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace {
+
+const char MIP_CACHE_MAGIC[8] = {'M', 'I', 'P', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t MIP_CACHE_VERSION = 2;
+const unsigned int MAX_MIP_LEVELS = 16;  // up to 32768x32768
+const size_t MIP_LEVEL_ALIGNMENT = 64;
+
+struct MipCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t components;
+  uint32_t format;
+  uint32_t options;     // texture kind and S3TC support the chain was built for
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+  uint32_t levelCount;
+  uint32_t reserved;
+  uint64_t levelOffsets[MAX_MIP_LEVELS + 1];  // from the start of the file
+};
+
+const size_t MIP_CACHE_DATA_START =
+  (sizeof(MipCacheHeader) + MIP_LEVEL_ALIGNMENT - 1)/MIP_LEVEL_ALIGNMENT*MIP_LEVEL_ALIGNMENT;
+
+size_t alignLevel(size_t offset) { return (offset + MIP_LEVEL_ALIGNMENT - 1)/MIP_LEVEL_ALIGNMENT*MIP_LEVEL_ALIGNMENT; }
+
+bool statSource(const std::string &filename, uint64_t &size, int64_t &mtime)
+{
+  struct stat st;
+  if(stat(filename.c_str(), &st) != 0) return false;
+  size = static_cast<uint64_t>(st.st_size);
+  mtime = static_cast<int64_t>(st.st_mtime);
+  return true;
+}
+
+uint32_t cacheOptions(TextureKind kind, bool s3tc)
+{
+  return (kind == TextureKind::NormalMap ? 1u : 0u) | (s3tc ? 2u : 0u);
+}
+
+GLenum uncompressedFormat(int components)
+{
+  return components == 1 ? GL_RED : components == 2 ? GL_RG : components == 3 ? GL_RGB : GL_RGBA;
+}
+
+bool toBlockFormat(GLenum format, BlockFormat &blockFormat)
+{
+  switch(format) {
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: blockFormat = BlockFormat::BC1; return true;
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: blockFormat = BlockFormat::BC3; return true;
+  case GL_COMPRESSED_RED_RGTC1: blockFormat = BlockFormat::BC4; return true;
+  case GL_COMPRESSED_RG_RGTC2: blockFormat = BlockFormat::BC5; return true;
+  default: return false;
+  }
+}
+
+void computeLevelOffsets(MipChain &chain)
+{
+  chain.levelOffsets.assign(1, 0);
+  for(int level = 0; ; ++level) {
+    chain.levelOffsets.push_back(alignLevel(chain.levelOffsets.back() + chain.levelSize(level)));
+    if(chain.levelWidth(level) == 1 && chain.levelHeight(level) == 1) break;
+  }
+}
+
+// Halves the image (sizes rounded down, as the GL mip sizes) by averaging 2x2 blocks. The two
+// rows are first summed into 16 bit lanes, 16 bytes at a time when SSE2 is available.
+void downsample(const unsigned char *src, int width, int height, int components, unsigned char *dst,
+                std::vector<uint16_t> &sums)
+{
+  const int halfWidth = std::max(1, width/2), halfHeight = std::max(1, height/2);
+  const size_t rowBytes = static_cast<size_t>(width)*components;
+  const int dx = width > 1 ? components : 0;
+  sums.resize(rowBytes);
+  for(int y = 0; y < halfHeight; ++y) {
+    const unsigned char *row0 = src + 2*y*rowBytes;
+    const unsigned char *row1 = height > 1 ? row0 + rowBytes : row0;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 16 <= rowBytes; i += 16) {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&sums[i]), _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&sums[i + 8]), _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)));
+    }
+#endif
+    for(; i < rowBytes; ++i) sums[i] = row0[i] + row1[i];
+    unsigned char *out = dst + static_cast<size_t>(y)*halfWidth*components;
+    for(int x = 0; x < halfWidth; ++x) {
+      const uint16_t *s = &sums[2*x*components];
+      for(int c = 0; c < components; ++c)
+        *out++ = static_cast<unsigned char>((s[c] + s[c + dx] + 2) >> 2);
+    }
+  }
+}
+
+// Compressed format for the image, or 0 to keep the texels as they are
+GLenum chooseCompressedFormat(const MipChain &chain, TextureKind kind, bool s3tc)
+{
+  if(kind == TextureKind::NormalMap)
+    return chain.components >= 2 ? GL_COMPRESSED_RG_RGTC2 : 0;
+  if(chain.components == 1) return GL_COMPRESSED_RED_RGTC1;
+  if(chain.components == 2 || !s3tc) return 0;
+  if(chain.components == 4)
+    for(size_t i = 3; i < chain.levelSize(0); i += 4)
+      if(chain.data[i] != 255) return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+MipChain buildMipChain(const std::string &filename, TextureKind kind, bool s3tc)
+{
+  MipChain chain;
+  unsigned char *image = stbi_load(filename.c_str(), &chain.width, &chain.height, &chain.components, 0);
+  if(!image)
+    throw std::ios_base::failure("[Texture Loader][loadMipChains] Cannot decode " + filename + ": " + stbi_failure_reason());
+  chain.format = uncompressedFormat(chain.components);
+  computeLevelOffsets(chain);
+  chain.data.resize(chain.levelOffsets.back());
+  std::memcpy(chain.data.data(), image, static_cast<size_t>(chain.width)*chain.height*chain.components);
+  stbi_image_free(image);
+
+  std::vector<uint16_t> sums;
+  for(int level = 1; level < chain.levelCount(); ++level)
+    downsample(chain.levelData(level - 1), chain.levelWidth(level - 1), chain.levelHeight(level - 1),
+               chain.components, &chain.data[chain.levelOffsets[level]], sums);
+
+  BlockFormat blockFormat;
+  const GLenum compressedFormat = chooseCompressedFormat(chain, kind, s3tc);
+  if(!toBlockFormat(compressedFormat, blockFormat)) return chain;
+  MipChain blocks;
+  blocks.width = chain.width;
+  blocks.height = chain.height;
+  blocks.components = chain.components;
+  blocks.format = compressedFormat;
+  blocks.compressed = true;
+  computeLevelOffsets(blocks);
+  blocks.data.resize(blocks.levelOffsets.back());
+  for(int level = 0; level < chain.levelCount(); ++level)
+    compressImage(chain.levelData(level), chain.levelWidth(level), chain.levelHeight(level), chain.components,
+                  blockFormat, &blocks.data[blocks.levelOffsets[level]]);
+  return blocks;
+}
+
+bool readMipCache(const std::string &filename, uint64_t sourceSize, int64_t sourceMtime, uint32_t options, MipChain &chain)
+{
+  std::shared_ptr<MappedFile> file;
+  try {
+    file = std::make_shared<MappedFile>(filename);
+  } catch(std::ios_base::failure &) {
+    return false;
+  }
+  MipCacheHeader header;
+  if(file->size() < MIP_CACHE_DATA_START) return false;
+  std::memcpy(&header, file->begin(), sizeof(header));
+  bool ok = std::memcmp(header.magic, MIP_CACHE_MAGIC, sizeof(MIP_CACHE_MAGIC)) == 0 &&
+    header.version == MIP_CACHE_VERSION && header.options == options &&
+    header.sourceSize == sourceSize && header.sourceMtime == sourceMtime &&
+    header.components >= 1 && header.components <= 4 && header.width >= 1 && header.height >= 1 &&
+    std::max(header.width, header.height) < (1u << MAX_MIP_LEVELS);
+  if(ok) {
+    chain.width = header.width;
+    chain.height = header.height;
+    chain.components = header.components;
+    chain.format = header.format;
+    BlockFormat blockFormat;
+    chain.compressed = toBlockFormat(chain.format, blockFormat);
+    ok = chain.compressed || chain.format == uncompressedFormat(chain.components);
+    computeLevelOffsets(chain);
+    ok = ok && chain.levelCount() == static_cast<int>(header.levelCount);
+    for(int level = 0; ok && level <= chain.levelCount(); ++level)
+      ok = header.levelOffsets[level] == MIP_CACHE_DATA_START + chain.levelOffsets[level];
+    ok = ok && file->size() >= MIP_CACHE_DATA_START + chain.levelOffsets.back();
+  }
+  if(ok) {
+    chain.mapped = reinterpret_cast<const unsigned char*>(file->begin()) + MIP_CACHE_DATA_START;
+    chain.mapping = file;
+  }
+  chain.fromCache = ok;
+  return ok;
+}
+
+void writeMipCache(const std::string &filename, uint64_t sourceSize, int64_t sourceMtime, uint32_t options,
+                   const MipChain &chain)
+{
+  if(chain.levelCount() > static_cast<int>(MAX_MIP_LEVELS)) return;
+  MipCacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MIP_CACHE_MAGIC, sizeof(MIP_CACHE_MAGIC));
+  header.version = MIP_CACHE_VERSION;
+  header.width = chain.width;
+  header.height = chain.height;
+  header.components = chain.components;
+  header.format = chain.format;
+  header.options = options;
+  header.sourceSize = sourceSize;
+  header.sourceMtime = sourceMtime;
+  header.levelCount = chain.levelCount();
+  for(int level = 0; level <= chain.levelCount(); ++level)
+    header.levelOffsets[level] = MIP_CACHE_DATA_START + chain.levelOffsets[level];
+
+  // the cache is an optimization only, a read-only data directory is not an error
+  FILE *file = std::fopen(filename.c_str(), "wb");
+  if(!file) return;
+  const std::vector<char> padding(MIP_CACHE_DATA_START - sizeof(header), 0);
+  const bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+    std::fwrite(padding.data(), 1, padding.size(), file) == padding.size() &&
+    std::fwrite(chain.data.data(), 1, chain.data.size(), file) == chain.data.size();
+  if(std::fclose(file) != 0 || !ok) std::remove(filename.c_str());
+}
+
+MipChain loadMipChain(const std::string &filename, TextureKind kind, bool s3tc)
+{
+  const std::string cacheFilename = filename + ".mips";
+  const uint32_t options = cacheOptions(kind, s3tc);
+  uint64_t sourceSize = 0;
+  int64_t sourceMtime = 0;
+  const bool hasSource = statSource(filename, sourceSize, sourceMtime);
+  MipChain chain;
+  if(hasSource && readMipCache(cacheFilename, sourceSize, sourceMtime, options, chain)) return chain;
+  chain = buildMipChain(filename, kind, s3tc);
+  // without the stamp of the image, a cache could not be told stale later
+  if(hasSource) writeMipCache(cacheFilename, sourceSize, sourceMtime, options, chain);
+  return chain;
+}
+
+bool isS3tcSupported()
+{
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+  std::vector<GLint> formats(std::max(count, 1));
+  glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+  formats.resize(count);
+  return std::find(formats.begin(), formats.end(), GL_COMPRESSED_RGB_S3TC_DXT1_EXT) != formats.end() &&
+    std::find(formats.begin(), formats.end(), GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) != formats.end();
+}
+
+} // namespace
+
+size_t MipChain::levelSize(int level) const
+{
+  BlockFormat blockFormat;
+  if(compressed && toBlockFormat(format, blockFormat))
+    return blockCompressedSize(levelWidth(level), levelHeight(level), blockFormat);
+  return static_cast<size_t>(levelWidth(level))*levelHeight(level)*components;
+}
+
+std::vector<MipChain> loadMipChains(const std::vector<TextureFile> &files, bool s3tc)
+{
+  std::vector<std::future<MipChain>> tasks;
+  tasks.reserve(files.size());
+  for(const auto &file : files)
+    tasks.push_back(std::async(std::launch::async, loadMipChain, file.filename, file.kind, s3tc));
+  // wait for every task before rethrowing, none may outlive the call
+  for(auto &task : tasks) task.wait();
+  std::vector<MipChain> chains;
+  chains.reserve(tasks.size());
+  for(auto &task : tasks) chains.push_back(task.get());
+  return chains;
+}
+
+GLuint uploadMipChain(const MipChain &chain)
+{
+  GLuint texID;
+  glGenTextures(1, &texID);
+  glBindTexture(GL_TEXTURE_2D, texID);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, chain.levelCount() - 1);
+  // rows of the small levels are not 4 byte aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for(int level = 0; level < chain.levelCount(); ++level) {
+    if(chain.compressed)
+      glCompressedTexImage2D(GL_TEXTURE_2D, level, chain.format, chain.levelWidth(level), chain.levelHeight(level), 0,
+                             static_cast<GLsizei>(chain.levelSize(level)), chain.levelData(level));
+    else
+      glTexImage2D(GL_TEXTURE_2D, level, chain.format, chain.levelWidth(level), chain.levelHeight(level), 0,
+                   chain.format, GL_UNSIGNED_BYTE, chain.levelData(level));
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texID;
+}
+
+std::vector<GLuint> loadTexturesFromFilesToGPU(const std::vector<TextureFile> &files)
+{
+  const std::vector<MipChain> chains = loadMipChains(files, isS3tcSupported());
+  std::vector<GLuint> textures;
+  for(size_t i = 0; i < chains.size(); ++i) {
+    textures.push_back(uploadMipChain(chains[i]));
+    std::cout << " > Texture <" << files[i].filename << "> " << chains[i].width << "x" << chains[i].height << ", "
+              << chains[i].levelCount() << " levels, " << chains[i].levelOffsets.back()/1024 << " KiB"
+              << (chains[i].compressed ? " compressed" : "") << (chains[i].fromCache ? " (mip cache)" : "") << std::endl;
+  }
+  return textures;
+}
+
+GLuint loadTextureFromFileToGPU(const std::string &filename, TextureKind kind)
+{
+  const TextureFile file = { filename, kind };
+  return loadTexturesFromFilesToGPU(std::vector<TextureFile>(1, file))[0];
+}
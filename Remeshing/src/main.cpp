@@ -38,17 +38,25 @@
 #include <memory>
 #include <algorithm>
 #include <exception>
+#include <future>
+#include <chrono>
+#include <cstring>
 
 #include "Error.h"
 #include "ShaderProgram.h"
 #include "Camera.h"
 #include "Mesh.h"
+#include "TextureLoader.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 const std::string DEFAULT_MESH_FILENAME("data/monkey.off");
 
+// Mesh parsed on a background thread while the window and the shaders are created (see init()),
+// then installed in the scene by installPendingMesh() on the GL thread
+std::future<std::shared_ptr<Mesh>> g_pendingMesh;
+
 // window parameters
 GLFWwindow *g_window = nullptr;
 int g_windowWidth = 1024;
@@ -82,44 +90,61 @@ int g_normalTexLoaded = 0;
 GLuint g_normalTex;
 unsigned int g_normalTexOnGPU;
 
-GLuint loadTextureFromFileToGPU(const std::string &filename)
+// Shadow map files being written by worker threads
+std::vector<std::future<void>> g_fileWriters;
+
+// Reports the errors of the finished writers and forgets them; waits for all of them when wait is true
+void collectFileWriters(bool wait)
+{
+  for(size_t i = 0; i < g_fileWriters.size(); ) {
+    std::future<void> &writer = g_fileWriters[i];
+    if(!wait && writer.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++i;
+      continue;
+    }
+    try {
+      writer.get();
+    } catch(std::exception &e) {
+      std::cerr << "> [Error writing file]" << e.what() << std::endl;
+    }
+    g_fileWriters.erase(g_fileWriters.begin() + i);
+  }
+}
+
+void startFileWriter(std::future<void> writer)
+{
+  collectFileWriters(false);
+  g_fileWriters.push_back(std::move(writer));
+}
+
+// Writes depths read back from GL (rows bottom to top, values in [0,1]) as a binary 16 bit PGM, or
+// as a PFM holding the floats unchanged when the file name ends with .pfm
+void writeDepthImage(const std::string &filename, const std::vector<float> &depths, unsigned int width, unsigned int height)
 {
-  int width, height, numComponents;
-  // Loading the image in CPU memory using stbd_image
-  unsigned char *data = stbi_load(
-    filename.c_str(),
-    &width,
-    &height,
-    &numComponents, // 1 for a 8 bit greyscale image, 3 for 24bits RGB image, 4 for 32bits RGBA image
-    0);
-
-  // Create a texture in GPU memory
-  GLuint texID;
-  glGenTextures(1, &texID);
-  glBindTexture(GL_TEXTURE_2D, texID);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  // Uploading the image data to GPU memory
-  glTexImage2D(
-    GL_TEXTURE_2D,
-    0,
-    (numComponents == 1 ? GL_RED : numComponents == 3 ? GL_RGB : GL_RGBA), // For greyscale images, we store them in the RED channel
-    width,
-    height,
-    0,
-    (numComponents == 1 ? GL_RED : numComponents == 3 ? GL_RGB : GL_RGBA), // For greyscale images, we store them in the RED channel
-    GL_UNSIGNED_BYTE,
-    data);
-
-  // Generating mipmaps for filtered texture fetch
-  glGenerateMipmap(GL_TEXTURE_2D);
-
-  // Freeing the now useless CPU memory
-  stbi_image_free(data);
-  glBindTexture(GL_TEXTURE_2D, 0); // unbind the texture
-  return texID;
+  std::ofstream output(filename.c_str(), std::ios::binary);
+  if(!output)
+    throw std::ios_base::failure("[Shadow Map][writeDepthImage] Cannot open " + filename);
+  if(filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".pfm") == 0) {
+    // PFM rows go bottom to top as in GL; the sign of the scale gives the byte order
+    const uint16_t probe = 1;
+    const bool littleEndian = *reinterpret_cast<const unsigned char*>(&probe) == 1;
+    output << "Pf\n" << width << " " << height << "\n" << (littleEndian ? "-1.0" : "1.0") << "\n";
+    output.write(reinterpret_cast<const char*>(depths.data()), sizeof(float)*depths.size());
+  } else {
+    output << "P5\n" << width << " " << height << "\n65535\n";
+    std::vector<unsigned char> row(2*width);
+    for(unsigned int y = height; y-- > 0; ) {
+      for(unsigned int x = 0; x < width; ++x) {
+        const float depth = std::min(1.f, std::max(0.f, depths[static_cast<size_t>(y)*width + x]));
+        const unsigned int value = static_cast<unsigned int>(depth*65535.f + 0.5f);
+        row[2*x] = static_cast<unsigned char>(value >> 8);  // PGM samples are big endian
+        row[2*x + 1] = static_cast<unsigned char>(value & 0xff);
+      }
+      output.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+  }
+  if(!output)
+    throw std::ios_base::failure("[Shadow Map][writeDepthImage] Cannot write " + filename);
 }
 
 class FboShadowMap {
@@ -167,37 +192,62 @@ public:
     // according to the light viewpoint
   }
 
-  void free() { glDeleteFramebuffers(1, &_depthMapFbo); }
+  void free()
+  {
+    glDeleteFramebuffers(1, &_depthMapFbo);
+    if(_dumpSync) glDeleteSync(_dumpSync);
+    if(_dumpPbo) glDeleteBuffers(1, &_dumpPbo);
+  }
 
-  void savePpmFile(std::string const &filename)
+  // Asks for an asynchronous dump of the depth map. The GPU copies the depth into a pixel buffer
+  // object, and collectDump() hands it to a writer thread once a fence tells the copy is done, so
+  // the render loop waits neither for the GPU nor for the disk. A request made while the previous
+  // dump is in flight waits for it, a newer request replaces a waiting one.
+  void requestDump(std::string const &filename)
   {
-    std::ofstream output_image(filename.c_str());
-
-    // READ THE PIXELS VALUES from FBO AND SAVE TO A .PPM FILE
-    int i, j, k;
-    float *pixels = new float[_depthMapTextureWidth*_depthMapTextureHeight];
-
-    // READ THE CONTENT FROM THE FBO
-    glReadBuffer(GL_COLOR_ATTACHMENT0);
-    glReadPixels(0, 0, _depthMapTextureWidth, _depthMapTextureHeight, GL_DEPTH_COMPONENT , GL_FLOAT, pixels);
-
-    output_image << "P3" << std::endl;
-    output_image << _depthMapTextureWidth << " " << _depthMapTextureHeight << std::endl;
-    output_image << "255" << std::endl;
-
-    k = 0;
-    for(i=0; i<_depthMapTextureWidth; ++i) {
-      for(j=0; j<_depthMapTextureHeight; ++j) {
-        output_image <<
-          static_cast<unsigned int>(255*pixels[k]) << " " <<
-          static_cast<unsigned int>(255*pixels[k]) << " " <<
-          static_cast<unsigned int>(255*pixels[k]) << " ";
-        k = k+1;
-      }
-      output_image << std::endl;
+    if(_dumpSync)
+      std::cout << " > Shadow map dump to " << filename << " queued, the previous one is still in flight" << std::endl;
+    if(!_queuedDumpFilename.empty() && _queuedDumpFilename != filename)
+      std::cout << " > Shadow map dump to " << _queuedDumpFilename << " dropped for a newer request" << std::endl;
+    _queuedDumpFilename = filename;
+  }
+
+  // Starts the requested dump unless the previous one is in flight, the FBO must be bound and
+  // the map rendered
+  void startQueuedDump()
+  {
+    if(_queuedDumpFilename.empty() || _dumpSync) return;
+    const GLsizeiptr size = sizeof(float)*_depthMapTextureWidth*_depthMapTextureHeight;
+    if(!_dumpPbo) {
+      glGenBuffers(1, &_dumpPbo);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, _dumpPbo);
+      glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
     }
-    delete [] pixels;
-    output_image.close();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _dumpPbo);
+    glReadPixels(0, 0, _depthMapTextureWidth, _depthMapTextureHeight, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    _dumpSync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _dumpFilename = _queuedDumpFilename;
+    _queuedDumpFilename.clear();
+  }
+
+  // Called every frame, returns at once while the copy of the requested dump is not done
+  void collectDump()
+  {
+    if(!_dumpSync || glClientWaitSync(_dumpSync, 0, 0) == GL_TIMEOUT_EXPIRED) return;
+    glDeleteSync(_dumpSync);
+    _dumpSync = nullptr;
+    std::vector<float> depths(_depthMapTextureWidth*_depthMapTextureHeight);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _dumpPbo);
+    const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float)*depths.size(), GL_MAP_READ_BIT);
+    if(mapped) {
+      std::memcpy(depths.data(), mapped, sizeof(float)*depths.size());
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if(mapped)
+      startFileWriter(std::async(std::launch::async, writeDepthImage, _dumpFilename, std::move(depths),
+                                 _depthMapTextureWidth, _depthMapTextureHeight));
   }
 
 private:
@@ -205,6 +255,10 @@ private:
   GLuint _depthMapTexture;
   unsigned int _depthMapTextureWidth;
   unsigned int _depthMapTextureHeight;
+  GLuint _dumpPbo = 0;
+  GLsync _dumpSync = nullptr;
+  std::string _dumpFilename;
+  std::string _queuedDumpFilename;  // requested, not started yet
 };
 
 
@@ -261,7 +315,7 @@ struct Scene {
   std::shared_ptr<ShaderProgram> mainShader, shadomMapShader;
 
   // useful for debug
-  bool saveShadowMapsPpm = false;
+  bool saveShadowMaps = false;
 
   void render()
   {
@@ -269,6 +323,8 @@ struct Scene {
     // first, render the shadow maps
     glEnable(GL_CULL_FACE);
     glCullFace(GL_FRONT);
+    for(auto &light : lights)
+      light.shadowMap.collectDump(); // dumps requested in earlier frames
     shadomMapShader->use();
     for(int i=0; i<lights.size(); ++i) {
       Light &light = lights[i];
@@ -285,12 +341,12 @@ struct Scene {
       shadomMapShader->set("depthMVP", light.depthMVP*rhinoMat);
       rhino->render();
 
-      if(saveShadowMapsPpm) {
-        light.shadowMap.savePpmFile(std::string("shadom_map_")+std::to_string(i)+std::string(".ppm"));
-      }
+      if(saveShadowMaps)
+        light.shadowMap.requestDump(std::string("shadow_map_")+std::to_string(i)+std::string(".pgm"));
+      light.shadowMap.startQueuedDump();
     }
     shadomMapShader->stop();
-    saveShadowMapsPpm = false;
+    saveShadowMaps = false;
     //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
     //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -370,7 +426,7 @@ void printHelp()
     "    Keyboard commands:" << std::endl <<
     "    * H: print this help" << std::endl <<
     "    * T: toggle animation" << std::endl <<
-    "    * S: save shadow maps into PPM files" << std::endl <<
+    "    * S: save shadow maps into 16 bit PGM files, written in the background" << std::endl <<
     "    * F1: toggle wireframe/surface rendering" << std::endl <<
     "    * ESC: quit the program" << std::endl;
 }
@@ -387,12 +443,18 @@ void windowSizeCallback(GLFWwindow *window, int width, int height)
 // Executed each time a key is entered.
 void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
+  // the mesh commands wait for the mesh being loaded
+  if(action == GLFW_PRESS && g_pendingMesh.valid() &&
+     key != GLFW_KEY_H && key != GLFW_KEY_T && key != GLFW_KEY_F1 && key != GLFW_KEY_ESCAPE) {
+    std::cout << " > The mesh is still loading" << std::endl;
+    return;
+  }
   if(action == GLFW_PRESS && key == GLFW_KEY_H) {
     printHelp();
   } else if(action == GLFW_PRESS && key == GLFW_KEY_L) {
     g_scene.subdivideCenterMesh();
   } else if(action == GLFW_PRESS && key == GLFW_KEY_S) {
-    g_scene.saveShadowMapsPpm = true;
+    g_scene.saveShadowMaps = true;
   } else if(action == GLFW_PRESS && key == GLFW_KEY_T) {
     g_appTimerStoppedP = !g_appTimerStoppedP;
     if(!g_appTimerStoppedP)
@@ -541,7 +603,21 @@ void initOpenGL()
   }
 }
 
-void initScene(const std::string &meshFilename)
+// Adjust the scene bounds and the camera to the mesh
+void fitCameraToMesh()
+{
+  glm::vec3 meshCenter;
+  float meshRadius;
+  g_scene.rhino->computeBoundingSphere(meshCenter, meshRadius);
+  g_scene.scene_center = meshCenter;
+  g_scene.scene_radius = meshRadius;
+  g_meshScale = g_scene.scene_radius;
+  g_cam->setPosition(g_scene.scene_center + glm::vec3(0.0, 0.0, 3.0*g_meshScale));
+  g_cam->setNear(g_meshScale/100.f);
+  g_cam->setFar(6.0*g_meshScale);
+}
+
+void initScene()
 {
   // Init camera
   int width, height;
@@ -551,12 +627,9 @@ void initScene(const std::string &meshFilename)
 
   // Load meshes in the scene
   {
+    // placeholder, shown until the mesh loaded in the background is ready
     g_scene.rhino = std::make_shared<Mesh>();
-    try {
-      loadOFF(meshFilename, g_scene.rhino);
-    } catch(std::exception &e) {
-      exitOnCriticalError(std::string("[Error loading mesh]") + e.what());
-    }
+    g_scene.rhino->addPlan(0.5f);
     g_scene.rhino->init();
 
     g_scene.plane = std::make_shared<Mesh>();
@@ -567,10 +640,14 @@ void initScene(const std::string &meshFilename)
       glm::rotate(glm::mat4(1.0), (float)(-0.5f*M_PI), glm::vec3(1.0, 0.0, 0.0));
   }
 
-  // Load textures
-  {
-    g_albedoTex = loadTextureFromFileToGPU("data/color.png");
-    g_normalTex = loadTextureFromFileToGPU("data/normal.png");
+  // Load textures, decoded in parallel
+  try {
+    const std::vector<GLuint> textures = loadTexturesFromFilesToGPU({
+      {"data/color.png", TextureKind::Color}, {"data/normal.png", TextureKind::NormalMap}});
+    g_albedoTex = textures[0];
+    g_normalTex = textures[1];
+  } catch(std::exception &e) {
+    exitOnCriticalError(std::string("[Error loading texture]") + e.what());
   }
 
   // Setup textures on the GPU
@@ -614,23 +691,36 @@ void initScene(const std::string &meshFilename)
     ++g_availableTextureSlot;
   }
 
-  // Adjust the camera to the mesh
-  glm::vec3 meshCenter;
-  float meshRadius;
-  g_scene.rhino->computeBoundingSphere(meshCenter, meshRadius);
-  g_scene.scene_center = meshCenter;
-  g_scene.scene_radius = meshRadius;
-  g_meshScale = g_scene.scene_radius;
-  g_cam->setPosition(g_scene.scene_center + glm::vec3(0.0, 0.0, 3.0*g_meshScale));
-  g_cam->setNear(g_meshScale/100.f);
-  g_cam->setFar(6.0*g_meshScale);
+  fitCameraToMesh();
 }
 
 void init(const std::string &meshFilename)
 {
+  // parse the mesh and compute its normals while the window and the GL context come up
+  g_pendingMesh = std::async(std::launch::async, [meshFilename]() {
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    loadOFF(meshFilename, mesh);
+    return mesh;
+  });
   initGLFW();                   // Windowing system
   initOpenGL();                 // OpenGL Context and shader pipeline
-  initScene(meshFilename);      // Actual g_scene to render
+  initScene();                  // Actual g_scene to render, with a placeholder mesh
+}
+
+// Once the background loading is over, uploads the mesh to the GPU and puts it in the scene
+void installPendingMesh()
+{
+  if(!g_pendingMesh.valid() || g_pendingMesh.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    return;
+  std::shared_ptr<Mesh> mesh;
+  try {
+    mesh = g_pendingMesh.get();
+  } catch(std::exception &e) {
+    exitOnCriticalError(std::string("[Error loading mesh]") + e.what());
+  }
+  mesh->init();
+  g_scene.rhino = mesh;
+  fitCameraToMesh();
 }
 
 void clear()
@@ -640,6 +730,7 @@ void clear()
   g_scene.plane.reset();
   g_scene.mainShader.reset();
   g_scene.shadomMapShader.reset();
+  collectFileWriters(true);
   glfwDestroyWindow(g_window);
   glfwTerminate();
 }
@@ -676,8 +767,10 @@ int main(int argc, char **argv)
   // Your initialization code (user interface, OpenGL states, scene with geometry, material, lights, etc)
   init(argc==1 ? DEFAULT_MESH_FILENAME : argv[1]);
   while(!glfwWindowShouldClose(g_window)) {
+    installPendingMesh();
     update(static_cast<float>(glfwGetTime()));
     render();
+    collectFileWriters(false);  // reports the shadow map writes that failed
     glfwSwapBuffers(g_window);
     glfwPollEvents();
   }
@@ -0,0 +1,173 @@
+#include "FrameRecorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const size_t TGA_HEADER_SIZE = 18;
+const GLuint64 RELEASE_TIMEOUT_NS = 1000000000ull;
+
+// Uncompressed true color TGA, rows bottom to top as read from GL
+bool writeTga(const std::string &filename, int width, int height, const std::vector<unsigned char> &bgr)
+{
+  unsigned char header[TGA_HEADER_SIZE] = {};
+  header[2] = 2;  // uncompressed true color
+  header[12] = static_cast<unsigned char>(width & 0xff);
+  header[13] = static_cast<unsigned char>(width >> 8);
+  header[14] = static_cast<unsigned char>(height & 0xff);
+  header[15] = static_cast<unsigned char>(height >> 8);
+  header[16] = 24;
+  FILE *out = std::fopen(filename.c_str(), "wb");
+  if(!out) return false;
+  const bool ok = std::fwrite(header, sizeof(header), 1, out) == 1 &&
+    std::fwrite(bgr.data(), 1, bgr.size(), out) == bgr.size();
+  return std::fclose(out) == 0 && ok;
+}
+
+} // namespace
+
+FrameRecorder::FrameRecorder(unsigned int bufferCount, unsigned int writerCount) :
+  _captures(std::max(1u, bufferCount)), _writerCount(std::max(1u, writerCount)) {}
+
+FrameRecorder::~FrameRecorder()
+{
+  stopWriters();
+}
+
+bool FrameRecorder::capture(int width, int height, const std::string &filename)
+{
+  if(_inFlight == _captures.size()) {
+    ++_droppedFrames;
+    return false;
+  }
+  Capture &capture = _captures[(_oldest + _inFlight)%_captures.size()];
+  const size_t size = 3*static_cast<size_t>(width)*height;
+  if(!capture.pbo) glGenBuffers(1, &capture.pbo);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo);
+  if(capture.capacity < size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    capture.capacity = size;
+  }
+  // rows of 3 byte texels are not 4 byte aligned
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, nullptr);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  capture.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  capture.width = width;
+  capture.height = height;
+  capture.filename = filename;
+  ++_inFlight;
+  return true;
+}
+
+void FrameRecorder::collect()
+{
+  while(_inFlight) {
+    Capture &capture = _captures[_oldest];
+    if(glClientWaitSync(capture.fence, 0, 0) == GL_TIMEOUT_EXPIRED) return;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(_jobs.size() >= 2*_writerCount) return;  // the ring buffers absorb the backlog
+    }
+    copyToJob(capture);
+    _oldest = (_oldest + 1)%_captures.size();
+    --_inFlight;
+  }
+}
+
+void FrameRecorder::copyToJob(Capture &capture)
+{
+  glDeleteSync(capture.fence);
+  capture.fence = nullptr;
+  startWriters();
+
+  Job job;
+  job.filename = capture.filename;
+  job.width = capture.width;
+  job.height = capture.height;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_freePixels.empty()) {
+      job.pixels.swap(_freePixels.back());
+      _freePixels.pop_back();
+    }
+  }
+  job.pixels.resize(3*static_cast<size_t>(job.width)*job.height);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo);
+  const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, job.pixels.size(), GL_MAP_READ_BIT);
+  if(mapped) {
+    std::memcpy(job.pixels.data(), mapped, job.pixels.size());
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if(!mapped) {
+    ++_droppedFrames;
+    return;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _jobs.push_back(std::move(job));
+  _jobAdded.notify_one();
+}
+
+void FrameRecorder::release()
+{
+  // the only place that waits for the GPU, at exit
+  while(_inFlight) {
+    Capture &capture = _captures[_oldest];
+    glClientWaitSync(capture.fence, GL_SYNC_FLUSH_COMMANDS_BIT, RELEASE_TIMEOUT_NS);
+    copyToJob(capture);
+    _oldest = (_oldest + 1)%_captures.size();
+    --_inFlight;
+  }
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _jobDone.wait(lock, [this]() { return _jobs.empty() && _busyWriters == 0; });
+  }
+  stopWriters();
+  for(auto &capture : _captures) {
+    if(capture.pbo) glDeleteBuffers(1, &capture.pbo);
+    capture = Capture();
+  }
+}
+
+void FrameRecorder::startWriters()
+{
+  if(!_writers.empty()) return;
+  _stopping = false;
+  for(unsigned int i = 0; i < _writerCount; ++i)
+    _writers.push_back(std::thread(&FrameRecorder::writerLoop, this));
+}
+
+void FrameRecorder::stopWriters()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _jobAdded.notify_all();
+  for(auto &writer : _writers) writer.join();
+  _writers.clear();
+}
+
+void FrameRecorder::writerLoop()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  for(;;) {
+    _jobAdded.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+    if(_jobs.empty()) return;
+    Job job = std::move(_jobs.front());
+    _jobs.pop_front();
+    ++_busyWriters;
+    lock.unlock();
+    if(!writeTga(job.filename, job.width, job.height, job.pixels))
+      std::cerr << "> [Error writing file] " << job.filename << std::endl;
+    lock.lock();
+    _freePixels.push_back(std::move(job.pixels));
+    --_busyWriters;
+    _jobDone.notify_all();
+  }
+}
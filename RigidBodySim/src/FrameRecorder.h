@@ -0,0 +1,76 @@
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Captures frames of the default framebuffer into TGA files without stalling the render loop.
+// Each capture reads the back buffer into one of a ring of pixel buffer objects and sets a fence;
+// collect() copies the captures whose fence has passed and hands them to a pool of writer threads
+// that encode and write the files. When every buffer is still in flight, or the writers are too
+// far behind, the frame is dropped rather than waited for.
+class FrameRecorder {
+public:
+  explicit FrameRecorder(unsigned int bufferCount = 4, unsigned int writerCount = 2);
+  ~FrameRecorder();
+
+  // Queues the capture of the back buffer, to call after rendering and before swapping buffers.
+  // Returns false when the frame is dropped.
+  bool capture(int width, int height, const std::string &filename);
+
+  // Hands the completed captures to the writers, in capture order; call once per frame
+  void collect();
+
+  // Waits for the captures in flight and the files being written, then frees the GL objects.
+  // A GL context must be current.
+  void release();
+
+  unsigned int droppedFrames() const { return _droppedFrames; }
+
+private:
+  struct Capture {
+    GLuint pbo = 0;
+    size_t capacity = 0;
+    GLsync fence = nullptr;
+    int width = 0;
+    int height = 0;
+    std::string filename;
+  };
+
+  struct Job {
+    std::string filename;
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;  // BGR rows, bottom to top
+  };
+
+  FrameRecorder(const FrameRecorder &);
+  FrameRecorder &operator=(const FrameRecorder &);
+
+  void copyToJob(Capture &capture);
+  void startWriters();
+  void stopWriters();
+  void writerLoop();
+
+  std::vector<Capture> _captures;   // ring, _oldest is the first capture in flight
+  unsigned int _oldest = 0;
+  unsigned int _inFlight = 0;
+  unsigned int _droppedFrames = 0;
+
+  unsigned int _writerCount;
+  std::vector<std::thread> _writers;
+  std::mutex _mutex;
+  std::condition_variable _jobAdded, _jobDone;
+  std::deque<Job> _jobs;
+  std::vector<std::vector<unsigned char>> _freePixels;  // recycled job buffers
+  unsigned int _busyWriters = 0;
+  bool _stopping = false;
+};
+
+#endif  // FRAME_RECORDER_H
@@ -39,10 +39,19 @@ public:
   void addBox(const float w, const float h, const float d);
 
 private:
+  // Compressed (CSR) vertex -> incident faces adjacency, and the normal of one vertex gathered from
+  // the face data of recomputePerVertexNormals()
+  void calculateVertexFaceAdjacency();
+  glm::vec3 gatherVertexNormal(unsigned int v, bool angleBased) const;
+
   std::vector<glm::vec3> _vertexPositions;
   std::vector<glm::vec3> _vertexNormals;
   std::vector<glm::vec2> _vertexTexCoords;
   std::vector<glm::uvec3> _triangleIndices;
+  std::vector<unsigned int> _vertexFaceOffsets, _vertexFaces;
+  std::vector<glm::vec3> _triangleNormals;
+  std::vector<float> _triangleArea;
+  std::vector<glm::vec3> _triangleAngles; // interior angle at each corner
 
   GLuint _vao = 0;
   GLuint _posVbo = 0;
@@ -52,6 +61,6 @@ private:
 };
 
 // utility: loader
-void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr);
+void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr, unsigned int threadCount = 0);
 
 #endif  // MESH_H
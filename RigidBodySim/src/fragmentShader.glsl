@@ -30,8 +30,9 @@ uniform mat4 modelMat;
 uniform mat3 normMat;
 
 void main() {
+  vec2 nxy = (texture(material.normalTex, fTexCoord).rg - 0.5)*2.0; // colors are in [0,1], and normals are in [-1,1]
   vec3 n = (material.normalTexLoaded == 1) ?
-    normalize(normMat*((texture(material.normalTex, fTexCoord).rgb - 0.5)*2.0)) : // colors are in [0,1]^3, and normals are in [-1,1]^3
+    normalize(normMat*vec3(nxy, sqrt(max(0.0, 1.0 - dot(nxy, nxy))))) : // the map stores x and y only, z is rebuilt
     normalize(fNormal);
 
   vec3 radiance = vec3(0, 0, 0);
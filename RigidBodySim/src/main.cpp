@@ -47,6 +47,8 @@
 #include "ShaderProgram.h"
 #include "Camera.h"
 #include "Mesh.h"
+#include "TextureLoader.h"
+#include "FrameRecorder.h"
 
 #include "RigidSolver.hpp"
 
@@ -81,46 +83,6 @@ unsigned int g_albedoTexOnGPU;
 GLuint g_normalTex;
 unsigned int g_normalTexOnGPU;
 
-GLuint loadTextureFromFileToGPU(const std::string &filename)
-{
-  int width, height, numComponents;
-  // Loading the image in CPU memory using stbd_image
-  unsigned char *data = stbi_load(
-    filename.c_str(),
-    &width,
-    &height,
-    &numComponents, // 1 for a 8 bit greyscale image, 3 for 24bits RGB image, 4 for 32bits RGBA image
-    0);
-
-  // Create a texture in GPU memory
-  GLuint texID;
-  glGenTextures(1, &texID);
-  glBindTexture(GL_TEXTURE_2D, texID);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  // Uploading the image data to GPU memory
-  glTexImage2D(
-    GL_TEXTURE_2D,
-    0,
-    (numComponents == 1 ? GL_RED : numComponents == 3 ? GL_RGB : GL_RGBA), // For greyscale images, we store them in the RED channel
-    width,
-    height,
-    0,
-    (numComponents == 1 ? GL_RED : numComponents == 3 ? GL_RGB : GL_RGBA), // For greyscale images, we store them in the RED channel
-    GL_UNSIGNED_BYTE,
-    data);
-
-  // Generating mipmaps for filtered texture fetch
-  glGenerateMipmap(GL_TEXTURE_2D);
-
-  // Freeing the now useless CPU memory
-  stbi_image_free(data);
-  glBindTexture(GL_TEXTURE_2D, 0); // unbind the texture
-  return texID;
-}
-
 struct Light {
   glm::vec3 position;
   glm::vec3 color;
@@ -151,7 +113,9 @@ struct Scene {
 
   // useful for debug
   bool saveScreenShot = false;
+  bool recording = false; // capture every frame
   int savedCnt = 0;
+  FrameRecorder recorder;
 
   void resetSim()
   {
@@ -209,24 +173,19 @@ struct Scene {
 
     mainShader->stop();
 
-    if(saveScreenShot) {
+    recorder.collect(); // frames captured earlier go to the writer threads
+    if(saveScreenShot || recording) {
       std::stringstream fpath;
-      fpath << "s" << std::setw(4) << std::setfill('0') << savedCnt++ << ".tga";
-
-      std::cout << "Saving file " << fpath.str() << " ... " << std::flush;
-      const short int w = g_windowWidth;
-      const short int h = g_windowHeight;
-      std::vector<int> buf(w*h*3, 0);
-      glReadPixels(0, 0, w, h, GL_BGR, GL_UNSIGNED_BYTE, &(buf[0]));
-
-      FILE *out = fopen(fpath.str().c_str(), "wb");
-      short TGAhead[] = {0, 2, 0, 0, 0, 0, w, h, 24};
-      fwrite(&TGAhead, sizeof(TGAhead), 1, out);
-      fwrite(&(buf[0]), 3*w*h, 1, out);
-      fclose(out);
+      fpath << "s" << std::setw(4) << std::setfill('0') << savedCnt << ".tga";
+      // the number only advances for frames the recorder accepts, so the files have no gaps
+      if(recorder.capture(g_windowWidth, g_windowHeight, fpath.str())) {
+        ++savedCnt;
+        if(saveScreenShot) std::cout << "Saving file " << fpath.str() << std::endl;
+      } else if(saveScreenShot) {
+        // the frames dropped while recording are reported once, when the recording stops
+        std::cout << "Screenshot dropped, the recorder is busy" << std::endl;
+      }
       saveScreenShot = false;
-
-      std::cout << "Done" << std::endl;
     }
   }
 };
@@ -246,6 +205,7 @@ void printHelp()
     "    * P: toggle simulation" << std::endl <<
     "    * R: reset simulation" << std::endl <<
     "    * S: save a screenshot" << std::endl <<
+    "    * V: start/stop recording every frame into TGA files" << std::endl <<
     "    * W: wireframe rendering" << std::endl <<
     "    * F: surface rendering" << std::endl <<
     "    * ESC: quit the program" << std::endl;
@@ -269,6 +229,10 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
     g_scene.resetSim();
   } else if(action == GLFW_PRESS && key == GLFW_KEY_S) {
     g_scene.saveScreenShot = true;
+  } else if(action == GLFW_PRESS && key == GLFW_KEY_V) {
+    g_scene.recording = !g_scene.recording;
+    std::cout << (g_scene.recording ? "Recording started" : "Recording stopped") << " at frame " << g_scene.savedCnt
+              << " (" << g_scene.recorder.droppedFrames() << " frames dropped so far)" << std::endl;
   } else if(action == GLFW_PRESS && key == GLFW_KEY_P) {
     g_appTimerStoppedP = !g_appTimerStoppedP;
     if(!g_appTimerStoppedP)
@@ -428,10 +392,14 @@ void initScene()
       glm::rotate(glm::mat4(1.0), (float)(-0.5f*M_PI), glm::vec3(1.0, 0.0, 0.0));
   }
 
-  // Load textures
-  {
-    g_albedoTex = loadTextureFromFileToGPU("data/dice.png");
-    g_normalTex = loadTextureFromFileToGPU("data/normal.png");
+  // Load textures, decoded in parallel
+  try {
+    const std::vector<GLuint> textures = loadTexturesFromFilesToGPU({
+      {"data/dice.png", TextureKind::Color}, {"data/normal.png", TextureKind::NormalMap}});
+    g_albedoTex = textures[0];
+    g_normalTex = textures[1];
+  } catch(std::exception &e) {
+    exitOnCriticalError(std::string("[Error loading texture]") + e.what());
   }
 
   // Setup textures on the GPU
@@ -473,6 +441,7 @@ void clear()
   g_scene.rigid.reset();
   g_scene.plane.reset();
   g_scene.mainShader.reset();
+  g_scene.recorder.release();
   glfwDestroyWindow(g_window);
   glfwTerminate();
 }
@@ -61,9 +61,9 @@ float shadowCalculation(vec4 fragPosLightSpace, int i){
 void main() {
   vec3 n = normalize(fNormal);
   if (material.hasNormalMap){
-    n = texture(material.normalMap, fTexCoord).rgb;
-    // transform normal vector to range [-1,1]
-    n = normalize(n * 2.0 - 1.0); 
+    // the normal map stores x and y only (two channel compression), z is rebuilt
+    vec2 nxy = texture(material.normalMap, fTexCoord).rg * 2.0 - 1.0;
+    n = normalize(vec3(nxy, sqrt(max(0.0, 1.0 - dot(nxy, nxy)))));
   } 
 
   vec3 wo = normalize(camPos - fPosition); // unit vector pointing to the camera
@@ -0,0 +1,162 @@
+// Encodes synthetic images with compressImage, decodes them with decompressImage and checks the
+// PSNR of every format against a floor. Needs no GL context. Returns non zero on failure.
+
+#include "BlockCompression.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+// Deterministic noise, the same on every platform
+struct Lcg {
+  uint32_t state = 12345u;
+  int next(int range)
+  {
+    state = state*1664525u + 1013904223u;
+    return static_cast<int>((state >> 8) % static_cast<uint32_t>(range));
+  }
+};
+
+struct Image {
+  int width, height, components;
+  std::vector<unsigned char> pixels;
+
+  Image(int w, int h, int c) : width(w), height(h), components(c), pixels(static_cast<size_t>(w)*h*c) {}
+  unsigned char &at(int x, int y, int c) { return pixels[(static_cast<size_t>(y)*width + x)*components + c]; }
+};
+
+unsigned char clampByte(double value)
+{
+  return static_cast<unsigned char>(std::max(0.0, std::min(255.0, std::floor(value + 0.5))));
+}
+
+// PSNR of the decoded image over the components the format keeps, infinite when exact
+double roundTripPsnr(const Image &image, BlockFormat format)
+{
+  std::vector<unsigned char> blocks(blockCompressedSize(image.width, image.height, format));
+  compressImage(image.pixels.data(), image.width, image.height, image.components, format, blocks.data());
+  const int components = blockComponents(format);
+  std::vector<unsigned char> decoded(static_cast<size_t>(image.width)*image.height*components);
+  decompressImage(blocks.data(), image.width, image.height, format, decoded.data());
+  double squaredError = 0.0;
+  for(size_t i = 0; i < static_cast<size_t>(image.width)*image.height; ++i)
+    for(int c = 0; c < components; ++c) {
+      const double d = static_cast<double>(decoded[i*components + c]) - image.pixels[i*image.components + c];
+      squaredError += d*d;
+    }
+  if(squaredError == 0.0) return std::numeric_limits<double>::infinity();
+  const double mse = squaredError/(static_cast<double>(image.width)*image.height*components);
+  return 10.0*std::log10(255.0*255.0/mse);
+}
+
+void checkPsnr(const std::string &name, const Image &image, BlockFormat format, double floor)
+{
+  const double psnr = roundTripPsnr(image, format);
+  const bool ok = psnr >= floor;
+  std::printf("%s %-32s %7.2f dB (floor %.1f)\n", ok ? "[ OK ]" : "[FAIL]", name.c_str(), psnr, floor);
+  if(!ok) ++g_failures;
+}
+
+Image gradient(int width, int height, int components)
+{
+  Image image(width, height, components);
+  for(int y = 0; y < height; ++y)
+    for(int x = 0; x < width; ++x) {
+      const double u = x/(width - 1.0), v = y/(height - 1.0);
+      const double values[4] = { 255.0*u, 255.0*v, 255.0*(1.0 - 0.5*(u + v)), 255.0*(0.25 + 0.75*u*v) };
+      for(int c = 0; c < components; ++c) image.at(x, y, c) = clampByte(values[c]);
+    }
+  return image;
+}
+
+Image withNoise(Image image, int amplitude)
+{
+  Lcg lcg;
+  for(auto &p : image.pixels) p = clampByte(p + lcg.next(2*amplitude + 1) - amplitude);
+  return image;
+}
+
+// x and y of the normals of a bumpy height field, in [0, 255] as stored in a normal map
+Image normalMap(int width, int height)
+{
+  Image image(width, height, 2);
+  for(int y = 0; y < height; ++y)
+    for(int x = 0; x < width; ++x) {
+      const double dx = 0.6*std::cos(x/9.0)*std::cos(y/13.0), dy = -0.45*std::sin(x/9.0)*std::sin(y/13.0);
+      const double length = std::sqrt(dx*dx + dy*dy + 1.0);
+      image.at(x, y, 0) = clampByte(127.5*(1.0 - dx/length));
+      image.at(x, y, 1) = clampByte(127.5*(1.0 - dy/length));
+    }
+  return image;
+}
+
+// Blocks the formats represent exactly: two colors on the 565 grid (found by the principal axis
+// and kept by the refit) and an 8 level ramp (only the eight value BC4 mode holds it)
+Image twoColorBlocks()
+{
+  Image image(8, 8, 3);
+  for(int y = 0; y < 8; ++y)
+    for(int x = 0; x < 8; ++x) {
+      const bool first = (x + 2*y) % 3 == 0;
+      image.at(x, y, 0) = first ? 255 : 132;
+      image.at(x, y, 1) = first ? 4 : 65;
+      image.at(x, y, 2) = first ? 0 : 189;
+    }
+  return image;
+}
+
+Image eightLevelRamp()
+{
+  Image image(4, 4, 1);
+  for(int i = 0; i < 16; ++i) image.pixels[i] = static_cast<unsigned char>(35*(i % 8));
+  return image;
+}
+
+// Blocks of two noisy clusters and one bright texel: the principal axis ends on the outlier, the
+// least squares refit pulls the endpoints back onto the clusters (about 3 dB better)
+Image clustersWithOutlier()
+{
+  Image image(64, 64, 3);
+  Lcg lcg;
+  for(int by = 0; by < 16; ++by)
+    for(int bx = 0; bx < 16; ++bx) {
+      int dark[3], light[3], outlier[3];
+      for(int c = 0; c < 3; ++c) {
+        dark[c] = 40 + lcg.next(60);
+        light[c] = 120 + lcg.next(60);
+        outlier[c] = 250 - lcg.next(20);
+      }
+      for(int i = 0; i < 16; ++i) {
+        const int *color = i == 5 ? outlier : (i % 2 ? dark : light);
+        for(int c = 0; c < 3; ++c) image.at(4*bx + i%4, 4*by + i/4, c) = clampByte(color[c] + lcg.next(9) - 4);
+      }
+    }
+  return image;
+}
+
+} // namespace
+
+int main()
+{
+  checkPsnr("BC1 gradient 256x256", gradient(256, 256, 3), BlockFormat::BC1, 42.0);
+  checkPsnr("BC1 gradient 37x29 (borders)", gradient(37, 29, 3), BlockFormat::BC1, 31.0);
+  checkPsnr("BC1 noise +-24", withNoise(gradient(128, 128, 3), 24), BlockFormat::BC1, 26.0);
+  checkPsnr("BC1 two colors on the 565 grid", twoColorBlocks(), BlockFormat::BC1, std::numeric_limits<double>::infinity());
+  checkPsnr("BC1 clusters with an outlier", clustersWithOutlier(), BlockFormat::BC1, 26.0);
+  checkPsnr("BC3 gradient with alpha", gradient(128, 128, 4), BlockFormat::BC3, 41.0);
+  checkPsnr("BC3 noise +-24", withNoise(gradient(128, 128, 4), 24), BlockFormat::BC3, 27.0);
+  checkPsnr("BC4 gradient", gradient(128, 128, 1), BlockFormat::BC4, 50.0);
+  checkPsnr("BC4 noise +-24", withNoise(gradient(128, 128, 1), 24), BlockFormat::BC4, 40.0);
+  checkPsnr("BC4 8 level ramp", eightLevelRamp(), BlockFormat::BC4, std::numeric_limits<double>::infinity());
+  checkPsnr("BC5 normal map", normalMap(256, 256), BlockFormat::BC5, 49.0);
+  checkPsnr("BC5 noisy normal map", withNoise(normalMap(128, 128), 16), BlockFormat::BC5, 43.0);
+  if(g_failures) std::printf("%d check(s) failed\n", g_failures);
+  return g_failures ? 1 : 0;
+}